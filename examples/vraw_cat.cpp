@@ -0,0 +1,353 @@
+/**
+ * vraw_cat - Stream decoded VRAW frames to stdout
+ *
+ * Usage: vraw_cat [options] <file.vraw>
+ *   --format <f>       bayer  - 16-bit mosaic, width x height (gray16le)
+ *                      planar - R, G1, G2, B planes of (width/2) x (height/2) each
+ *                      rgb48  - bilinear demosaic, black-subtracted and scaled to
+ *                               16 bits, camera RGB (rgb48le)
+ *   --start <n>        First frame (default: 0)
+ *   --count <n>        Number of frames (default: all)
+ *   --threads <n>      Decode threads (default: hardware concurrency)
+ *   --ahead <n>        Frames decoded ahead of the writer (default: 2 per thread)
+ *
+ * Frames are written back to back with no header; the geometry is printed
+ * on stderr. Example:
+ *   vraw_cat --format rgb48 clip.vraw | ffmpeg -f rawvideo -pix_fmt rgb48le \
+ *       -s 4096x3072 -r 24 -i - out.mov
+ *
+ * Worker threads (each with its own reader) decode into a ring of
+ * page-aligned frame buffers while the main thread writes them in order.
+ * When stdout is a pipe, frames are handed over with vmsplice(): the pipe
+ * references the buffer pages instead of copying them, and a buffer is
+ * reused only once a full pipe's worth of later data has been queued,
+ * i.e. after the reader has consumed it.
+ */
+
+#include <vraw.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/uio.h>
+#endif
+
+enum class OutputFormat { BAYER, PLANAR, RGB48 };
+
+static const size_t PAGE_BYTES = 4096;
+
+static void printUsage() {
+    std::cerr << "Usage: vraw_cat [--format bayer|planar|rgb48] [--start <n>] [--count <n>] "
+                 "[--threads <n>] [--ahead <n>] <file.vraw>" << std::endl;
+}
+
+// One decoded frame buffer of the ring
+struct Slot {
+    std::unique_ptr<uint8_t, decltype(&free)> data{nullptr, &free};
+    uint32_t frame = UINT32_MAX;  // Frame held once ready
+    bool failed = false;
+};
+
+// Per-CFA-position lookup from decoded codes to black-subtracted 16-bit
+// linear values
+static void buildNormalizeTables(const vraw::FileHeader& file, std::vector<uint16_t> tables[4]) {
+    const bool log = file.encoding == vraw::Encoding::LOG2_10BIT ||
+                     file.encoding == vraw::Encoding::LOG2_12BIT;
+    const uint16_t avgBlack = static_cast<uint16_t>(
+        (file.blackLevel[0] + file.blackLevel[1] + file.blackLevel[2] + file.blackLevel[3]) / 4);
+    for (int c = 0; c < 4; ++c) {
+        const uint16_t black = log ? avgBlack : file.blackLevel[c];
+        const float range = static_cast<float>(std::max(1, file.whiteLevel - black));
+        tables[c].resize(65536);
+        for (uint32_t v = 0; v < 65536; ++v) {
+            uint32_t linear = v;
+            if (log) {
+                const uint16_t code = static_cast<uint16_t>(v);
+                linear = (file.encoding == vraw::Encoding::LOG2_12BIT)
+                         ? vraw::decodePixelLog12Bit(code, avgBlack, file.whiteLevel)
+                         : vraw::decodePixelLog10Bit(code, avgBlack, file.whiteLevel);
+            }
+            const float scaled = (static_cast<float>(linear) - black) * 65535.0f / range;
+            tables[c][v] = static_cast<uint16_t>(std::min(65535.0f, std::max(0.0f, scaled + 0.5f)));
+        }
+    }
+}
+
+// Bilinear demosaic: each pixel keeps its own colour and averages the
+// other two over its 3x3 neighbourhood (mirrored at the edges)
+static void demosaic(const uint16_t* mosaic, uint32_t width, uint32_t height,
+                     const uint8_t cfa[4], uint16_t* rgb) {
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint32_t rows[3] = {y > 0 ? y - 1 : y + 1, y, y + 1 < height ? y + 1 : y - 1};
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t cols[3] = {x > 0 ? x - 1 : x + 1, x, x + 1 < width ? x + 1 : x - 1};
+            const uint8_t own = cfa[(y & 1) * 2 + (x & 1)];
+            uint32_t sum[3] = {0, 0, 0};
+            uint32_t count[3] = {0, 0, 0};
+            for (uint32_t r : rows) {
+                for (uint32_t c : cols) {
+                    const uint8_t color = cfa[(r & 1) * 2 + (c & 1)];
+                    sum[color] += mosaic[static_cast<size_t>(r) * width + c];
+                    count[color]++;
+                }
+            }
+            uint16_t* out = rgb + (static_cast<size_t>(y) * width + x) * 3;
+            for (int color = 0; color < 3; ++color) {
+                out[color] = (color == own) ? mosaic[static_cast<size_t>(y) * width + x]
+                             : static_cast<uint16_t>(count[color] ? sum[color] / count[color] : 0);
+            }
+        }
+    }
+}
+
+// Write a whole buffer to stdout, through vmsplice when it is a pipe
+static bool writeOut(const uint8_t* data, size_t bytes, bool& useSplice) {
+    while (bytes > 0) {
+        ssize_t n = -1;
+#ifdef __linux__
+        if (useSplice) {
+            iovec iov = {const_cast<uint8_t*>(data), bytes};
+            n = vmsplice(STDOUT_FILENO, &iov, 1, 0);
+            if (n < 0 && (errno == EBADF || errno == EINVAL)) {
+                useSplice = false;  // Not a pipe after all
+                continue;
+            }
+        } else
+#endif
+        {
+            n = write(STDOUT_FILENO, data, bytes);
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        bytes -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    OutputFormat format = OutputFormat::BAYER;
+    uint32_t start = 0;
+    uint32_t count = UINT32_MAX;
+    unsigned threads = 0;
+    uint32_t ahead = 0;
+    const char* path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (strcmp(name, "bayer") == 0) {
+                format = OutputFormat::BAYER;
+            } else if (strcmp(name, "planar") == 0) {
+                format = OutputFormat::PLANAR;
+            } else if (strcmp(name, "rgb48") == 0) {
+                format = OutputFormat::RGB48;
+            } else {
+                printUsage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc) {
+            start = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--ahead") == 0 && i + 1 < argc) {
+            ahead = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (argv[i][0] == '-' || path) {
+            printUsage();
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        printUsage();
+        return 1;
+    }
+
+    vraw::VrawReader probe;
+    if (!probe.open(path)) {
+        std::cerr << "Failed to open: " << path << std::endl;
+        return 1;
+    }
+    const vraw::FileHeader file = probe.getFileHeader();
+    const uint32_t width = file.width;
+    const uint32_t height = file.height;
+    const uint32_t end = static_cast<uint32_t>(std::min<uint64_t>(probe.getFrameCount(),
+                                                                  static_cast<uint64_t>(start) + count));
+    probe.close();
+    if (start >= end) {
+        std::cerr << "No frames to write" << std::endl;
+        return 1;
+    }
+    if (format != OutputFormat::BAYER && (width % 2 != 0 || height % 2 != 0)) {
+        std::cerr << "planar and rgb48 output need even dimensions" << std::endl;
+        return 1;
+    }
+
+    // Report a closed pipe as EPIPE instead of dying on SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    const size_t mosaicBytes = static_cast<size_t>(width) * height * sizeof(uint16_t);
+    const size_t frameBytes = (format == OutputFormat::RGB48) ? mosaicBytes * 3 : mosaicBytes;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min<unsigned>(threads, end - start);
+    if (ahead == 0) {
+        ahead = threads * 2;
+    }
+
+    // vmsplice()d frames stay referenced by the pipe until read; a buffer is
+    // free again once a pipe's worth of later bytes has been queued
+    bool useSplice = false;
+    size_t pipeBytes = 0;
+#ifdef __linux__
+    const int pipeSize = fcntl(STDOUT_FILENO, F_GETPIPE_SZ);
+    if (pipeSize > 0) {
+        fcntl(STDOUT_FILENO, F_SETPIPE_SZ, 1024 * 1024);  // Best effort; the maximum may be lower
+        pipeBytes = static_cast<size_t>(std::max(pipeSize, fcntl(STDOUT_FILENO, F_GETPIPE_SZ)));
+        useSplice = true;
+    }
+#endif
+    const uint32_t slotCount = ahead + static_cast<uint32_t>(pipeBytes / frameBytes) + 1;
+
+    const size_t slotBytes = (frameBytes + PAGE_BYTES - 1) / PAGE_BYTES * PAGE_BYTES;
+    std::vector<Slot> slots(slotCount);
+    for (Slot& slot : slots) {
+        slot.data.reset(static_cast<uint8_t*>(aligned_alloc(PAGE_BYTES, slotBytes)));
+        if (!slot.data) {
+            std::cerr << "Failed to allocate " << slotCount << " frame buffers" << std::endl;
+            return 1;
+        }
+    }
+
+    const char* pixelFormat = (format == OutputFormat::RGB48) ? "rgb48le" : "gray16le";
+    const uint32_t outHeight = (format == OutputFormat::PLANAR) ? height * 2 : height;
+    const uint32_t outWidth = (format == OutputFormat::PLANAR) ? width / 2 : width;
+    std::cerr << "vraw_cat: " << (end - start) << " frames, " << outWidth << "x" << outHeight
+              << " " << pixelFormat << ", " << frameBytes << " bytes per frame" << std::endl;
+
+    std::vector<uint16_t> tables[4];
+    uint8_t cfa[4] = {0, 1, 1, 2};
+    if (format == OutputFormat::RGB48) {
+        buildNormalizeTables(file, tables);
+        static const uint8_t PATTERNS[4][4] = {{0, 1, 1, 2}, {1, 0, 2, 1}, {1, 2, 0, 1}, {2, 1, 1, 0}};
+        memcpy(cfa, PATTERNS[static_cast<uint8_t>(file.bayerPattern) & 3], 4);
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<uint32_t> nextFrame{start};
+    uint32_t released = start;  // Frames before this have free slots
+    bool stopping = false;
+
+    auto worker = [&]() {
+        vraw::VrawReader reader;
+        bool opened = reader.open(path);
+        reader.setOutputLayout(format == OutputFormat::PLANAR ? vraw::FrameLayout::CFA_PLANES
+                                                               : vraw::FrameLayout::MOSAIC);
+        reader.setAccessHint(vraw::AccessHint::SEQUENTIAL);
+        std::vector<uint16_t> mosaic;
+        if (format == OutputFormat::RGB48) {
+            mosaic.resize(static_cast<size_t>(width) * height);
+        }
+
+        for (uint32_t frame = nextFrame++; frame < end; frame = nextFrame++) {
+            Slot& slot = slots[(frame - start) % slotCount];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return stopping || frame < released + slotCount; });
+                if (stopping) {
+                    return;
+                }
+            }
+
+            bool ok = opened;
+            if (ok && format == OutputFormat::RGB48) {
+                ok = reader.readFrameInto(frame, mosaic.data(), mosaicBytes);
+                if (ok) {
+                    for (uint32_t y = 0; y < height; ++y) {
+                        uint16_t* row = mosaic.data() + static_cast<size_t>(y) * width;
+                        for (uint32_t x = 0; x < width; ++x) {
+                            row[x] = tables[(y & 1) * 2 + (x & 1)][row[x]];
+                        }
+                    }
+                    demosaic(mosaic.data(), width, height, cfa, reinterpret_cast<uint16_t*>(slot.data.get()));
+                }
+            } else if (ok) {
+                ok = reader.readFrameInto(frame, slot.data.get(), frameBytes);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.failed = !ok;
+            slot.frame = frame;
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back(worker);
+    }
+
+    // Frame end offsets in the output stream, for releasing vmsplice()d slots
+    std::vector<uint64_t> frameEnds;
+    frameEnds.reserve(end - start);
+    uint64_t written = 0;
+    int status = 0;
+    for (uint32_t frame = start; frame < end; ++frame) {
+        Slot& slot = slots[(frame - start) % slotCount];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return slot.frame == frame; });
+        }
+        if (slot.failed) {
+            std::cerr << "Failed to decode frame " << frame << std::endl;
+            status = 1;
+            break;
+        }
+        if (!writeOut(slot.data.get(), frameBytes, useSplice)) {
+            status = (errno == EPIPE) ? 0 : 1;  // The reader going away ends the stream
+            break;
+        }
+        written += frameBytes;
+        frameEnds.push_back(written);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        while (released <= frame &&
+               (!useSplice || written - frameEnds[released - start] >= pipeBytes)) {
+            released++;
+        }
+        cv.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        cv.notify_all();
+    }
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    return status;
+}
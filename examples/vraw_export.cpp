@@ -0,0 +1,165 @@
+/**
+ * vraw_export - Export a VRAW clip as a CinemaDNG sequence
+ *
+ * Usage: vraw_export [options] <file.vraw> <output_dir>
+ *   --packed           Store samples at the clip's bit depth (10/12/14) instead of 16
+ *   --start <n>        First frame to export (default: 0)
+ *   --count <n>        Number of frames to export (default: all)
+ *   --threads <n>      Decode/encode threads (default: hardware concurrency)
+ *   --prefix <name>    Output file prefix (default: the clip's file name)
+ *   --fps <rate>       FrameRate tag (default: from the frame timestamps)
+ *
+ * Frames are read in merged batches and decoded on worker threads; each
+ * worker builds its DNG in memory and writes it with a single write, so
+ * frames are decoded, encoded and written in parallel.
+ */
+
+#include <vraw.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void printUsage() {
+    std::cerr << "Usage: vraw_export [--packed] [--start <n>] [--count <n>] [--threads <n>] "
+                 "[--prefix <name>] [--fps <rate>] <file.vraw> <output_dir>" << std::endl;
+}
+
+// Median frame interval of the first frames, as a rate
+static float estimateFrameRate(vraw::VrawReader& reader) {
+    const uint32_t count = std::min<uint32_t>(reader.getFrameCount(), 33);
+    std::vector<uint64_t> intervals;
+    uint64_t previous = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        vraw::FrameHeader header;
+        if (!reader.readFrameHeader(i, header)) {
+            break;
+        }
+        if (i > 0 && header.timestampUs > previous) {
+            intervals.push_back(header.timestampUs - previous);
+        }
+        previous = header.timestampUs;
+    }
+    if (intervals.empty()) {
+        return 0.0f;
+    }
+    std::nth_element(intervals.begin(), intervals.begin() + intervals.size() / 2, intervals.end());
+    return 1000000.0f / static_cast<float>(intervals[intervals.size() / 2]);
+}
+
+static bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    // Unbuffered: the whole file goes out in one write
+    setvbuf(file, nullptr, _IONBF, 0);
+    const bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return (fclose(file) == 0) && ok;
+}
+
+int main(int argc, char* argv[]) {
+    vraw::DngOptions dngOptions;
+    vraw::VrawReader::BatchReadOptions readOptions;
+    uint32_t start = 0;
+    uint32_t count = UINT32_MAX;
+    std::string prefix;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--packed") == 0) {
+            dngOptions.packed = true;
+        } else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc) {
+            start = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            readOptions.decodeThreads = static_cast<unsigned>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--prefix") == 0 && i + 1 < argc) {
+            prefix = argv[++i];
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            dngOptions.frameRate = static_cast<float>(atof(argv[++i]));
+        } else if (argv[i][0] == '-') {
+            printUsage();
+            return 1;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.size() != 2) {
+        printUsage();
+        return 1;
+    }
+
+    vraw::VrawReader reader;
+    if (!reader.open(paths[0])) {
+        std::cerr << "Failed to open: " << paths[0] << std::endl;
+        return 1;
+    }
+    reader.setOutputLayout(vraw::FrameLayout::MOSAIC);
+    reader.setAccessHint(vraw::AccessHint::SEQUENTIAL);
+
+    const vraw::FileHeader& fileHeader = reader.getFileHeader();
+    if (vraw::DngWriter::encodedSize(fileHeader, dngOptions) == 0) {
+        std::cerr << "Clip cannot be exported as DNG (dimensions or encoding)" << std::endl;
+        return 1;
+    }
+    if (dngOptions.frameRate <= 0.0f) {
+        dngOptions.frameRate = estimateFrameRate(reader);
+    }
+    if (prefix.empty()) {
+        prefix = std::filesystem::path(paths[0]).stem().string();
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(paths[1], ec);
+    if (ec) {
+        std::cerr << "Failed to create " << paths[1] << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    const uint32_t frameCount = reader.getFrameCount();
+    std::vector<uint32_t> frames;
+    for (uint32_t f = start; f < frameCount && f - start < count; ++f) {
+        frames.push_back(f);
+    }
+    if (frames.empty()) {
+        std::cerr << "No frames to export" << std::endl;
+        return 1;
+    }
+
+    std::atomic<uint32_t> written{0};
+    std::atomic<uint32_t> failed{0};
+    std::atomic<uint64_t> bytes{0};
+    const auto began = std::chrono::steady_clock::now();
+
+    reader.readFrames(frames, [&](size_t, uint32_t frameNumber, const uint16_t* pixels,
+                                  const vraw::FrameHeader& header) {
+        // One DNG buffer per worker, reused across frames
+        thread_local std::vector<uint8_t> dng;
+        char name[32];
+        snprintf(name, sizeof(name), "_%06u.dng", frameNumber);
+        const std::string path = (std::filesystem::path(paths[1]) / (prefix + name)).string();
+
+        if (!pixels || !vraw::DngWriter::encode(fileHeader, header, pixels, dngOptions, dng) ||
+            !writeFile(path, dng)) {
+            std::cerr << "Failed to export frame " << frameNumber << " to " << path << std::endl;
+            failed++;
+            return;
+        }
+        written++;
+        bytes += dng.size();
+    }, readOptions);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+    std::cout << "Exported " << written << " of " << frames.size() << " frames to " << paths[1]
+              << " (" << bytes / (1024 * 1024) << " MB, "
+              << (seconds > 0.0 ? written / seconds : 0.0) << " frames/s)" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
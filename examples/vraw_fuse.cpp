@@ -0,0 +1,518 @@
+/**
+ * vraw_fuse - Mount VRAW clips as folders of DNG frames
+ *
+ * Usage: vraw_fuse [options] <clip_dir> <mountpoint> [FUSE options]
+ *   --cache-mb <n>     Synthesised frames kept in memory (default: 1024 MB)
+ *   --read-ahead <n>   Frames synthesised ahead of sequential readers (default: 8)
+ *   --threads <n>      Read-ahead threads (default: hardware concurrency)
+ *   --packed           Store samples at the clip's bit depth instead of 16 bits
+ *
+ * Every .vraw file in clip_dir appears as a read-only folder named after
+ * the clip, holding <clip>_000000.dng, <clip>_000001.dng, ... Nothing is
+ * written to disk: a DNG is synthesised (decode + DngWriter) the first
+ * time it is read and kept in an LRU cache. Reading frame n right after
+ * frame n - 1 queues the next frames on the read-ahead threads, and
+ * concurrent readers decode in parallel, each with a reader of its own.
+ * Unmount with `fusermount3 -u <mountpoint>`.
+ */
+
+#define FUSE_USE_VERSION 31
+
+#include <vraw.h>
+#include <fuse.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using FrameData = std::shared_ptr<const std::vector<uint8_t>>;
+
+struct Clip {
+    std::string name;
+    std::string path;
+    vraw::FileHeader header;
+    uint32_t frameCount = 0;
+    uint64_t dngSize = 0;
+    struct timespec mtime = {};
+    vraw::DngOptions options;
+
+    // Open readers not in use; one per concurrent decode
+    std::mutex readerMutex;
+    std::vector<std::unique_ptr<vraw::VrawReader>> idleReaders;
+
+    // Last frame read, for detecting sequential playback
+    std::mutex accessMutex;
+    uint32_t lastFrame = UINT32_MAX;
+};
+
+class VrawFs {
+public:
+    struct Options {
+        uint64_t cacheBytes = 1024ull * 1024 * 1024;
+        uint32_t readAhead = 8;
+        unsigned threads = 0;
+        bool packed = false;
+    };
+
+    bool load(const std::string& dir, const Options& options);
+    void startWorkers();
+    void stopWorkers();
+
+    int getattr(const char* path, struct stat* st);
+    int readdir(const char* path, void* buf, fuse_fill_dir_t fill);
+    int open(const char* path, struct fuse_file_info* fi);
+    int read(const char* path, char* buf, size_t size, off_t offset);
+
+private:
+    struct CacheEntry {
+        FrameData data;
+        bool ready = false;
+        std::list<uint64_t>::iterator lru;  // Valid once ready
+    };
+
+    bool resolve(const char* path, Clip*& clip, uint32_t& frame) const;
+    FrameData getFrame(Clip& clip, uint32_t clipIndex, uint32_t frame);
+    FrameData synthesise(Clip& clip, uint32_t frame);
+    void prefetch(uint32_t clipIndex, uint32_t frame);
+    void workerLoop();
+    static uint64_t key(uint32_t clipIndex, uint32_t frame) {
+        return (static_cast<uint64_t>(clipIndex) << 32) | frame;
+    }
+
+    Options options_;
+    std::vector<std::unique_ptr<Clip>> clips_;
+    std::map<std::string, uint32_t> clipsByName_;
+
+    // LRU of synthesised frames; pending entries are being synthesised
+    std::mutex cacheMutex_;
+    std::condition_variable cacheCv_;
+    std::unordered_map<uint64_t, CacheEntry> cache_;
+    std::list<uint64_t> lru_;  // Most recently used first
+    uint64_t cacheBytes_ = 0;
+
+    // Read-ahead queue
+    std::mutex queueMutex_;
+    std::condition_variable queueCv_;
+    std::deque<uint64_t> queue_;
+    std::vector<std::thread> workers_;
+    bool stopping_ = false;
+};
+
+std::string frameName(const Clip& clip, uint32_t frame) {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_%06u.dng", frame);
+    return clip.name + suffix;
+}
+
+bool VrawFs::load(const std::string& dir, const Options& options) {
+    options_ = options;
+    std::error_code ec;
+    for (const fs::directory_entry& entry : fs::directory_iterator(dir, ec)) {
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (!entry.is_regular_file(ec) || (ext != ".vraw" && ext != ".mraw")) {
+            continue;
+        }
+
+        auto clip = std::make_unique<Clip>();
+        clip->path = entry.path().string();
+        clip->name = entry.path().stem().string();
+        auto reader = std::make_unique<vraw::VrawReader>();
+        if (clipsByName_.count(clip->name) || !reader->open(clip->path) || reader->getFrameCount() == 0) {
+            continue;
+        }
+        clip->header = reader->getFileHeader();
+        clip->frameCount = reader->getFrameCount();
+        clip->options.packed = options.packed;
+        vraw::FrameHeader first;
+        vraw::FrameHeader last;
+        if (clip->frameCount > 1 && reader->readFrameHeader(0, first) &&
+            reader->readFrameHeader(clip->frameCount - 1, last) && last.timestampUs > first.timestampUs) {
+            clip->options.frameRate = static_cast<float>(
+                (clip->frameCount - 1) * 1e6 / static_cast<double>(last.timestampUs - first.timestampUs));
+        }
+        clip->dngSize = vraw::DngWriter::encodedSize(clip->header, clip->options);
+        if (clip->dngSize == 0) {
+            std::cerr << "Skipping " << clip->path << ": cannot be represented as DNG" << std::endl;
+            continue;
+        }
+        struct stat st;
+        if (stat(clip->path.c_str(), &st) == 0) {
+            clip->mtime = st.st_mtim;
+        }
+        reader->setOutputLayout(vraw::FrameLayout::MOSAIC);
+        clip->idleReaders.push_back(std::move(reader));
+
+        clipsByName_[clip->name] = static_cast<uint32_t>(clips_.size());
+        clips_.push_back(std::move(clip));
+    }
+    if (ec) {
+        std::cerr << "Failed to read " << dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void VrawFs::startWorkers() {
+    unsigned threads = options_.threads ? options_.threads : std::thread::hardware_concurrency();
+    threads = std::max(1u, threads);
+    stopping_ = false;
+    for (unsigned t = 0; t < threads && options_.readAhead > 0; ++t) {
+        workers_.emplace_back(&VrawFs::workerLoop, this);
+    }
+}
+
+void VrawFs::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        stopping_ = true;
+        queue_.clear();
+    }
+    queueCv_.notify_all();
+    for (std::thread& t : workers_) {
+        t.join();
+    }
+    workers_.clear();
+}
+
+bool VrawFs::resolve(const char* path, Clip*& clip, uint32_t& frame) const {
+    // "/<clip>" or "/<clip>/<clip>_<frame>.dng"
+    const std::string p(path);
+    const size_t slash = p.find('/', 1);
+    const auto it = clipsByName_.find(p.substr(1, slash == std::string::npos ? std::string::npos : slash - 1));
+    if (it == clipsByName_.end()) {
+        return false;
+    }
+    clip = clips_[it->second].get();
+    frame = UINT32_MAX;
+    if (slash == std::string::npos) {
+        return true;
+    }
+
+    const std::string file = p.substr(slash + 1);
+    const std::string prefix = clip->name + "_";
+    if (file.size() <= prefix.size() + 4 || file.compare(0, prefix.size(), prefix) != 0 ||
+        file.compare(file.size() - 4, 4, ".dng") != 0) {
+        return false;
+    }
+    const std::string digits = file.substr(prefix.size(), file.size() - prefix.size() - 4);
+    if (digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    const unsigned long number = strtoul(digits.c_str(), nullptr, 10);
+    if (number >= clip->frameCount || frameName(*clip, static_cast<uint32_t>(number)) != file) {
+        return false;
+    }
+    frame = static_cast<uint32_t>(number);
+    return true;
+}
+
+int VrawFs::getattr(const char* path, struct stat* st) {
+    memset(st, 0, sizeof(*st));
+    if (strcmp(path, "/") == 0) {
+        st->st_mode = S_IFDIR | 0555;
+        st->st_nlink = 2 + clips_.size();
+        return 0;
+    }
+    Clip* clip;
+    uint32_t frame;
+    if (!resolve(path, clip, frame)) {
+        return -ENOENT;
+    }
+    st->st_mtim = clip->mtime;
+    st->st_ctim = clip->mtime;
+    st->st_atim = clip->mtime;
+    if (frame == UINT32_MAX) {
+        st->st_mode = S_IFDIR | 0555;
+        st->st_nlink = 2;
+    } else {
+        st->st_mode = S_IFREG | 0444;
+        st->st_nlink = 1;
+        st->st_size = static_cast<off_t>(clip->dngSize);
+    }
+    return 0;
+}
+
+int VrawFs::readdir(const char* path, void* buf, fuse_fill_dir_t fill) {
+    fill(buf, ".", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+    fill(buf, "..", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+    if (strcmp(path, "/") == 0) {
+        for (const auto& clip : clips_) {
+            fill(buf, clip->name.c_str(), nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+        }
+        return 0;
+    }
+    Clip* clip;
+    uint32_t frame;
+    if (!resolve(path, clip, frame) || frame != UINT32_MAX) {
+        return -ENOENT;
+    }
+    for (uint32_t f = 0; f < clip->frameCount; ++f) {
+        if (fill(buf, frameName(*clip, f).c_str(), nullptr, 0, static_cast<fuse_fill_dir_flags>(0)) != 0) {
+            break;
+        }
+    }
+    return 0;
+}
+
+int VrawFs::open(const char* path, struct fuse_file_info* fi) {
+    Clip* clip;
+    uint32_t frame;
+    if (!resolve(path, clip, frame) || frame == UINT32_MAX) {
+        return -ENOENT;
+    }
+    if ((fi->flags & O_ACCMODE) != O_RDONLY) {
+        return -EROFS;
+    }
+    fi->keep_cache = 1;  // Contents never change; let the page cache keep them
+    return 0;
+}
+
+int VrawFs::read(const char* path, char* buf, size_t size, off_t offset) {
+    Clip* clip;
+    uint32_t frame;
+    if (!resolve(path, clip, frame) || frame == UINT32_MAX) {
+        return -ENOENT;
+    }
+    if (offset < 0 || static_cast<uint64_t>(offset) >= clip->dngSize) {
+        return 0;
+    }
+
+    const uint32_t clipIndex = clipsByName_.at(clip->name);
+    bool sequential = false;
+    {
+        std::lock_guard<std::mutex> lock(clip->accessMutex);
+        if (frame != clip->lastFrame) {
+            sequential = (clip->lastFrame != UINT32_MAX && frame == clip->lastFrame + 1);
+            clip->lastFrame = frame;
+        }
+    }
+    if (sequential) {
+        for (uint32_t f = frame + 1; f <= frame + options_.readAhead && f < clip->frameCount; ++f) {
+            prefetch(clipIndex, f);
+        }
+    }
+
+    const FrameData data = getFrame(*clip, clipIndex, frame);
+    if (!data) {
+        return -EIO;
+    }
+    const size_t count = std::min<uint64_t>(size, data->size() - static_cast<uint64_t>(offset));
+    memcpy(buf, data->data() + offset, count);
+    return static_cast<int>(count);
+}
+
+FrameData VrawFs::synthesise(Clip& clip, uint32_t frame) {
+    std::unique_ptr<vraw::VrawReader> reader;
+    {
+        std::lock_guard<std::mutex> lock(clip.readerMutex);
+        if (!clip.idleReaders.empty()) {
+            reader = std::move(clip.idleReaders.back());
+            clip.idleReaders.pop_back();
+        }
+    }
+    if (!reader) {
+        reader = std::make_unique<vraw::VrawReader>();
+        if (!reader->open(clip.path)) {
+            return nullptr;
+        }
+        reader->setOutputLayout(vraw::FrameLayout::MOSAIC);
+    }
+
+    // Thread-local decode buffer; the DNG itself is handed to the cache
+    thread_local std::vector<uint16_t> mosaic;
+    mosaic.resize(static_cast<size_t>(clip.header.width) * clip.header.height);
+    vraw::FrameHeader header;
+    auto dng = std::make_shared<std::vector<uint8_t>>();
+    const bool ok = reader->readFrameInto(frame, mosaic.data(), mosaic.size() * sizeof(uint16_t), &header) &&
+                    vraw::DngWriter::encode(clip.header, header, mosaic.data(), clip.options, *dng);
+
+    {
+        std::lock_guard<std::mutex> lock(clip.readerMutex);
+        clip.idleReaders.push_back(std::move(reader));
+    }
+    return ok ? dng : nullptr;
+}
+
+FrameData VrawFs::getFrame(Clip& clip, uint32_t clipIndex, uint32_t frame) {
+    const uint64_t k = key(clipIndex, frame);
+    std::unique_lock<std::mutex> lock(cacheMutex_);
+    auto it = cache_.find(k);
+    if (it != cache_.end()) {
+        // Synthesised already, or in progress on another thread
+        cacheCv_.wait(lock, [&]() {
+            it = cache_.find(k);
+            return it == cache_.end() || it->second.ready;
+        });
+        if (it != cache_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            return it->second.data;
+        }
+    }
+    cache_[k];  // Pending: concurrent readers of this frame wait for us
+    lock.unlock();
+
+    FrameData data = synthesise(clip, frame);
+
+    lock.lock();
+    if (!data) {
+        cache_.erase(k);
+        cacheCv_.notify_all();
+        return nullptr;
+    }
+    CacheEntry& entry = cache_[k];
+    entry.data = data;
+    entry.ready = true;
+    lru_.push_front(k);
+    entry.lru = lru_.begin();
+    cacheBytes_ += data->size();
+    while (cacheBytes_ > options_.cacheBytes && lru_.size() > 1) {
+        auto victim = cache_.find(lru_.back());
+        cacheBytes_ -= victim->second.data->size();
+        cache_.erase(victim);
+        lru_.pop_back();
+    }
+    cacheCv_.notify_all();
+    return data;
+}
+
+void VrawFs::prefetch(uint32_t clipIndex, uint32_t frame) {
+    const uint64_t k = key(clipIndex, frame);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        if (cache_.count(k)) {
+            return;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        if (workers_.empty() || std::find(queue_.begin(), queue_.end(), k) != queue_.end()) {
+            return;
+        }
+        queue_.push_back(k);
+    }
+    queueCv_.notify_one();
+}
+
+void VrawFs::workerLoop() {
+    for (;;) {
+        uint64_t k;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            queueCv_.wait(lock, [&]() { return stopping_ || !queue_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            k = queue_.front();
+            queue_.pop_front();
+        }
+        const uint32_t clipIndex = static_cast<uint32_t>(k >> 32);
+        getFrame(*clips_[clipIndex], clipIndex, static_cast<uint32_t>(k));
+    }
+}
+
+VrawFs* fsFromContext() {
+    return static_cast<VrawFs*>(fuse_get_context()->private_data);
+}
+
+void* fsInit(struct fuse_conn_info*, struct fuse_config* config) {
+    // Workers start here, after FUSE has daemonised
+    config->kernel_cache = 1;
+    config->entry_timeout = 3600.0;
+    config->attr_timeout = 3600.0;
+    VrawFs* vfs = fsFromContext();
+    vfs->startWorkers();
+    return vfs;
+}
+
+void fsDestroy(void* data) {
+    static_cast<VrawFs*>(data)->stopWorkers();
+}
+
+int fsGetattr(const char* path, struct stat* st, struct fuse_file_info*) {
+    return fsFromContext()->getattr(path, st);
+}
+
+int fsReaddir(const char* path, void* buf, fuse_fill_dir_t fill, off_t, struct fuse_file_info*,
+              enum fuse_readdir_flags) {
+    return fsFromContext()->readdir(path, buf, fill);
+}
+
+int fsOpen(const char* path, struct fuse_file_info* fi) {
+    return fsFromContext()->open(path, fi);
+}
+
+int fsRead(const char* path, char* buf, size_t size, off_t offset, struct fuse_file_info*) {
+    return fsFromContext()->read(path, buf, size, offset);
+}
+
+void printUsage() {
+    std::cerr << "Usage: vraw_fuse [--cache-mb <n>] [--read-ahead <n>] [--threads <n>] [--packed] "
+                 "<clip_dir> <mountpoint> [FUSE options]" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    VrawFs::Options options;
+    std::string clipDir;
+    std::vector<char*> fuseArgs = {argv[0]};
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc) {
+            options.cacheBytes = strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--read-ahead") == 0 && i + 1 < argc) {
+            options.readAhead = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = static_cast<unsigned>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--packed") == 0) {
+            options.packed = true;
+        } else if (clipDir.empty() && argv[i][0] != '-') {
+            clipDir = argv[i];
+        } else {
+            fuseArgs.push_back(argv[i]);  // Mountpoint and FUSE options
+        }
+    }
+    if (clipDir.empty() || fuseArgs.size() < 2) {
+        printUsage();
+        return 1;
+    }
+
+    // FUSE changes directory when it daemonises
+    std::error_code ec;
+    clipDir = fs::absolute(clipDir, ec).string();
+
+    VrawFs vfs;
+    if (!vfs.load(clipDir, options)) {
+        return 1;
+    }
+
+    struct fuse_operations ops = {};
+    ops.init = fsInit;
+    ops.destroy = fsDestroy;
+    ops.getattr = fsGetattr;
+    ops.readdir = fsReaddir;
+    ops.open = fsOpen;
+    ops.read = fsRead;
+    return fuse_main(static_cast<int>(fuseArgs.size()), fuseArgs.data(), &ops, &vfs);
+}
@@ -2,11 +2,26 @@
  * vraw_info - Display information about VRAW files
  *
  * Usage: vraw_info <file.vraw>
+ *        vraw_info --analyze [--json] <file.vraw>...
+ *
+ * --analyze reads every frame header (in parallel, no pixel data) and
+ * reports bitrate over time, compression ratios, timestamp gaps and
+ * audio/video drift. With --json the output is one JSON array holding
+ * an object per file that could be opened.
  */
 
 #include <vraw.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// On-disk header ahead of every frame payload (see vraw.h)
+static const uint64_t FRAME_HEADER_BYTES = 64;
 
 const char* encodingToString(vraw::Encoding enc) {
     switch (enc) {
@@ -16,6 +31,7 @@ const char* encodingToString(vraw::Encoding enc) {
         case vraw::Encoding::CINEON_10BIT: return "CINEON_10BIT (reserved)";
         case vraw::Encoding::LOG2_12BIT: return "LOG2_12BIT";
         case vraw::Encoding::LINEAR_12BIT: return "LINEAR_12BIT";
+        case vraw::Encoding::LINEAR_14BIT: return "LINEAR_14BIT";
         default: return "UNKNOWN";
     }
 }
@@ -40,21 +56,16 @@ const char* bayerToString(vraw::BayerPattern bp) {
     }
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: vraw_info <file.vraw>" << std::endl;
-        return 1;
-    }
-
+static int printInfo(const char* path) {
     vraw::VrawReader reader;
-    if (!reader.open(argv[1])) {
-        std::cerr << "Error: Failed to open " << argv[1] << std::endl;
+    if (!reader.open(path)) {
+        std::cerr << "Error: Failed to open " << path << std::endl;
         return 1;
     }
 
     const auto& h = reader.getFileHeader();
 
-    std::cout << "VRAW File: " << argv[1] << std::endl;
+    std::cout << "VRAW File: " << path << std::endl;
     std::cout << std::string(60, '=') << std::endl;
     std::cout << std::endl;
 
@@ -102,6 +113,13 @@ int main(int argc, char* argv[]) {
         std::cout << "  Sample Rate:    " << h.audioSampleRate << " Hz" << std::endl;
         std::cout << "  Channels:       " << static_cast<int>(h.audioChannels) << std::endl;
         std::cout << "  Bit Depth:      " << static_cast<int>(h.audioBitDepth) << " bit" << std::endl;
+        if (reader.hasAudioPeaks()) {
+            std::cout << "  Peak Overview:  per";
+            for (uint32_t samples : reader.getAudioPeakResolutions()) {
+                std::cout << " " << samples;
+            }
+            std::cout << " samples" << std::endl;
+        }
         std::cout << std::endl;
     }
 
@@ -124,3 +142,259 @@ int main(int argc, char* argv[]) {
     reader.close();
     return 0;
 }
+
+// Value at fraction q of a sorted list
+static double percentile(const std::vector<double>& sorted, double q) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    return sorted[static_cast<size_t>(q * (sorted.size() - 1) + 0.5)];
+}
+
+// JSON string literal: quotes, backslashes and control characters escaped
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (const char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// Appends the report for one file to `report`
+static int analyze(const char* path, bool json, std::string& report) {
+    vraw::VrawReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Error: Failed to open " << path << std::endl;
+        return 1;
+    }
+    const auto& h = reader.getFileHeader();
+    const uint32_t frameCount = reader.getFrameCount();
+
+    // Frame headers only, split across threads
+    std::vector<vraw::FrameHeader> headers(frameCount);
+    std::vector<uint8_t> ok(frameCount, 0);
+    const unsigned threads = std::max(1u, std::min(std::thread::hardware_concurrency(), 16u));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (uint32_t i = t; i < frameCount; i += threads) {
+                ok[i] = reader.readFrameHeader(i, headers[i]) ? 1 : 0;
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    uint32_t unreadable = 0;
+    std::vector<uint64_t> timestamps;
+    std::vector<uint64_t> payloadBytes;
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        if (!ok[i]) {
+            unreadable++;
+            continue;
+        }
+        timestamps.push_back(headers[i].timestampUs);
+        payloadBytes.push_back(headers[i].compressedSize ? headers[i].compressedSize
+                                                         : headers[i].uncompressedSize);
+    }
+    const size_t n = timestamps.size();
+
+    // Timing: the median delta is taken as the nominal frame interval
+    std::vector<int64_t> deltas;
+    for (size_t i = 1; i < n; ++i) {
+        deltas.push_back(static_cast<int64_t>(timestamps[i] - timestamps[i - 1]));
+    }
+    std::vector<int64_t> sortedDeltas = deltas;
+    std::sort(sortedDeltas.begin(), sortedDeltas.end());
+    const int64_t interval = sortedDeltas.empty() ? 0 : sortedDeltas[sortedDeltas.size() / 2];
+    uint32_t gaps = 0;
+    uint64_t droppedFrames = 0;
+    uint32_t duplicates = 0;
+    uint32_t backwards = 0;
+    for (int64_t d : deltas) {
+        if (d < 0) {
+            backwards++;
+        } else if (interval > 0 && d * 2 < interval) {
+            duplicates++;
+        } else if (interval > 0 && d * 2 > interval * 3) {
+            gaps++;
+            droppedFrames += static_cast<uint64_t>((d + interval / 2) / interval) - 1;
+        }
+    }
+    const uint64_t videoStartUs = n ? timestamps.front() : 0;
+    const uint64_t videoDurationUs = (n && timestamps.back() > timestamps.front())
+        ? timestamps.back() - timestamps.front() + static_cast<uint64_t>(std::max<int64_t>(interval, 0))
+        : 0;
+
+    // Compression ratio against 16-bit samples
+    const double rawBytes = static_cast<double>(h.width) * h.height * 2;
+    std::vector<double> ratios;
+    uint64_t totalBytes = 0;
+    for (uint64_t bytes : payloadBytes) {
+        ratios.push_back(bytes ? rawBytes / bytes : 0.0);
+        totalBytes += bytes + FRAME_HEADER_BYTES;
+    }
+    std::sort(ratios.begin(), ratios.end());
+
+    // Bitrate per second of footage
+    std::vector<double> bitrates;
+    if (n) {
+        std::vector<uint64_t> perSecond;
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t second = (timestamps[i] - videoStartUs) / 1000000;
+            if (timestamps[i] < videoStartUs || second > 24 * 3600) {
+                continue;
+            }
+            if (perSecond.size() <= second) {
+                perSecond.resize(second + 1, 0);
+            }
+            perSecond[second] += (payloadBytes[i] + FRAME_HEADER_BYTES) * 8;
+        }
+        for (uint64_t bits : perSecond) {
+            bitrates.push_back(bits / 1e6);
+        }
+        // The last second is usually partial: rate it over the span it covers
+        const uint64_t lastStartUs = (perSecond.size() - 1) * 1000000ull;
+        if (!bitrates.empty() && videoDurationUs > lastStartUs && videoDurationUs - lastStartUs < 1000000) {
+            bitrates.back() = perSecond.back() / static_cast<double>(videoDurationUs - lastStartUs);
+        }
+    }
+    const double avgBitrate = videoDurationUs ? totalBytes * 8.0 / videoDurationUs : 0.0;  // Mbit/s
+    // Even scaled, a short last second is a noisy sample; keep it out of min/max
+    std::vector<double> sortedBitrates(bitrates.begin(),
+                                       bitrates.size() > 1 ? bitrates.end() - 1 : bitrates.end());
+    std::sort(sortedBitrates.begin(), sortedBitrates.end());
+
+    // Audio against video, from the audio stream header
+    vraw::AudioHeader audio = {};
+    const bool hasAudio = h.hasAudio && reader.readAudioHeader(audio) && audio.sampleRate > 0;
+    const double audioDurationS = hasAudio ? static_cast<double>(audio.sampleCount) / audio.sampleRate : 0.0;
+    const double startOffsetS = hasAudio ? (static_cast<double>(audio.startTimestampUs) - videoStartUs) / 1e6 : 0.0;
+    const double driftS = hasAudio ? startOffsetS + audioDurationS - videoDurationUs / 1e6 : 0.0;
+
+    std::ostringstream out;
+    out << std::fixed;
+    if (json) {
+        out << std::setprecision(3) << "{\"path\": " << jsonString(path) << ", \"frames\": " << frameCount
+            << ", \"unreadable_headers\": " << unreadable
+            << ", \"duration_s\": " << videoDurationUs / 1e6
+            << ", \"frame_interval_us\": " << interval
+            << ", \"timing\": {\"gaps\": " << gaps << ", \"dropped_frames\": " << droppedFrames
+            << ", \"duplicates\": " << duplicates << ", \"backwards\": " << backwards << "}"
+            << ", \"compression_ratio\": {\"min\": " << percentile(ratios, 0.0)
+            << ", \"p5\": " << percentile(ratios, 0.05) << ", \"median\": " << percentile(ratios, 0.5)
+            << ", \"p95\": " << percentile(ratios, 0.95) << ", \"max\": " << percentile(ratios, 1.0) << "}"
+            << ", \"bitrate_mbps\": {\"average\": " << avgBitrate
+            << ", \"min\": " << percentile(sortedBitrates, 0.0)
+            << ", \"max\": " << percentile(sortedBitrates, 1.0) << ", \"per_second\": [";
+        for (size_t i = 0; i < bitrates.size(); ++i) {
+            out << (i ? ", " : "") << bitrates[i];
+        }
+        out << "]}";
+        if (hasAudio) {
+            out << ", \"audio\": {\"duration_s\": " << audioDurationS
+                << ", \"start_offset_s\": " << startOffsetS << ", \"drift_s\": " << driftS << "}";
+        }
+        out << "}";
+        report += out.str();
+        return 0;
+    }
+
+    out << "Analysis: " << path << std::endl;
+    out << std::string(60, '=') << std::endl << std::endl;
+    out << "Timing:" << std::endl;
+    out << "  Frames:         " << frameCount;
+    if (unreadable) {
+        out << " (" << unreadable << " unreadable headers)";
+    }
+    out << std::endl;
+    out << std::setprecision(3);
+    out << "  Duration:       " << videoDurationUs / 1e6 << " s" << std::endl;
+    out << "  Frame Interval: " << interval << " us";
+    if (interval > 0) {
+        out << " (" << std::setprecision(2) << 1e6 / interval << " fps)";
+    }
+    out << std::endl;
+    out << "  Gaps:           " << gaps << " (" << droppedFrames << " frames missing)" << std::endl;
+    out << "  Duplicates:     " << duplicates << std::endl;
+    out << "  Backwards:      " << backwards << std::endl << std::endl;
+
+    out << std::setprecision(2);
+    out << "Compression Ratio (vs 16-bit):" << std::endl;
+    out << "  Min / Median / Max: " << percentile(ratios, 0.0) << " / " << percentile(ratios, 0.5)
+        << " / " << percentile(ratios, 1.0) << std::endl;
+    out << "  5th-95th pct:       " << percentile(ratios, 0.05) << " - " << percentile(ratios, 0.95)
+        << std::endl << std::endl;
+
+    out << std::setprecision(1);
+    out << "Bitrate:" << std::endl;
+    out << "  Average:        " << avgBitrate << " Mbit/s" << std::endl;
+    out << "  Per Second:     " << percentile(sortedBitrates, 0.0) << " - "
+        << percentile(sortedBitrates, 1.0) << " Mbit/s over " << bitrates.size() << " s" << std::endl;
+    out << std::endl;
+
+    if (hasAudio) {
+        out << std::setprecision(3);
+        out << "Audio/Video:" << std::endl;
+        out << "  Audio Duration: " << audioDurationS << " s" << std::endl;
+        out << "  Start Offset:   " << startOffsetS << " s" << std::endl;
+        out << "  End Drift:      " << driftS << " s" << std::endl << std::endl;
+    }
+    report += out.str();
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    bool analyzeMode = false;
+    bool json = false;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--analyze") == 0) {
+            analyzeMode = true;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty() || (!analyzeMode && (json || files.size() > 1))) {
+        std::cerr << "Usage: vraw_info <file.vraw>" << std::endl;
+        std::cerr << "       vraw_info --analyze [--json] <file.vraw>..." << std::endl;
+        return 1;
+    }
+    if (!analyzeMode) {
+        return printInfo(files[0]);
+    }
+
+    int status = 0;
+    std::vector<std::string> reports;
+    for (const char* file : files) {
+        std::string report;
+        status |= analyze(file, json, report);
+        if (!report.empty()) {
+            reports.push_back(report);
+        }
+    }
+    if (json) {
+        std::cout << "[";
+        for (size_t i = 0; i < reports.size(); ++i) {
+            std::cout << (i ? ",\n " : "\n ") << reports[i];
+        }
+        std::cout << "\n]" << std::endl;
+    } else {
+        for (const std::string& report : reports) {
+            std::cout << report;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,86 @@
+/**
+ * vraw_scan - Catalogue VRAW clips in directory trees
+ *
+ * Usage: vraw_scan [options] <dir|file>...
+ *   --json             Print the catalogue as JSON instead of a table
+ *   --cache <file>     Reuse and update a scan cache (incremental rescans)
+ *   --threads <n>      Scan threads (default: hardware concurrency)
+ *   --no-recurse       Do not descend into subdirectories
+ */
+
+#include <vraw.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+static void printUsage() {
+    std::cerr << "Usage: vraw_scan [--json] [--cache <file>] [--threads <n>] [--no-recurse] "
+                 "<dir|file>..." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    vraw::ClipScanner::Options options;
+    std::vector<std::string> roots;
+    std::string cachePath;
+    bool json = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cachePath = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = static_cast<unsigned>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--no-recurse") == 0) {
+            options.recursive = false;
+        } else if (argv[i][0] == '-') {
+            printUsage();
+            return 1;
+        } else {
+            roots.push_back(argv[i]);
+        }
+    }
+    if (roots.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    vraw::ClipScanner scanner;
+    if (!cachePath.empty()) {
+        scanner.loadCache(cachePath);
+    }
+    std::vector<vraw::ClipInfo> clips;
+    const bool ok = scanner.scan(roots, options, clips);
+    if (!cachePath.empty()) {
+        scanner.saveCache(cachePath);
+    }
+
+    if (json) {
+        std::cout << vraw::ClipScanner::toJson(clips);
+        return ok ? 0 : 1;
+    }
+
+    uint64_t totalBytes = 0;
+    uint64_t totalDurationUs = 0;
+    std::cout << std::left << std::setw(11) << "Resolution" << std::right << std::setw(8) << "Frames"
+              << std::setw(11) << "Duration" << std::setw(12) << "Mbit/s" << std::setw(7) << "Audio"
+              << "  Path" << std::endl;
+    for (const vraw::ClipInfo& c : clips) {
+        std::cout << std::left << std::setw(11) << (std::to_string(c.width) + "x" + std::to_string(c.height))
+                  << std::right << std::setw(8) << c.frameCount
+                  << std::setw(10) << std::fixed << std::setprecision(2) << c.durationUs / 1e6 << "s"
+                  << std::setw(12) << std::setprecision(1) << c.bitrate / 1e6
+                  << std::setw(7) << (c.hasAudio ? std::to_string(c.audioChannels) + "ch" : "-")
+                  << "  " << c.path << (c.finalized ? "" : " (unfinished)") << std::endl;
+        totalBytes += c.fileSize;
+        totalDurationUs += c.durationUs;
+    }
+    std::cout << std::endl << clips.size() << " clips, " << std::setprecision(2)
+              << totalBytes / 1e9 << " GB, " << totalDurationUs / 60e6 << " min ("
+              << scanner.getReadCount() << " read, " << scanner.getCachedCount() << " cached)"
+              << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+/**
+ * VRAW Library - Batched Frame Loader
+ *
+ * Assembles shuffled batches of frames from many VRAW files into
+ * contiguous tensor buffers for training pipelines.
+ * https://github.com/JohanAberg/vraw-lib
+ */
+
+#ifndef VRAW_BATCH_LOADER_H
+#define VRAW_BATCH_LOADER_H
+
+#include "VrawTypes.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace vraw {
+
+class VrawReader;
+namespace detail { class ThreadPool; }
+
+// Batch tensor layout
+enum class TensorLayout : uint8_t {
+    MOSAIC = 0,      // N x 1 x H x W (interleaved Bayer mosaic)
+    CFA_PLANES = 1   // N x 4 x H/2 x W/2 (R, G1, G2, B planes)
+};
+
+// Batch tensor element type
+enum class TensorType : uint8_t {
+    UINT16 = 0,      // Stored code values
+    FLOAT32 = 1      // Normalized to [0, 1] (see BatchLoader::Options::normalize)
+};
+
+// One (file, frame) sample
+struct BatchSample {
+    std::string path;
+    uint32_t frameNumber;
+};
+
+/**
+ * BatchLoader - Decode shuffled batches of frames into contiguous buffers.
+ *
+ * Samples are decoded in parallel straight into preallocated, page-aligned
+ * batch buffers (locked in RAM when possible, so they can be registered
+ * with a GPU runtime as pinned host memory). A producer thread keeps
+ * `prefetchBatches` batches ready ahead of the consumer.
+ *
+ * Example usage:
+ *   BatchLoader loader;
+ *   BatchLoader::Options opts;
+ *   opts.batchSize = 16;
+ *   opts.layout = TensorLayout::CFA_PLANES;
+ *   loader.init(samples, opts);
+ *   BatchLoader::Batch batch;
+ *   while (loader.next(batch)) {
+ *       // batch.data stays valid until the next call to next()
+ *   }
+ *   loader.reset();  // reshuffle for the next epoch
+ */
+class BatchLoader {
+public:
+    struct Options {
+        uint32_t batchSize = 8;
+        TensorLayout layout = TensorLayout::MOSAIC;
+        TensorType dtype = TensorType::FLOAT32;
+        bool shuffle = true;
+        uint64_t seed = 0;            // Shuffle seed (combined with epoch number)
+        bool dropLast = false;        // Skip the final partial batch
+        bool normalize = true;        // FLOAT32: (v - black) / (white - black) per CFA channel
+        bool pinMemory = true;        // Lock batch buffers in RAM (best effort)
+        unsigned workerThreads = 0;   // Decode threads (0 = hardware concurrency)
+        unsigned prefetchBatches = 2; // Batches decoded ahead (2 = double buffering)
+    };
+
+    // A decoded batch. Owned by the loader; valid until the next call to next().
+    struct Batch {
+        const void* data = nullptr;
+        size_t bytes = 0;
+        uint32_t count = 0;          // Samples in this batch (<= batchSize)
+        uint32_t channels = 0;
+        uint32_t height = 0;
+        uint32_t width = 0;
+        TensorLayout layout = TensorLayout::MOSAIC;
+        TensorType dtype = TensorType::FLOAT32;
+        std::vector<uint32_t> sampleIndices;  // Index into the init() sample list
+        std::vector<FrameHeader> headers;
+        uint32_t failedCount = 0;    // Samples that failed to decode (zero-filled)
+    };
+
+    BatchLoader();
+    ~BatchLoader();
+
+    // Disable copy
+    BatchLoader(const BatchLoader&) = delete;
+    BatchLoader& operator=(const BatchLoader&) = delete;
+
+    /**
+     * Configure the loader and start prefetching the first epoch.
+     * Frame dimensions are taken from the first sample; samples with
+     * different dimensions are reported as failed.
+     *
+     * @return true on success
+     */
+    bool init(const std::vector<BatchSample>& samples, const Options& options);
+
+    /**
+     * Get the next batch, blocking until it is decoded.
+     *
+     * @return false at the end of the epoch
+     */
+    bool next(Batch& batch);
+
+    /**
+     * Start a new epoch (reshuffles when enabled).
+     */
+    void reset();
+
+    /**
+     * Stop workers and release buffers.
+     */
+    void close();
+
+    /**
+     * Number of batches per epoch.
+     */
+    uint32_t getBatchCount() const;
+
+    /**
+     * Size in bytes of one batch buffer.
+     */
+    size_t getBatchBytes() const;
+
+    /**
+     * Check whether batch buffers are locked in RAM.
+     */
+    bool isPinned() const;
+
+private:
+    enum class SlotState : uint8_t { FREE, READY, IN_USE };
+
+    struct Slot {
+        uint8_t* data = nullptr;
+        bool locked = false;
+        SlotState state = SlotState::FREE;
+        uint32_t sequence = 0;
+        Batch batch;
+    };
+
+    // Per-worker decode state: a few open readers plus a mosaic scratch frame
+    struct DecodeContext {
+        std::vector<std::pair<std::string, std::unique_ptr<VrawReader>>> readers;
+        std::vector<uint16_t> scratch;
+    };
+
+    bool allocateSlots();
+    void releaseSlots();
+    void shuffleOrder();
+    void startProducer();
+    void stopProducer();
+    void producerLoop();
+    void fillSlot(Slot& slot, uint32_t batchNumber);
+    bool decodeSample(uint32_t sampleIndex, uint8_t* dst, FrameHeader& header);
+    VrawReader* acquireReader(DecodeContext& ctx, const std::string& path);
+    DecodeContext* acquireContext();
+    void releaseContext(DecodeContext* ctx);
+
+    std::vector<BatchSample> samples_;
+    std::vector<uint32_t> order_;
+    Options options_;
+    uint32_t width_;
+    uint32_t height_;
+    size_t sampleBytes_;
+    size_t batchBytes_;
+    uint32_t epoch_;
+    bool initialized_;
+
+    std::vector<Slot> slots_;
+    std::unique_ptr<detail::ThreadPool> pool_;
+    std::vector<std::unique_ptr<DecodeContext>> contexts_;
+    std::vector<DecodeContext*> freeContexts_;
+    std::mutex contextMutex_;
+
+    std::thread producer_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    uint32_t nextConsume_;
+    int currentSlot_;
+    bool stopProducer_;
+};
+
+} // namespace vraw
+
+#endif // VRAW_BATCH_LOADER_H
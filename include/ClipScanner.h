@@ -0,0 +1,105 @@
+/**
+ * VRAW Library - Clip Scanner
+ *
+ * Catalogues VRAW clips across directory trees from their headers and
+ * trailers only, without opening a VrawReader or touching frame data.
+ * https://github.com/JohanAberg/vraw-lib
+ */
+
+#ifndef VRAW_CLIP_SCANNER_H
+#define VRAW_CLIP_SCANNER_H
+
+#include "VrawTypes.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vraw {
+
+// Catalogue entry for one clip
+struct ClipInfo {
+    std::string path;
+    uint64_t fileSize = 0;
+    uint64_t inode = 0;             // 0 where the platform has none
+    int64_t mtimeNs = 0;            // Modification time (ns since the epoch)
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    Encoding encoding = Encoding::LINEAR_12BIT;
+    Compression compression = Compression::NONE;
+    FrameLayout storageLayout = FrameLayout::MOSAIC;
+    uint32_t frameCount = 0;
+    bool finalized = false;         // Index written by stop(); otherwise counts are from checkpoints
+    uint64_t firstTimestampUs = 0;
+    uint64_t durationUs = 0;        // Last minus first timestamp, plus one frame interval
+    uint64_t videoBytes = 0;        // Frame headers and payloads
+    uint64_t bitrate = 0;           // Video bits per second (0 = unknown duration)
+
+    bool hasAudio = false;
+    uint16_t audioChannels = 0;
+    uint32_t audioSampleRate = 0;
+    uint64_t audioSampleCount = 0;
+
+    bool hasFrameStats = false;
+};
+
+class ClipScanner {
+public:
+    struct Options {
+        unsigned threads = 0;                        // Scan threads (0 = hardware concurrency)
+        bool recursive = true;                       // Descend into subdirectories
+        std::vector<std::string> extensions = {".vraw", ".mraw"};  // Case-insensitive
+    };
+
+    /**
+     * Read the catalogue entry of one clip: the file header, the first
+     * and last frame headers (found through the index) and the audio
+     * stream header. A handful of small reads; no frame payloads.
+     *
+     * @return false if the file is not a readable VRAW file
+     */
+    static bool readClipInfo(const std::string& path, ClipInfo& info);
+
+    /**
+     * Load a catalogue cache written by saveCache(). A missing or
+     * unreadable cache leaves the scanner empty.
+     */
+    bool loadCache(const std::string& path);
+
+    /**
+     * Save the catalogue of the last scan(), to make the next one incremental.
+     */
+    bool saveCache(const std::string& path) const;
+
+    /**
+     * Walk directories (or take files) in parallel and catalogue every VRAW
+     * clip found. Clips whose size, inode and modification time match the
+     * cache are taken from it without being opened.
+     *
+     * @param roots Directories and/or files
+     * @param clips Output, sorted by path
+     * @return false if a root could not be read
+     */
+    bool scan(const std::vector<std::string>& roots, const Options& options,
+              std::vector<ClipInfo>& clips);
+
+    /**
+     * Number of clips the last scan() took from the cache / read from disk.
+     */
+    size_t getCachedCount() const { return cachedCount_; }
+    size_t getReadCount() const { return readCount_; }
+
+    /**
+     * Format a catalogue as JSON (an array with one object per clip).
+     */
+    static std::string toJson(const std::vector<ClipInfo>& clips);
+
+private:
+    std::vector<ClipInfo> catalogue_;  // Sorted by path
+    size_t cachedCount_ = 0;
+    size_t readCount_ = 0;
+};
+
+} // namespace vraw
+
+#endif // VRAW_CLIP_SCANNER_H
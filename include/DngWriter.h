@@ -0,0 +1,80 @@
+/**
+ * VRAW Library - DNG Writer
+ *
+ * Builds single-frame (CinemaDNG sequence) DNG files from decoded VRAW
+ * mosaics, entirely in memory, with no external dependencies.
+ * https://github.com/JohanAberg/vraw-lib
+ */
+
+#ifndef VRAW_DNG_WRITER_H
+#define VRAW_DNG_WRITER_H
+
+#include "VrawTypes.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vraw {
+
+// Options for DngWriter
+struct DngOptions {
+    bool packed = false;           // Store samples at the clip's bit depth (10/12/14) instead of 16
+    float frameRate = 0.0f;        // CinemaDNG FrameRate tag (0 = omit)
+    std::string cameraModel = "VRAW";  // UniqueCameraModel
+    // XYZ (D65) to camera matrix for ColorMatrix1, row major. VRAW files
+    // carry no colour calibration, so the default is the identity.
+    float colorMatrix[9] = {1.0f, 0.0f, 0.0f,
+                            0.0f, 1.0f, 0.0f,
+                            0.0f, 0.0f, 1.0f};
+};
+
+/**
+ * DngWriter - Encode one frame as an uncompressed CFA DNG.
+ *
+ * Tags written:
+ *   - CFARepeatPatternDim / CFAPattern from the clip's BayerPattern
+ *   - BlackLevel (per CFA position, the frame's dynamic black level when
+ *     present) and WhiteLevel
+ *   - AsShotNeutral from the frame's white balance multipliers
+ *   - Orientation from the sensor orientation
+ *   - LinearizationTable for LOG2 encodings, so log codes are stored as-is
+ *   - FrameRate and TimeCodes (CinemaDNG) when known
+ *
+ * The file layout depends only on the clip and the options, so every
+ * frame of a clip encodes to the same number of bytes (encodedSize()).
+ *
+ * Example usage:
+ *   std::vector<uint8_t> dng;
+ *   DngWriter::encode(reader.getFileHeader(), header, mosaic, options, dng);
+ *   // write dng.data(), dng.size() in one call
+ */
+class DngWriter {
+public:
+    /**
+     * Encode a frame.
+     *
+     * @param file Clip header (dimensions, pattern, levels, encoding)
+     * @param frame Frame header (white balance, dynamic black level, number)
+     * @param mosaic width x height samples in MOSAIC layout, as decoded by VrawReader
+     * @param out Receives the complete DNG file (resized, previous contents discarded)
+     * @return false if the clip cannot be represented (odd dimensions, unknown encoding)
+     */
+    static bool encode(const FileHeader& file, const FrameHeader& frame, const uint16_t* mosaic,
+                       const DngOptions& options, std::vector<uint8_t>& out);
+
+    /**
+     * Size in bytes of every DNG encode() produces for this clip and options.
+     *
+     * @return 0 if the clip cannot be represented
+     */
+    static uint64_t encodedSize(const FileHeader& file, const DngOptions& options);
+
+    /**
+     * Sample bit depth of an encoding (10, 12 or 14; 0 if unknown).
+     */
+    static uint32_t bitDepth(Encoding encoding);
+};
+
+} // namespace vraw
+
+#endif // VRAW_DNG_WRITER_H
@@ -0,0 +1,223 @@
+/**
+ * VRAW Library - Input Sources
+ *
+ * Byte sources for VrawReader: file, memory-mapped file, memory buffer
+ * and user callbacks.
+ * https://github.com/JohanAberg/vraw-lib
+ */
+
+#ifndef VRAW_INPUT_SOURCE_H
+#define VRAW_INPUT_SOURCE_H
+
+#include "VrawTypes.h"
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vraw {
+
+/**
+ * One destination buffer of a scatter read.
+ */
+struct ReadSlice {
+    void* data;
+    size_t size;
+};
+
+/**
+ * InputSource - Random-access byte source used by VrawReader.
+ *
+ * All reads are positional, so built-in sources can be shared by several
+ * threads without external locking.
+ */
+class InputSource {
+public:
+    virtual ~InputSource() = default;
+
+    /**
+     * Read exactly `size` bytes starting at `offset`.
+     *
+     * @return false on I/O error or if the range extends past size()
+     */
+    virtual bool readAt(uint64_t offset, void* dst, size_t size) = 0;
+
+    /**
+     * Read consecutive bytes starting at `offset` into several buffers, in
+     * order. The default issues one readAt() per slice.
+     */
+    virtual bool readAtv(uint64_t offset, const ReadSlice* slices, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if (!readAt(offset, slices[i].data, slices[i].size)) {
+                return false;
+            }
+            offset += slices[i].size;
+        }
+        return true;
+    }
+
+    /**
+     * Total size of the source in bytes.
+     */
+    virtual uint64_t size() const = 0;
+
+    /**
+     * Zero-copy view of [offset, offset + size), valid for the lifetime of
+     * the source. Returns nullptr when unsupported or out of range; callers
+     * then fall back to readAt().
+     */
+    virtual const uint8_t* map(uint64_t offset, size_t size) {
+        (void)offset;
+        (void)size;
+        return nullptr;
+    }
+
+    /**
+     * Hint the expected access pattern (page-cache read-ahead policy).
+     */
+    virtual void adviseAccess(AccessHint hint) { (void)hint; }
+
+    /**
+     * Hint that [offset, offset + size) will be read soon.
+     */
+    virtual void willNeed(uint64_t offset, uint64_t size) {
+        (void)offset;
+        (void)size;
+    }
+
+    /**
+     * Underlying POSIX file descriptor, or -1 if there is none.
+     */
+    virtual int nativeHandle() const { return -1; }
+};
+
+/**
+ * FileSource - Positional reads from a file (pread, preadv for scatter reads).
+ */
+class FileSource : public InputSource {
+public:
+    FileSource();
+    ~FileSource() override;
+
+    FileSource(const FileSource&) = delete;
+    FileSource& operator=(const FileSource&) = delete;
+
+    /**
+     * Open a file for reading.
+     */
+    bool open(const std::string& path);
+
+    /**
+     * Wrap an existing descriptor.
+     *
+     * @param takeOwnership Close fd when the source is closed/destroyed
+     */
+    bool openFd(int fd, bool takeOwnership = true);
+
+    void close();
+    bool isOpen() const { return fd_ >= 0; }
+
+    bool readAt(uint64_t offset, void* dst, size_t size) override;
+    bool readAtv(uint64_t offset, const ReadSlice* slices, size_t count) override;
+    uint64_t size() const override { return size_; }
+    void adviseAccess(AccessHint hint) override;
+    void willNeed(uint64_t offset, uint64_t size) override;
+    int nativeHandle() const override { return fd_; }
+
+private:
+    int fd_;
+    bool ownsFd_;
+    uint64_t size_;
+    std::mutex mutex_;  // Serializes seek+read where pread is unavailable
+};
+
+/**
+ * MmapSource - Whole file mapped read-only; map() is always zero-copy.
+ * Not available on Windows (open() returns false).
+ */
+class MmapSource : public InputSource {
+public:
+    MmapSource();
+    ~MmapSource() override;
+
+    MmapSource(const MmapSource&) = delete;
+    MmapSource& operator=(const MmapSource&) = delete;
+
+    bool open(const std::string& path);
+
+    /**
+     * Map an existing descriptor. The descriptor is not needed after
+     * mapping and is closed when takeOwnership is set.
+     */
+    bool openFd(int fd, bool takeOwnership = true);
+
+    void close();
+    bool isOpen() const { return open_; }
+
+    bool readAt(uint64_t offset, void* dst, size_t size) override;
+    uint64_t size() const override { return size_; }
+    const uint8_t* map(uint64_t offset, size_t size) override;
+    void adviseAccess(AccessHint hint) override;
+    void willNeed(uint64_t offset, uint64_t size) override;
+    int nativeHandle() const override { return fd_; }
+
+private:
+    const uint8_t* data_;
+    uint64_t size_;
+    int fd_;
+    bool ownsFd_;
+    bool open_;
+};
+
+/**
+ * MemorySource - Reads from a buffer already in RAM.
+ */
+class MemorySource : public InputSource {
+public:
+    /**
+     * Borrow a buffer (must outlive the source).
+     */
+    MemorySource(const void* data, size_t size);
+
+    /**
+     * Take ownership of a buffer.
+     */
+    explicit MemorySource(std::vector<uint8_t> data);
+
+    bool readAt(uint64_t offset, void* dst, size_t size) override;
+    uint64_t size() const override { return size_; }
+    const uint8_t* map(uint64_t offset, size_t size) override;
+
+private:
+    std::vector<uint8_t> owned_;
+    const uint8_t* data_;
+    uint64_t size_;
+};
+
+/**
+ * CallbackSource - Forwards reads to a user function (object stores, ...).
+ * The callback must be safe to call concurrently if the reader is shared.
+ */
+class CallbackSource : public InputSource {
+public:
+    using ReadFn = std::function<bool(uint64_t offset, void* dst, size_t size)>;
+
+    /**
+     * @param read Called for every read; fills exactly `size` bytes or returns false
+     * @param size Total size of the source in bytes
+     */
+    CallbackSource(ReadFn read, uint64_t size);
+
+    bool readAt(uint64_t offset, void* dst, size_t size) override;
+    uint64_t size() const override { return size_; }
+
+private:
+    ReadFn read_;
+    uint64_t size_;
+};
+
+} // namespace vraw
+
+#endif // VRAW_INPUT_SOURCE_H
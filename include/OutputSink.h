@@ -0,0 +1,236 @@
+/**
+ * VRAW Library - Output Sinks
+ *
+ * Destinations for VrawWriter output: stdio file, raw file descriptor,
+ * memory, null and user callbacks.
+ * https://github.com/JohanAberg/vraw-lib
+ */
+
+#ifndef VRAW_OUTPUT_SINK_H
+#define VRAW_OUTPUT_SINK_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace vraw {
+
+/**
+ * OutputSink - Byte destination used by VrawWriter.
+ *
+ * The writer appends frames sequentially and patches a few header fields
+ * in place with writeAt(). It serializes append(), writeAt(), flush() and
+ * sync(), but with a DurabilityPolicy set, syncRange(), dataSync() and
+ * dropCache() run on a background thread while appends are in flight, so
+ * those three must be safe to call concurrently with the others.
+ */
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+
+    /**
+     * Append bytes at the current end of the output.
+     */
+    virtual bool append(const void* data, size_t size) = 0;
+
+    /**
+     * Overwrite bytes at an absolute offset (offset + size <= size()).
+     * Does not move the append position.
+     */
+    virtual bool writeAt(uint64_t offset, const void* data, size_t size) = 0;
+
+    /**
+     * Push buffered data to the underlying destination.
+     */
+    virtual bool flush() { return true; }
+
+    /**
+     * Make everything written so far durable (implies flush()).
+     */
+    virtual bool sync() { return flush(); }
+
+    /**
+     * Write back [offset, offset + size) to storage. With wait = false the
+     * writeback is only started; with wait = true the call returns once the
+     * range has reached the device. Does not flush user-space buffers and
+     * may be called from a different thread than append().
+     */
+    virtual bool syncRange(uint64_t offset, uint64_t size, bool wait) {
+        (void)offset;
+        (void)size;
+        (void)wait;
+        return true;
+    }
+
+    /**
+     * Make file data written so far durable (fdatasync). Same threading
+     * rules as syncRange().
+     */
+    virtual bool dataSync() { return true; }
+
+    /**
+     * Evict [offset, offset + size) from the page cache (size 0 = to the
+     * end). Only clean pages are dropped, so call after syncing the range.
+     * Same threading rules as syncRange().
+     */
+    virtual bool dropCache(uint64_t offset, uint64_t size) {
+        (void)offset;
+        (void)size;
+        return true;
+    }
+
+    /**
+     * Total bytes written (the append position).
+     */
+    virtual uint64_t size() const = 0;
+
+    /**
+     * Underlying POSIX file descriptor, or -1 if there is none.
+     */
+    virtual int nativeHandle() const { return -1; }
+};
+
+/**
+ * FileSink - Buffered stdio output (fopen / fdopen).
+ */
+class FileSink : public OutputSink {
+public:
+    FileSink();
+    ~FileSink() override;
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    /**
+     * Create/truncate a file for writing.
+     */
+    bool open(const std::string& path);
+
+    /**
+     * Wrap an existing descriptor (ownership transferred; closed with the sink).
+     */
+    bool openFd(int fd);
+
+    void close();
+    bool isOpen() const { return file_ != nullptr; }
+
+    bool append(const void* data, size_t size) override;
+    bool writeAt(uint64_t offset, const void* data, size_t size) override;
+    bool flush() override;
+    bool sync() override;
+    bool syncRange(uint64_t offset, uint64_t size, bool wait) override;
+    bool dataSync() override;
+    bool dropCache(uint64_t offset, uint64_t size) override;
+    uint64_t size() const override { return size_; }
+    int nativeHandle() const override;
+
+private:
+    FILE* file_;
+    uint64_t size_;
+};
+
+/**
+ * FdSink - Unbuffered output straight to a POSIX descriptor (write / pwrite).
+ */
+class FdSink : public OutputSink {
+public:
+    /**
+     * @param fd Descriptor opened for writing, positioned at the start
+     * @param takeOwnership Close fd when the sink is destroyed
+     */
+    explicit FdSink(int fd, bool takeOwnership = true);
+    ~FdSink() override;
+
+    FdSink(const FdSink&) = delete;
+    FdSink& operator=(const FdSink&) = delete;
+
+    bool append(const void* data, size_t size) override;
+    bool writeAt(uint64_t offset, const void* data, size_t size) override;
+    bool sync() override;
+    bool syncRange(uint64_t offset, uint64_t size, bool wait) override;
+    bool dataSync() override;
+    bool dropCache(uint64_t offset, uint64_t size) override;
+    uint64_t size() const override { return size_; }
+    int nativeHandle() const override { return fd_; }
+
+private:
+    int fd_;
+    bool ownsFd_;
+    uint64_t size_;
+};
+
+/**
+ * MemorySink - Collects output in a growable in-memory buffer.
+ */
+class MemorySink : public OutputSink {
+public:
+    MemorySink() = default;
+
+    bool append(const void* data, size_t size) override;
+    bool writeAt(uint64_t offset, const void* data, size_t size) override;
+    uint64_t size() const override { return data_.size(); }
+
+    const std::vector<uint8_t>& data() const { return data_; }
+    std::vector<uint8_t> release() { return std::move(data_); }
+
+private:
+    std::vector<uint8_t> data_;
+};
+
+/**
+ * NullSink - Discards output but tracks its size (for benchmarks).
+ */
+class NullSink : public OutputSink {
+public:
+    NullSink() : size_(0) {}
+
+    bool append(const void*, size_t size) override { size_ += size; return true; }
+    bool writeAt(uint64_t offset, const void*, size_t size) override {
+        return offset + size <= size_;
+    }
+    uint64_t size() const override { return size_; }
+
+private:
+    uint64_t size_;
+};
+
+/**
+ * CallbackSink - Forwards output to user functions (object stores, tees, ...).
+ *
+ * Appends are delivered as positional writes at the current end, so a
+ * single write callback handles both append() and writeAt().
+ */
+class CallbackSink : public OutputSink {
+public:
+    using WriteFn = std::function<bool(uint64_t offset, const void* data, size_t size)>;
+    using SyncFn = std::function<bool()>;
+
+    /**
+     * @param write Called for every write; returns false on failure
+     * @param sync Called by sync() and dataSync() (optional). With a
+     *             DurabilityPolicy set, dataSync() runs on the writer's
+     *             sync thread, so this may be called while write calls
+     *             are in flight on another thread
+     * @param flush Called by flush() (optional)
+     */
+    explicit CallbackSink(WriteFn write, SyncFn sync = nullptr, SyncFn flush = nullptr);
+
+    bool append(const void* data, size_t size) override;
+    bool writeAt(uint64_t offset, const void* data, size_t size) override;
+    bool flush() override;
+    bool sync() override;
+    bool dataSync() override;
+    uint64_t size() const override { return size_; }
+
+private:
+    WriteFn write_;
+    SyncFn sync_;
+    SyncFn flush_;
+    uint64_t size_;
+};
+
+} // namespace vraw
+
+#endif // VRAW_OUTPUT_SINK_H
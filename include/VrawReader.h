@@ -9,13 +9,18 @@
 #define VRAW_READER_H
 
 #include "VrawTypes.h"
+#include "InputSource.h"
 #include <string>
 #include <vector>
 #include <cstdio>
+#include <functional>
 #include <memory>
 
 namespace vraw {
 
+struct SimpleFrameHeader;
+namespace detail { class ThreadPool; struct DecodePipeline; }
+
 /**
  * VrawReader - Read RAW video frames from VRAW format files.
  *
@@ -39,6 +44,68 @@ public:
         bool valid = false;
     };
 
+    // Read statistics returned by getStats()
+    struct Stats {
+        uint64_t framesRead = 0;
+        uint64_t bytesRead = 0;          // Stored frame bytes fetched from the source
+        uint32_t sequentialReads = 0;    // Reads of the frame after the previous one
+        uint32_t randomReads = 0;        // Reads after a jump
+        AccessHint appliedHint = AccessHint::NORMAL;  // Hint currently applied to the source
+        uint32_t hintChanges = 0;
+        uint32_t willNeedRequests = 0;   // Read-ahead requests issued
+        uint32_t batchReads = 0;         // Merged reads issued by readFrames()
+        uint32_t ioUringReads = 0;       // ... of which went through io_uring
+        uint32_t decodedCacheHits = 0;   // Frames copied from the decoded tier
+        uint32_t storedCacheHits = 0;    // Frames decoded from the stored tier
+        uint32_t cacheMisses = 0;        // Frames fetched from the source with a cache enabled
+        uint64_t decodedCacheBytes = 0;  // Current size of each tier
+        uint64_t storedCacheBytes = 0;
+    };
+
+    // Byte budgets of the frame cache (0 disables a tier)
+    struct CacheConfig {
+        uint64_t decodedBytes = 0;  // Decoded frames in the output layout
+        uint64_t storedBytes = 0;   // Compressed/packed frames as stored, decoded on hit
+    };
+
+    // Options for readFrames()
+    struct BatchReadOptions {
+        uint32_t queueDepth = 32;                  // Merged reads in flight or awaiting decode
+        uint32_t maxMergeBytes = 8 * 1024 * 1024;  // Upper bound on one merged read
+        unsigned decodeThreads = 0;                // Decode workers (0 = hardware concurrency)
+        bool useIoUring = true;                    // false forces the pread fallback
+    };
+
+    /**
+     * Receives one decoded frame from readFrames().
+     *
+     * @param index Position of the frame in the request list
+     * @param frameNumber Frame index in the file
+     * @param pixels Decoded samples in the current output layout (getFrameSizeBytes()
+     *               bytes, valid only during the call), or nullptr if the frame failed
+     * @param header Frame header (zeroed if the frame failed)
+     */
+    using FrameCallback = std::function<void(size_t index, uint32_t frameNumber,
+                                             const uint16_t* pixels, const FrameHeader& header)>;
+
+    /**
+     * Receives one band of decoded rows from readFrameRows().
+     *
+     * In MOSAIC output, samples holds rowCount x width samples. In
+     * CFA_PLANES output it holds the matching rows of each plane:
+     * R, G1, G2, B blocks of (rowCount / 2) x (width / 2) samples.
+     * The buffer is reused for the next band.
+     *
+     * @return false to stop decoding
+     */
+    using RowCallback = std::function<bool(uint32_t firstRow, uint32_t rowCount, const uint16_t* samples)>;
+
+    /**
+     * Progress of loadIntoMemory(). Called from the load threads, one call
+     * at a time; return false to cancel the load.
+     */
+    using LoadProgress = std::function<bool(uint64_t bytesLoaded, uint64_t totalBytes)>;
+
     VrawReader();
     ~VrawReader();
 
@@ -63,6 +130,15 @@ public:
      */
     bool openWithFd(int fd, const std::string& displayPath);
 
+    /**
+     * Open from a custom input source (memory buffer, mmap, object store, ...).
+     *
+     * @param source Source to read from (ownership transferred to VrawReader)
+     * @param displayName Name for logging purposes only
+     * @return true on success
+     */
+    bool openWithSource(std::unique_ptr<InputSource> source, const std::string& displayName);
+
     /**
      * Close the file.
      */
@@ -71,7 +147,32 @@ public:
     /**
      * Check if file is open.
      */
-    bool isOpen() const { return file_ != nullptr; }
+    bool isOpen() const { return source_ != nullptr; }
+
+    /**
+     * Load the whole file into RAM, as stored (still compressed/packed), so
+     * later reads never touch the original source.
+     *
+     * The file is read with parallel large reads into a huge-page backed
+     * buffer where available, which then replaces the source.
+     *
+     * @param budgetBytes Largest file size allowed in memory
+     * @param progress Optional progress callback
+     * @return true if the clip is now served from memory; false if it
+     *         exceeds the budget, a read failed or the load was cancelled
+     *         (the reader then keeps using the original source)
+     */
+    bool loadIntoMemory(uint64_t budgetBytes, const LoadProgress& progress = nullptr);
+
+    /**
+     * Check whether loadIntoMemory() succeeded for the open file.
+     */
+    bool isLoadedIntoMemory() const { return loadedIntoMemory_; }
+
+    /**
+     * Get the input source (nullptr when closed). Owned by the reader.
+     */
+    InputSource* getSource() const { return source_.get(); }
 
     /**
      * Get file header information.
@@ -99,9 +200,113 @@ public:
      */
     Frame readFrame(uint32_t frameNumber);
 
+    /**
+     * Decode a frame directly into caller-provided memory as 16-bit samples
+     * in the current output layout.
+     * Avoids the per-call allocation of readFrame(); uncompressed and
+     * compressed unpacked frames land in dst without an intermediate copy.
+     *
+     * @param frameNumber Frame index (0-based)
+     * @param dst Destination buffer (at least getFrameSizeBytes() bytes)
+     * @param dstBytes Size of dst in bytes
+     * @param header Optional output frame header (may be nullptr)
+     * @return true on success
+     */
+    bool readFrameInto(uint32_t frameNumber, void* dst, size_t dstBytes,
+                       FrameHeader* header = nullptr);
+
+    /**
+     * Decode a frame in bands of rows, handing each band to onRows as soon
+     * as it is ready, in the current output layout.
+     *
+     * Peak memory is a few bands instead of several full frames:
+     * uncompressed frames are read band by band, chunked frames in mosaic
+     * storage order are decompressed a chunk at a time, and packed samples
+     * are unpacked per band. Frames compressed as one LZ4 block (or chunked
+     * frames stored as CFA planes) still decompress their (packed) payload
+     * in one piece before streaming.
+     *
+     * @param frameNumber Frame index (0-based)
+     * @param rowsPerBand Mosaic rows per band (rounded up to even; 0 = 16)
+     * @param onRows Receives each band, top to bottom
+     * @param header Optional output frame header (may be nullptr)
+     * @return true if every band was decoded and delivered
+     */
+    bool readFrameRows(uint32_t frameNumber, uint32_t rowsPerBand, const RowCallback& onRows,
+                       FrameHeader* header = nullptr);
+
+    /**
+     * Read and decode a batch of frames (timeline thumbnails, a playlist
+     * of cuts, ...).
+     *
+     * Requests are sorted by file offset and neighbouring frames are merged
+     * into larger reads. Reads are kept in flight with io_uring where the
+     * kernel allows it, otherwise with pread on the worker threads; each
+     * read is decoded as soon as it lands. onFrame is called exactly once
+     * per request, from the worker threads and in completion order, so it
+     * must be thread-safe.
+     *
+     * @param frames Frame indices to read (duplicates and any order allowed)
+     * @param onFrame Receives each decoded frame
+     * @return true if every frame decoded successfully
+     */
+    bool readFrames(const std::vector<uint32_t>& frames, const FrameCallback& onFrame);
+    bool readFrames(const std::vector<uint32_t>& frames, const FrameCallback& onFrame,
+                    const BatchReadOptions& options);
+
+    /**
+     * Size in bytes of one decoded frame in the current output layout.
+     */
+    size_t getFrameSizeBytes() const;
+
+    /**
+     * Select the layout of decoded frames (default: MOSAIC).
+     *
+     * CFA_PLANES returns four consecutive half-resolution planes in
+     * R, G1, G2, B order (G1 shares rows with R) according to
+     * FileHeader::bayerPattern. The deinterleave is fused into the
+     * unpack/copy step, so it costs no extra pass over the frame.
+     */
+    void setOutputLayout(FrameLayout layout) { outputLayout_ = layout; }
+    FrameLayout getOutputLayout() const { return outputLayout_; }
+
+    /**
+     * Configure the frame cache used by readFrame() and readFrameInto()
+     * (default: disabled).
+     *
+     * The decoded tier returns frames with a single copy. The stored tier
+     * keeps frames as they are on disk, usually 2-3x smaller when
+     * compressed or packed, so several times more footage stays resident;
+     * a hit skips the source read and only pays for the decode. Frames
+     * stored as plain 16-bit samples are only kept in the decoded tier.
+     */
+    void setCacheConfig(const CacheConfig& config);
+    const CacheConfig& getCacheConfig() const { return cacheConfig_; }
+
+    /**
+     * Drop every cached frame.
+     */
+    void clearCache();
+
+    /**
+     * Set the page-cache access hint (default: AUTO).
+     *
+     * AUTO switches the source to SEQUENTIAL after a run of consecutive
+     * frames and to RANDOM after repeated jumps. While sequential, the
+     * next few frames are requested ahead with WILLNEED.
+     */
+    void setAccessHint(AccessHint hint);
+    AccessHint getAccessHint() const { return accessHint_; }
+
+    /**
+     * Get read statistics since open().
+     */
+    const Stats& getStats() const { return stats_; }
+
     /**
      * Read only the frame header (no pixel data decompression).
      * Much faster than readFrame() for metadata access (timestamps, exposure, etc.).
+     * Safe to call from several threads at once.
      *
      * @param frameNumber Frame index (0-based)
      * @param header Output frame header
@@ -109,6 +314,56 @@ public:
      */
     bool readFrameHeader(uint32_t frameNumber, FrameHeader& header);
 
+    /**
+     * Check if the file carries per-frame statistics
+     * (VrawWriter::enableFrameStats).
+     */
+    bool hasFrameStats() const { return statsCount_ > 0; }
+
+    /**
+     * Read one frame's statistics from the trailer table. Frame payloads
+     * are not read.
+     *
+     * @return false if the file has no statistics for this frame
+     */
+    bool readFrameStats(uint32_t frameNumber, FrameStats& stats);
+
+    /**
+     * Read the statistics of every frame with a single read of the table.
+     */
+    bool readAllFrameStats(std::vector<FrameStats>& stats);
+
+    /**
+     * Check if the file carries an audio waveform overview (written by
+     * VrawWriter with the audio stream).
+     */
+    bool hasAudioPeaks() const { return !peakLevels_.empty(); }
+
+    /**
+     * Resolutions of the stored waveform overview, in samples per peak,
+     * finest first.
+     */
+    std::vector<uint32_t> getAudioPeakResolutions() const;
+
+    /**
+     * Read the audio waveform overview: the min/max of each channel over
+     * every block of samplesPerPeak samples, channel-interleaved (peak i
+     * of channel c at i * channels + c). The last peak may cover fewer
+     * samples. Served from the trailer table without reading PCM data;
+     * samplesPerPeak must be a multiple of a stored resolution, and
+     * coarser zoom levels are merged from the coarsest one that fits.
+     *
+     * @return false if the file has no overview at a compatible resolution
+     */
+    bool readAudioPeaks(uint32_t samplesPerPeak, std::vector<AudioPeak>& peaks);
+
+    /**
+     * Read only the audio stream header (no samples).
+     *
+     * @return false if the file has no audio
+     */
+    bool readAudioHeader(AudioHeader& header);
+
     /**
      * Read audio data if present.
      *
@@ -138,14 +393,62 @@ private:
     bool readIndexTable();
     bool buildSequentialIndex();
     bool validateIndex();
+    void noteFrameAccess(uint32_t frameNumber);
+    void applyAccessHint(AccessHint hint);
+    const uint8_t* fetchRange(uint64_t offset, uint32_t size, std::vector<uint8_t>& scratch);
+    void computeFrameSizes();
+    void readStatsTableHeader();
+    void readAudioPeakTableHeader();
+    bool fetchFrame(uint32_t frameNumber, SimpleFrameHeader& fh, const uint8_t*& payload,
+                    void* direct, size_t directBytes);
+    uint32_t storedSampleCount() const;
+
+    // Scratch buffers for one decode in flight
+    struct DecodeScratch {
+        std::vector<uint8_t> read;
+        std::vector<uint8_t> decompress;
+        std::vector<uint16_t> mosaic;
+    };
+    bool decodeFrame(const SimpleFrameHeader& fh, const uint8_t* stored, uint16_t* out,
+                     DecodeScratch& scratch) const;
+    bool readStoredPayload(const SimpleFrameHeader& fh, const uint8_t* stored,
+                           const uint8_t*& data, uint32_t& size, DecodeScratch& scratch) const;
+    bool decodeStoredSamples(const SimpleFrameHeader& fh, const uint8_t* stored,
+                             uint16_t* dst, uint32_t sampleCount, DecodeScratch& scratch) const;
 
-    FILE* file_;
+    std::unique_ptr<InputSource> source_;
     std::string filePath_;
     FileHeader fileHeader_;
     std::vector<uint64_t> frameIndex_;
+    std::vector<uint64_t> frameSizes_;  // Header + payload bytes (0 = unknown)
+    uint32_t statsCount_;               // Frames in the stats table (0 = none)
+    struct PeakLevel {
+        uint32_t samplesPerPeak;
+        uint32_t peakCount;
+        uint64_t offset;                // Absolute offset of the level's records
+    };
+    std::vector<PeakLevel> peakLevels_; // Audio peak table levels, finest first (empty = none)
+    uint16_t peakChannels_;
+    DecodeScratch scratch_;
+    std::unique_ptr<detail::ThreadPool> pool_;  // readFrames() workers, created on first use
+
+    // Frame cache tiers (defined in VrawReader.cpp)
+    struct FrameCaches;
+    CacheConfig cacheConfig_;
+    std::unique_ptr<FrameCaches> caches_;
+    FrameLayout outputLayout_;
     bool isPacked_;
-    bool usingFd_;
-    int fd_;
+    const detail::DecodePipeline* pipelines_;  // [unpacked, packed] for the file's bit depth
+    bool loadedIntoMemory_;
+
+    // Access pattern detection
+    AccessHint accessHint_;
+    uint32_t lastFrameRead_;
+    bool hasLastFrame_;
+    uint32_t sequentialRun_;
+    uint32_t randomRun_;
+    uint32_t willNeedUpTo_;
+    Stats stats_;
 };
 
 } // namespace vraw
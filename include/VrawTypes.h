@@ -27,7 +27,8 @@ enum class Encoding : uint8_t {
     LOG_8BIT = 2,        // Reserved for future use
     CINEON_10BIT = 3,    // Reserved for future use
     LOG2_12BIT = 4,      // LOG2 encoded 12-bit
-    LINEAR_12BIT = 5     // Raw 12-bit linear (default)
+    LINEAR_12BIT = 5,    // Raw 12-bit linear (default)
+    LINEAR_14BIT = 6     // Raw 14-bit linear
 };
 
 // Compression types
@@ -38,6 +39,18 @@ enum class Compression : uint8_t {
     LZ4_HIGH = 3
 };
 
+// MIPI CSI-2 packed input accepted by VrawWriter::submitFrameMipi()
+enum class MipiFormat : uint8_t {
+    RAW10 = 0,  // 4 pixels in 5 bytes: high 8 bits of each, then the low 2 bits
+    RAW12 = 1   // 2 pixels in 3 bytes: high 8 bits of each, then the low 4 bits
+};
+
+// Decoded frame layout returned by VrawReader
+enum class FrameLayout : uint8_t {
+    MOSAIC = 0,      // Interleaved Bayer mosaic, width x height samples
+    CFA_PLANES = 1   // R, G1, G2, B planes of (width / 2) x (height / 2) samples each
+};
+
 // Proxy video codec types
 enum class ProxyCodec : uint8_t {
     NONE = 0,       // No proxy
@@ -45,6 +58,21 @@ enum class ProxyCodec : uint8_t {
     HEVC = 2        // H.265/HEVC
 };
 
+// How VrawWriter pushes written data to storage
+enum class DurabilityMode : uint8_t {
+    NONE = 0,           // Leave writeback to the OS (flush() / stop() only)
+    PERIODIC = 1,       // Background writeback every N bytes or N milliseconds
+    PER_CHECKPOINT = 2  // Checkpoint the header and sync every N frames
+};
+
+// Expected read pattern, used for page-cache read-ahead hints
+enum class AccessHint : uint8_t {
+    AUTO = 0,        // Detect from the order frames are read in
+    NORMAL = 1,      // OS default read-ahead
+    SEQUENTIAL = 2,  // Playback / export: aggressive read-ahead
+    RANDOM = 3       // Scrubbing / sampling: no read-ahead
+};
+
 // Timecode structure
 struct Timecode {
     uint8_t hours;
@@ -88,6 +116,13 @@ struct FileHeader {
     uint32_t proxyHeight;       // Proxy video height
     uint32_t proxyBitrate;      // Proxy bitrate in bits/sec
     char proxyFilename[64];     // Relative sidecar filename (e.g., "video.proxy.mp4")
+    // Storage layout
+    FrameLayout storageLayout;  // Layout of samples on disk (see VrawWriter::setStorageLayout)
+    bool blackLevelSubtracted;  // Per-plane black level removed before packing
+    // Per-frame statistics
+    uint64_t statsOffset;       // Stats table in the trailer (0 = none, see VrawWriter::enableFrameStats)
+    // Audio waveform overview
+    uint64_t audioPeaksOffset;  // Peak table in the trailer (0 = none, see VrawReader::readAudioPeaks)
 };
 
 // Frame header information
@@ -116,6 +151,41 @@ struct AudioHeader {
     uint64_t startTimestampUs;
 };
 
+// Audio waveform overview entry: the sample range of one block of samples
+// of one channel (see VrawReader::readAudioPeaks)
+struct AudioPeak {
+    int16_t min;
+    int16_t max;
+};
+
+// Per-frame sample statistics (see VrawWriter::enableFrameStats). Computed
+// from the submitted samples, before log encoding and black level removal.
+struct FrameStats {
+    static const uint32_t HISTOGRAM_BINS = 32;
+
+    struct Channel {
+        uint16_t min = 0;
+        uint16_t max = 0;
+        float mean = 0.0f;
+        uint32_t clipped = 0;                     // Samples at or above the white level
+        uint32_t histogram[HISTOGRAM_BINS] = {};  // Equal-width bins over [0, white level]
+    };
+
+    // By position in the 2x2 CFA tile (top-left, top-right, bottom-left,
+    // bottom-right), in the order of FileHeader::blackLevel
+    Channel channels[4];
+};
+
+// Writer durability policy (see VrawWriter::setDurabilityPolicy)
+struct DurabilityPolicy {
+    DurabilityMode mode = DurabilityMode::NONE;
+    uint64_t syncBytes = 32 * 1024 * 1024;  // PERIODIC: write back after this many bytes (0 = off)
+    uint32_t syncIntervalMs = 1000;         // PERIODIC: ... or after this long (0 = off)
+    bool dataSync = true;                   // PERIODIC: fdatasync each range, not just write it back
+    uint32_t checkpointFrames = 30;         // PER_CHECKPOINT: frames between checkpoints
+    bool dropSyncedPages = false;           // Evict synced ranges from the page cache
+};
+
 } // namespace vraw
 
 #endif // VRAW_TYPES_H
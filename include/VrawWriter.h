@@ -9,13 +9,24 @@
 #define VRAW_WRITER_H
 
 #include "VrawTypes.h"
+#include "OutputSink.h"
 #include <string>
 #include <vector>
 #include <cstdio>
 #include <memory>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 
 namespace vraw {
 
+struct SimpleFrameHeader;
+namespace detail { struct EncodePipeline; class ThreadPool; }
+
 /**
  * VrawWriter - Write RAW video frames to VRAW format files.
  *
@@ -81,6 +92,157 @@ public:
                     uint32_t nativeWidth = 0,
                     uint32_t nativeHeight = 0);
 
+    /**
+     * Initialize the writer with a custom output sink (memory, object store, tee, ...).
+     *
+     * @param sink Empty sink to write to (ownership transferred to VrawWriter)
+     * @param displayName Name used for logging purposes
+     * Other parameters same as init() above
+     */
+    bool initWithSink(std::unique_ptr<OutputSink> sink,
+                      uint32_t width, uint32_t height, const std::string& displayName,
+                      Encoding encoding = Encoding::LINEAR_12BIT,
+                      bool usePacking = false,
+                      bool useCompression = true,
+                      BayerPattern bayerPattern = BayerPattern::RGGB,
+                      const uint16_t* blackLevel = nullptr,
+                      uint16_t whiteLevel = 4095,
+                      int32_t sensorOrientation = 0,
+                      uint32_t nativeWidth = 0,
+                      uint32_t nativeHeight = 0);
+
+    /**
+     * Store frames as R, G1, G2, B planes instead of the interleaved mosaic.
+     * Neighbouring samples in each plane share a colour channel, which
+     * helps LZ4 and keeps SIMD lanes uniform. Call after init() and
+     * before start(); requires even width and height.
+     *
+     * @param layout Storage layout (MOSAIC or CFA_PLANES)
+     * @param subtractBlackLevel Remove each plane's black level before packing
+     *        (linear encodings only, restored exactly by VrawReader)
+     * @return true on success
+     */
+    bool setStorageLayout(FrameLayout layout, bool subtractBlackLevel = false);
+
+    /**
+     * Encode frames in bands instead of whole-frame scratch buffers, so
+     * very large frames need only a bounded amount of writer memory.
+     *
+     * Each band is log-encoded, reordered, packed and, with compression,
+     * LZ4-compressed as the next block of one LZ4 stream and appended
+     * immediately; the frame's compressed size is patched afterwards.
+     * Compressed chunked frames need a reader that understands them (this
+     * library). Frames routed through the pre-roll ring still use the
+     * whole-frame path. Call after init() and before start().
+     *
+     * @param maxScratchBytes Cap on encoding scratch memory (0 = whole-frame encoding)
+     * @return true on success
+     */
+    bool setChunkedEncoding(size_t maxScratchBytes);
+
+    /**
+     * Set how many threads log-encode and pack each frame. Frames of at
+     * least PARALLEL_ENCODE_MIN_PIXELS are split into row bands that are
+     * encoded concurrently, with the submitting thread taking part; the
+     * output is identical to single-threaded encoding. Smaller frames are
+     * encoded on the submitting thread only.
+     * Call after init() and before start().
+     *
+     * @param threads Encoding threads (0 = hardware concurrency, 1 = submitting thread only)
+     * @return true on success
+     */
+    bool setEncodeThreads(unsigned threads);
+
+    static const uint32_t PARALLEL_ENCODE_MIN_PIXELS = 1024 * 1024;
+
+    /**
+     * Compute per-frame statistics while encoding: per CFA position
+     * min/max/mean, clipped sample count and a coarse histogram (see
+     * FrameStats). They are gathered in the same pass that log-encodes,
+     * splits into CFA planes or bit-packs each band; only frames stored as
+     * plain 16-bit mosaics (and chunked frames) take a separate pass.
+     * stop() stores them as a table in the trailer so
+     * VrawReader::readFrameStats() can return them without decoding.
+     * Call after init() and before start().
+     *
+     * @param enable Compute and store statistics
+     * @return true on success
+     */
+    bool enableFrameStats(bool enable = true);
+
+    /**
+     * Get the bytes currently held by encoding scratch buffers.
+     */
+    size_t getScratchBytes() const;
+
+    /**
+     * Enable pre-roll. Frames submitted before start() are encoded,
+     * compressed and kept in a bounded in-memory ring instead of being
+     * dropped. start() writes them ahead of the live frames, with their
+     * original timestamps, from a background thread so live capture is not
+     * stalled. The ring is LZ4-compressed even if the file is not.
+     * Live frames submitted while the flush runs queue behind it, within
+     * a maxBytes budget of their own (so at most twice maxBytes is held);
+     * beyond it submitFrame() drops the frame and returns false.
+     * A write error during that flush loses the frames still queued, so
+     * later submitFrame() calls and stop() return false; a corrupt ring
+     * frame only drops the rest of the pre-roll.
+     * Call after init().
+     *
+     * @param durationUs Longest span of footage to keep (0 = no limit)
+     * @param maxBytes Memory budget for buffered frames, and again for live
+     *                 frames queued behind the flush
+     * @return true on success
+     */
+    bool enablePreRoll(uint64_t durationUs, size_t maxBytes);
+
+    /**
+     * Disable pre-roll and discard buffered frames (not while recording).
+     */
+    void disablePreRoll();
+
+    /**
+     * Get the number of frames / bytes currently held in the pre-roll ring.
+     */
+    uint32_t getPreRollFrameCount() const;
+    size_t getPreRollBytes() const;
+
+    /**
+     * Set how written data is pushed to storage (default: NONE).
+     *
+     * PERIODIC flushes each new range once syncBytes or syncIntervalMs is
+     * reached and hands it to a background thread, which starts its
+     * writeback and waits for the previous range. Dirty page cache stays
+     * bounded to about two ranges, so write latency stays flat instead of
+     * stalling on a large kernel flush. Each range also patches the frame
+     * count into the header, so with dataSync an unfinished file opens with
+     * every synced frame.
+     *
+     * PER_CHECKPOINT patches the current frame count into the header and
+     * syncs every checkpointFrames frames, so a file cut short by a crash
+     * or power loss still opens with all checkpointed frames.
+     *
+     * With dropSyncedPages, ranges are evicted from the page cache once
+     * they are on disk, so a long take does not push out other caches.
+     *
+     * Call after init() and before start().
+     *
+     * @return true on success
+     */
+    bool setDurabilityPolicy(const DurabilityPolicy& policy);
+    const DurabilityPolicy& getDurabilityPolicy() const { return durability_; }
+
+    /**
+     * Get the number of completed background syncs.
+     */
+    uint32_t getSyncCount() const { return syncCount_.load(); }
+
+    /**
+     * Get the number of bytes evicted from the page cache
+     * (DurabilityPolicy::dropSyncedPages).
+     */
+    uint64_t getDroppedCacheBytes() const { return droppedCacheBytes_.load(); }
+
     /**
      * Start recording frames.
      */
@@ -104,6 +266,30 @@ public:
                      float whiteBalanceB = 1.0f,
                      const uint16_t* dynamicBlackLevel = nullptr);
 
+    /**
+     * Submit a frame of MIPI CSI-2 packed samples (Android RAW10/RAW12,
+     * V4L2 'pRAA'/'pRCC' and similar) without unpacking it first.
+     *
+     * When the writer packs linear samples of the same bit depth into the
+     * mosaic layout (LINEAR_10BIT for RAW10, LINEAR_12BIT for RAW12), each
+     * line is repacked straight into the stored bit layout in one pass.
+     * Any other configuration unpacks to 16-bit and takes the
+     * submitFrame() path. Width must be a multiple of 4 (RAW10) or 2 (RAW12).
+     *
+     * @param data First byte of the first line
+     * @param rowStride Bytes between lines (0 = tightly packed)
+     * @param format MIPI packing of data
+     * @return true on success
+     */
+    bool submitFrameMipi(const uint8_t* data,
+                         uint32_t rowStride,
+                         MipiFormat format,
+                         uint64_t timestampUs,
+                         float whiteBalanceR = 1.0f,
+                         float whiteBalanceG = 1.0f,
+                         float whiteBalanceB = 1.0f,
+                         const uint16_t* dynamicBlackLevel = nullptr);
+
     /**
      * Stop recording and finalize the file.
      */
@@ -129,6 +315,11 @@ public:
      */
     bool flush();
 
+    /**
+     * Get the output sink (nullptr before init). Owned by the writer.
+     */
+    OutputSink* getSink() const { return sink_.get(); }
+
     /**
      * Enable audio recording.
      *
@@ -140,6 +331,10 @@ public:
     /**
      * Submit audio samples.
      *
+     * A waveform overview (min/max per channel for every AUDIO_PEAK_BLOCK
+     * and AUDIO_PEAK_COARSE_BLOCK samples) is built as samples arrive and
+     * stored in the trailer by stop(); see VrawReader::readAudioPeaks().
+     *
      * @param samples PCM16 audio samples (interleaved for stereo)
      * @param sampleCount Number of samples PER CHANNEL
      * @param timestampUs Timestamp of first sample
@@ -151,6 +346,10 @@ public:
      */
     uint64_t getAudioSampleCount() const;
 
+    // Samples per channel summarised by each audio peak, fine and coarse level
+    static const uint32_t AUDIO_PEAK_BLOCK = 256;
+    static const uint32_t AUDIO_PEAK_COARSE_BLOCK = 4096;
+
 private:
     bool initCommon(uint32_t width, uint32_t height, const std::string& pathOrDisplay,
                     Encoding encoding, bool usePacking, bool useCompression,
@@ -158,16 +357,47 @@ private:
                     uint16_t whiteLevel, int32_t sensorOrientation,
                     uint32_t nativeWidth, uint32_t nativeHeight);
     bool writeFileHeader(BayerPattern bayerPattern);
+    void encodeFrame(const uint16_t* data, uint64_t timestampUs,
+                     float whiteBalanceR, float whiteBalanceG, float whiteBalanceB,
+                     const uint16_t* dynamicBlackLevel, SimpleFrameHeader& fh,
+                     const uint8_t*& payload, uint32_t& payloadSize);
+    bool writeEncodedFrame(SimpleFrameHeader& fh, const uint8_t* payload, uint32_t payloadBytes,
+                           const FrameStats* stats);
+    bool submitEncodedFrame(SimpleFrameHeader& fh, const uint8_t* payload, uint32_t payloadBytes,
+                            const FrameStats* stats, bool buffering);
+    // Statistics of a mosaic frame; with consume, each group of four rows
+    // is handed on right after it is counted, while it is still in cache
+    void collectFrameStats(const uint16_t* data,
+                           const std::function<void(uint32_t first, uint32_t count)>& consume = nullptr);
+    bool writeStatsTable();
+    void appendAudioPeak();
+    bool writeAudioPeakTable();
+    void compressPayload(SimpleFrameHeader& fh, const uint8_t*& payload, uint32_t& payloadBytes);
+    void fillFrameHeader(SimpleFrameHeader& fh, uint64_t timestampUs,
+                         float whiteBalanceR, float whiteBalanceG, float whiteBalanceB,
+                         const uint16_t* frameBlackLevel);
+    bool writeChunkedFrame(const uint16_t* data, uint64_t timestampUs,
+                           float whiteBalanceR, float whiteBalanceG, float whiteBalanceB,
+                           const uint16_t* dynamicBlackLevel);
+    void produceStoredSamples(const uint16_t* data, uint32_t first, uint32_t count,
+                              const uint16_t* frameBlackLevel, uint16_t* out);
+    enum class PreRollPush { BUFFER, IF_FLUSHING };
+    enum class PreRollQueued { YES, NO, REJECTED };
+    PreRollQueued pushPreRollFrame(const SimpleFrameHeader& fh, const uint8_t* payload,
+                                   uint32_t payloadBytes, const FrameStats* stats, PreRollPush mode);
+    void flushPreRoll();
+    void scheduleSync();
+    void syncLoop();
+    void stopSyncThread();
     bool ensurePackedCapacity(uint32_t packedBytes);
     bool ensureEncodedCapacity(uint32_t pixelCount);
     bool ensureCompressedCapacity(uint32_t uncompressedSize);
-    uint32_t packFrame10Bit(const uint16_t* src, uint32_t pixelCount);
-    uint32_t packFrame12Bit(const uint16_t* src, uint32_t pixelCount);
+    bool ensurePlanesCapacity(uint32_t pixelCount);
+    uint32_t packSamples(const uint16_t* src, uint32_t count);
+    void forEachBand(uint32_t count, const std::function<void(uint32_t first, uint32_t count)>& fn);
 
-    FILE* outputFile_;
+    std::unique_ptr<OutputSink> sink_;
     bool isRecording_;
-    bool usingFd_;
-    int outputFd_;
     uint32_t width_;
     uint32_t height_;
     uint32_t nativeWidth_;
@@ -177,14 +407,30 @@ private:
     Compression compression_;
     bool writePacked_;
     bool useCompression_;
+    const detail::EncodePipeline* pipeline_;  // Resolved at init() from encoding/packing/compression
     uint32_t binningNum_;
     uint32_t binningDen_;
-    uint32_t frameNumber_;
-    uint64_t bytesWritten_;
+    // Advanced by the pre-roll flush thread while getters may read them
+    std::atomic<uint32_t> frameNumber_;
+    std::atomic<uint64_t> bytesWritten_;
     std::vector<uint64_t> frameOffsets_;
     std::vector<uint8_t> packedBuffer_;
     std::vector<uint16_t> encodedBuffer_;
+    std::vector<uint16_t> logTable_;    // Log code per 16-bit input (log encodings)
     std::vector<uint8_t> compressedBuffer_;
+    std::vector<uint16_t> planesBuffer_;
+    std::vector<uint16_t> mipiBuffer_;  // Unpacked MIPI input when it cannot be repacked directly
+    BayerPattern bayerPattern_;
+    FrameLayout storageLayout_;
+    bool subtractBlackLevel_;
+    uint32_t chunkSamples_;             // Samples per band in chunked encoding (0 = off)
+    std::vector<uint16_t> chunkBuffer_; // One band of stored samples
+    std::vector<uint8_t> chunkDict_;    // LZ4 history between bands
+    unsigned encodeThreads_;            // 0 = hardware concurrency
+    std::unique_ptr<detail::ThreadPool> encodePool_;  // Created on the first large frame
+    bool frameStatsEnabled_;
+    FrameStats currentStats_;           // Statistics of the frame being encoded
+    std::vector<FrameStats> frameStats_;  // Per written frame, for the trailer
 
     uint16_t blackLevel_[4];
     uint16_t whiteLevel_;
@@ -196,6 +442,50 @@ private:
     uint16_t audioChannels_;
     uint64_t audioStartTime_;
     std::vector<int16_t> audioBuffer_;
+    std::vector<AudioPeak> audioPeaks_[2];     // Fine and coarse level, channel-interleaved
+    std::vector<AudioPeak> audioPeakCurrent_;  // Fine peak being accumulated, per channel
+    uint32_t audioPeakFill_;                   // Samples per channel in audioPeakCurrent_
+
+    // Pre-roll ring of encoded frames; doubles as the write queue while
+    // it is being flushed after start()
+    struct PreRollFrame {
+        std::vector<uint8_t> data;   // 64-byte frame header + stored payload
+        uint32_t payloadBytes = 0;   // Payload size as written to the file
+        bool ringCompressed = false; // Payload LZ4-compressed for the ring only
+        bool hasStats = false;
+        bool live = false;           // Queued behind the flush; already acknowledged
+        FrameStats stats;
+    };
+    bool preRollEnabled_;
+    uint64_t preRollDurationUs_;
+    size_t preRollMaxBytes_;
+    size_t preRollBytes_;
+    size_t preRollLiveBytes_;    // Share of preRollBytes_ held by queued live frames
+    std::deque<PreRollFrame> preRollFrames_;
+    std::vector<std::vector<uint8_t>> preRollPool_;
+    mutable std::mutex preRollMutex_;
+    std::thread preRollThread_;
+    bool flushingPreRoll_;
+    bool preRollFailed_;
+    bool preRollWriteFailed_;    // Flush hit a write error; later frames are refused
+    uint32_t liveFramesLost_;    // Acknowledged live frames the flush could not write
+
+    // Durability: ranges queued for background writeback
+    struct SyncRequest {
+        uint64_t offset;
+        uint64_t size;
+        bool durable;
+    };
+    DurabilityPolicy durability_;
+    uint64_t syncedUpTo_;
+    std::chrono::steady_clock::time_point lastSyncTime_;
+    std::deque<SyncRequest> syncQueue_;
+    std::mutex syncMutex_;
+    std::condition_variable syncCv_;
+    std::thread syncThread_;
+    bool stopSync_;
+    std::atomic<uint32_t> syncCount_;
+    std::atomic<uint64_t> droppedCacheBytes_;
 };
 
 } // namespace vraw
@@ -39,9 +39,14 @@
 #define VRAW_H
 
 #include "VrawTypes.h"
+#include "OutputSink.h"
 #include "VrawWriter.h"
+#include "InputSource.h"
 #include "VrawReader.h"
 #include "Encoding.h"
+#include "BatchLoader.h"
+#include "ClipScanner.h"
+#include "DngWriter.h"
 
 // Library version
 #define VRAW_VERSION_MAJOR 2
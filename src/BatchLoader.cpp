@@ -0,0 +1,444 @@
+/**
+ * VRAW Library - Batched Frame Loader Implementation
+ */
+
+#include "BatchLoader.h"
+#include "VrawReader.h"
+#include "ThreadPool.h"
+#include "CfaPlanes.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOG_TAG "BatchLoader"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#define LOGI(...) do { fprintf(stderr, "[VRAW INFO] "); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); } while(0)
+#define LOGE(...) do { fprintf(stderr, "[VRAW ERROR] "); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); } while(0)
+#endif
+
+namespace vraw {
+
+static const size_t BATCH_ALIGNMENT = 4096;
+static const size_t MAX_READERS_PER_CONTEXT = 4;
+
+static uint8_t* allocateAligned(size_t bytes) {
+#ifdef _WIN32
+    return static_cast<uint8_t*>(_aligned_malloc(bytes, BATCH_ALIGNMENT));
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, BATCH_ALIGNMENT, bytes) != 0) {
+        return nullptr;
+    }
+    return static_cast<uint8_t*>(ptr);
+#endif
+}
+
+static void freeAligned(uint8_t* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+BatchLoader::BatchLoader()
+    : width_(0),
+      height_(0),
+      sampleBytes_(0),
+      batchBytes_(0),
+      epoch_(0),
+      initialized_(false),
+      nextConsume_(0),
+      currentSlot_(-1),
+      stopProducer_(false) {
+}
+
+BatchLoader::~BatchLoader() {
+    close();
+}
+
+bool BatchLoader::init(const std::vector<BatchSample>& samples, const Options& options) {
+    if (initialized_) {
+        LOGE("BatchLoader already initialized");
+        return false;
+    }
+    if (samples.empty() || options.batchSize == 0) {
+        LOGE("Invalid parameters: samples=%zu batchSize=%u", samples.size(), options.batchSize);
+        return false;
+    }
+
+    // Probe dimensions from the first sample
+    VrawReader probe;
+    if (!probe.open(samples[0].path)) {
+        LOGE("Failed to open first sample: %s", samples[0].path.c_str());
+        return false;
+    }
+    width_ = probe.getWidth();
+    height_ = probe.getHeight();
+    probe.close();
+
+    samples_ = samples;
+    options_ = options;
+    if (options_.prefetchBatches == 0) {
+        options_.prefetchBatches = 1;
+    }
+
+    const size_t elementSize = (options_.dtype == TensorType::FLOAT32) ? 4 : 2;
+    if (options_.layout == TensorLayout::CFA_PLANES) {
+        sampleBytes_ = static_cast<size_t>(width_ / 2) * (height_ / 2) * 4 * elementSize;
+    } else {
+        sampleBytes_ = static_cast<size_t>(width_) * height_ * elementSize;
+    }
+    batchBytes_ = sampleBytes_ * options_.batchSize;
+
+    if (!allocateSlots()) {
+        LOGE("Failed to allocate %u batch buffers of %zu bytes",
+             options_.prefetchBatches + 1, batchBytes_);
+        releaseSlots();
+        return false;
+    }
+
+    pool_.reset(new detail::ThreadPool(options_.workerThreads));
+    for (unsigned i = 0; i <= pool_->size(); ++i) {
+        contexts_.emplace_back(new DecodeContext());
+        freeContexts_.push_back(contexts_.back().get());
+    }
+
+    epoch_ = 0;
+    initialized_ = true;
+    shuffleOrder();
+    startProducer();
+
+    LOGI("BatchLoader: %zu samples, %u per batch, %ux%u, %u workers%s",
+         samples_.size(), options_.batchSize, width_, height_, pool_->size(),
+         isPinned() ? ", pinned" : "");
+    return true;
+}
+
+bool BatchLoader::next(Batch& batch) {
+    if (!initialized_) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // Hand the previously returned buffer back to the producer
+    if (currentSlot_ >= 0) {
+        slots_[currentSlot_].state = SlotState::FREE;
+        currentSlot_ = -1;
+        cv_.notify_all();
+    }
+
+    if (nextConsume_ >= getBatchCount()) {
+        return false;
+    }
+
+    Slot& slot = slots_[nextConsume_ % slots_.size()];
+    cv_.wait(lock, [&] {
+        return slot.state == SlotState::READY && slot.sequence == nextConsume_;
+    });
+
+    slot.state = SlotState::IN_USE;
+    currentSlot_ = static_cast<int>(nextConsume_ % slots_.size());
+    ++nextConsume_;
+    batch = slot.batch;
+    return true;
+}
+
+void BatchLoader::reset() {
+    if (!initialized_) {
+        return;
+    }
+    stopProducer();
+    ++epoch_;
+    shuffleOrder();
+    startProducer();
+}
+
+void BatchLoader::close() {
+    if (!initialized_) {
+        return;
+    }
+    stopProducer();
+    pool_.reset();
+    freeContexts_.clear();
+    contexts_.clear();
+    releaseSlots();
+    samples_.clear();
+    order_.clear();
+    initialized_ = false;
+}
+
+uint32_t BatchLoader::getBatchCount() const {
+    const uint32_t total = static_cast<uint32_t>(samples_.size());
+    if (options_.batchSize == 0) {
+        return 0;
+    }
+    return options_.dropLast ? total / options_.batchSize
+                             : (total + options_.batchSize - 1) / options_.batchSize;
+}
+
+size_t BatchLoader::getBatchBytes() const {
+    return batchBytes_;
+}
+
+bool BatchLoader::isPinned() const {
+    if (slots_.empty()) {
+        return false;
+    }
+    for (const auto& slot : slots_) {
+        if (!slot.locked) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BatchLoader::allocateSlots() {
+    // One slot per prefetched batch plus the one held by the consumer
+    slots_.resize(options_.prefetchBatches + 1);
+    for (auto& slot : slots_) {
+        slot.data = allocateAligned(batchBytes_);
+        if (!slot.data) {
+            return false;
+        }
+#ifndef _WIN32
+        if (options_.pinMemory) {
+            slot.locked = mlock(slot.data, batchBytes_) == 0;
+        }
+#endif
+    }
+    return true;
+}
+
+void BatchLoader::releaseSlots() {
+    for (auto& slot : slots_) {
+        if (slot.data) {
+#ifndef _WIN32
+            if (slot.locked) {
+                munlock(slot.data, batchBytes_);
+            }
+#endif
+            freeAligned(slot.data);
+        }
+    }
+    slots_.clear();
+}
+
+void BatchLoader::shuffleOrder() {
+    order_.resize(samples_.size());
+    for (uint32_t i = 0; i < order_.size(); ++i) {
+        order_[i] = i;
+    }
+    if (options_.shuffle) {
+        std::mt19937_64 rng(options_.seed * 0x9E3779B97F4A7C15ULL + epoch_);
+        std::shuffle(order_.begin(), order_.end(), rng);
+    }
+}
+
+void BatchLoader::startProducer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& slot : slots_) {
+            slot.state = SlotState::FREE;
+        }
+        nextConsume_ = 0;
+        currentSlot_ = -1;
+        stopProducer_ = false;
+    }
+    producer_ = std::thread(&BatchLoader::producerLoop, this);
+}
+
+void BatchLoader::stopProducer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopProducer_ = true;
+    }
+    cv_.notify_all();
+    if (producer_.joinable()) {
+        producer_.join();
+    }
+}
+
+void BatchLoader::producerLoop() {
+    const uint32_t batchCount = getBatchCount();
+
+    for (uint32_t b = 0; b < batchCount; ++b) {
+        Slot& slot = slots_[b % slots_.size()];
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return stopProducer_ || slot.state == SlotState::FREE; });
+            if (stopProducer_) {
+                return;
+            }
+        }
+
+        fillSlot(slot, b);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot.sequence = b;
+            slot.state = SlotState::READY;
+        }
+        cv_.notify_all();
+    }
+}
+
+void BatchLoader::fillSlot(Slot& slot, uint32_t batchNumber) {
+    const uint32_t first = batchNumber * options_.batchSize;
+    const uint32_t count = std::min<uint32_t>(options_.batchSize,
+                                              static_cast<uint32_t>(order_.size()) - first);
+
+    Batch& batch = slot.batch;
+    batch.data = slot.data;
+    batch.bytes = sampleBytes_ * count;
+    batch.count = count;
+    batch.layout = options_.layout;
+    batch.dtype = options_.dtype;
+    if (options_.layout == TensorLayout::CFA_PLANES) {
+        batch.channels = 4;
+        batch.height = height_ / 2;
+        batch.width = width_ / 2;
+    } else {
+        batch.channels = 1;
+        batch.height = height_;
+        batch.width = width_;
+    }
+    batch.sampleIndices.assign(order_.begin() + first, order_.begin() + first + count);
+    batch.headers.assign(count, FrameHeader());
+
+    std::vector<uint8_t> ok(count, 0);
+    pool_->parallelFor(count, [&](uint32_t i) {
+        uint8_t* dst = slot.data + sampleBytes_ * i;
+        ok[i] = decodeSample(batch.sampleIndices[i], dst, batch.headers[i]) ? 1 : 0;
+        if (!ok[i]) {
+            memset(dst, 0, sampleBytes_);
+        }
+    });
+
+    batch.failedCount = static_cast<uint32_t>(std::count(ok.begin(), ok.end(), 0));
+}
+
+bool BatchLoader::decodeSample(uint32_t sampleIndex, uint8_t* dst, FrameHeader& header) {
+    const BatchSample& sample = samples_[sampleIndex];
+
+    DecodeContext* ctx = acquireContext();
+    VrawReader* reader = acquireReader(*ctx, sample.path);
+    if (!reader || reader->getWidth() != width_ || reader->getHeight() != height_) {
+        releaseContext(ctx);
+        return false;
+    }
+
+    // Stored code values decode straight into the batch in either layout
+    if (options_.dtype == TensorType::UINT16) {
+        bool ok = reader->readFrameInto(sample.frameNumber, dst, sampleBytes_, &header);
+        releaseContext(ctx);
+        return ok;
+    }
+
+    ctx->scratch.resize(reader->getFrameSizeBytes() / 2);
+    if (!reader->readFrameInto(sample.frameNumber, ctx->scratch.data(),
+                               ctx->scratch.size() * 2, &header)) {
+        releaseContext(ctx);
+        return false;
+    }
+
+    const FileHeader& fh = reader->getFileHeader();
+    const uint16_t* src = ctx->scratch.data();
+
+    // Per tile-position scale/offset
+    float offset[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float scale[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    if (options_.normalize) {
+        const bool isLog = (fh.encoding == Encoding::LOG2_10BIT || fh.encoding == Encoding::LOG2_12BIT);
+        const bool is12Bit = (fh.encoding == Encoding::LOG2_12BIT || fh.encoding == Encoding::LINEAR_12BIT);
+        for (int i = 0; i < 4; ++i) {
+            if (isLog) {
+                // LOG code values already have black removed; scale by code range
+                scale[i] = 1.0f / (is12Bit ? 4095.0f : 1023.0f);
+            } else {
+                const float range = static_cast<float>(fh.whiteLevel) - fh.blackLevel[i];
+                offset[i] = fh.blackLevel[i];
+                scale[i] = range > 0.0f ? 1.0f / range : 1.0f;
+            }
+        }
+    }
+
+    float* out = reinterpret_cast<float*>(dst);
+    if (options_.layout == TensorLayout::MOSAIC) {
+        for (uint32_t y = 0; y < height_; ++y) {
+            const uint16_t* row = src + static_cast<size_t>(y) * width_;
+            float* outRow = out + static_cast<size_t>(y) * width_;
+            const int rowPos = (y & 1) * 2;
+            for (uint32_t x = 0; x < width_; ++x) {
+                const int pos = rowPos + (x & 1);
+                outRow[x] = (row[x] - offset[pos]) * scale[pos];
+            }
+        }
+    } else {
+        // Reader already returned R, G1, G2, B planes
+        const size_t planeSize = static_cast<size_t>(width_ / 2) * (height_ / 2);
+        for (int plane = 0; plane < 4; ++plane) {
+            const int pos = detail::cfaPlanePosition(fh.bayerPattern, plane);
+            const uint16_t* in = src + plane * planeSize;
+            float* outPlane = out + plane * planeSize;
+            for (size_t i = 0; i < planeSize; ++i) {
+                outPlane[i] = (in[i] - offset[pos]) * scale[pos];
+            }
+        }
+    }
+
+    releaseContext(ctx);
+    return true;
+}
+
+VrawReader* BatchLoader::acquireReader(DecodeContext& ctx, const std::string& path) {
+    for (size_t i = 0; i < ctx.readers.size(); ++i) {
+        if (ctx.readers[i].first == path) {
+            // Move to front (most recently used)
+            if (i > 0) {
+                std::rotate(ctx.readers.begin(), ctx.readers.begin() + i,
+                            ctx.readers.begin() + i + 1);
+            }
+            return ctx.readers.front().second.get();
+        }
+    }
+
+    std::unique_ptr<VrawReader> reader(new VrawReader());
+    if (!reader->open(path)) {
+        return nullptr;
+    }
+    reader->setOutputLayout(options_.layout == TensorLayout::CFA_PLANES ?
+                            FrameLayout::CFA_PLANES : FrameLayout::MOSAIC);
+    if (ctx.readers.size() >= MAX_READERS_PER_CONTEXT) {
+        ctx.readers.pop_back();
+    }
+    ctx.readers.emplace(ctx.readers.begin(), path, std::move(reader));
+    return ctx.readers.front().second.get();
+}
+
+BatchLoader::DecodeContext* BatchLoader::acquireContext() {
+    std::lock_guard<std::mutex> lock(contextMutex_);
+    // One context exists per worker plus the calling thread, so the list is never empty
+    DecodeContext* ctx = freeContexts_.back();
+    freeContexts_.pop_back();
+    return ctx;
+}
+
+void BatchLoader::releaseContext(DecodeContext* ctx) {
+    std::lock_guard<std::mutex> lock(contextMutex_);
+    freeContexts_.push_back(ctx);
+}
+
+} // namespace vraw
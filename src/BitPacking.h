@@ -0,0 +1,300 @@
+/**
+ * VRAW Library - Bit packing engine
+ *
+ * Packs 16-bit samples of any width from 8 to 16 bits into a dense byte
+ * stream and back, LSB-first or MSB-first. Widths whose byte-aligned group
+ * fits a 64-bit word (8, 10, 12, 14, 16) are packed a whole group at a
+ * time; other widths use a bit accumulator. Not part of the public API.
+ */
+
+#ifndef VRAW_BIT_PACKING_H
+#define VRAW_BIT_PACKING_H
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define VRAW_MIPI_NEON 1
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define VRAW_MIPI_SSSE3 1
+#endif
+
+namespace vraw {
+namespace detail {
+
+enum class BitOrder {
+    LSB_FIRST,  // First sample in the low bits of the first byte (10-bit VRAW)
+    MSB_FIRST   // First sample in the high bits of the first byte (12-bit VRAW)
+};
+
+constexpr uint32_t gcdBits(uint32_t a, uint32_t b) {
+    return b == 0 ? a : gcdBits(b, a % b);
+}
+
+template <int Bits, BitOrder Order>
+struct BitPacker {
+    static_assert(Bits >= 8 && Bits <= 16, "sample width must be 8-16 bits");
+
+    static constexpr uint16_t MASK = static_cast<uint16_t>((1u << Bits) - 1);
+    // Smallest run of samples that ends on a byte boundary
+    static constexpr uint32_t GROUP_SAMPLES = 8 / gcdBits(Bits, 8);
+    static constexpr uint32_t GROUP_BYTES = GROUP_SAMPLES * Bits / 8;
+    // Whole groups are packed through one 64-bit word
+    static constexpr bool WORD_GROUPS = (GROUP_BYTES <= 8);
+
+    static constexpr uint32_t packedBytes(uint32_t count) {
+        return static_cast<uint32_t>((static_cast<uint64_t>(count) * Bits + 7) / 8);
+    }
+
+    /**
+     * Pack count samples (masked to Bits) into packedBytes(count) bytes.
+     * The last byte is zero-padded.
+     */
+    static void pack(const uint16_t* src, uint32_t count, uint8_t* dst) {
+        uint32_t done = 0;
+        if constexpr (WORD_GROUPS) {
+            const uint32_t groups = count / GROUP_SAMPLES;
+            for (uint32_t g = 0; g < groups; ++g) {
+                packGroup(src, dst);
+                src += GROUP_SAMPLES;
+                dst += GROUP_BYTES;
+            }
+            done = groups * GROUP_SAMPLES;
+        }
+
+        uint32_t acc = 0;
+        int bits = 0;
+        for (uint32_t i = done; i < count; ++i) {
+            const uint32_t sample = *src++ & MASK;
+            if (Order == BitOrder::LSB_FIRST) {
+                acc |= sample << bits;
+                bits += Bits;
+                while (bits >= 8) {
+                    *dst++ = static_cast<uint8_t>(acc);
+                    acc >>= 8;
+                    bits -= 8;
+                }
+            } else {
+                acc = (acc << Bits) | sample;
+                bits += Bits;
+                while (bits >= 8) {
+                    bits -= 8;
+                    *dst++ = static_cast<uint8_t>(acc >> bits);
+                }
+                acc &= (1u << bits) - 1;
+            }
+        }
+        if (bits > 0) {
+            *dst = static_cast<uint8_t>(Order == BitOrder::LSB_FIRST ? acc : acc << (8 - bits));
+        }
+    }
+
+    /**
+     * Unpack count samples. Stops early, leaving dst short, if srcBytes
+     * runs out.
+     */
+    static void unpack(const uint8_t* src, uint32_t srcBytes, uint16_t* dst, uint32_t count) {
+        if constexpr (WORD_GROUPS) {
+            const uint32_t groups = std::min(count / GROUP_SAMPLES, srcBytes / GROUP_BYTES);
+            for (uint32_t g = 0; g < groups; ++g) {
+                unpackGroup(src, dst);
+                src += GROUP_BYTES;
+                dst += GROUP_SAMPLES;
+            }
+            count -= groups * GROUP_SAMPLES;
+            srcBytes -= groups * GROUP_BYTES;
+        }
+
+        uint32_t acc = 0;
+        int bits = 0;
+        uint32_t srcIdx = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            while (bits < Bits && srcIdx < srcBytes) {
+                if (Order == BitOrder::LSB_FIRST) {
+                    acc |= static_cast<uint32_t>(src[srcIdx++]) << bits;
+                } else {
+                    acc = (acc << 8) | src[srcIdx++];
+                }
+                bits += 8;
+            }
+            if (bits < Bits) {
+                return;
+            }
+            bits -= Bits;
+            if (Order == BitOrder::LSB_FIRST) {
+                dst[i] = static_cast<uint16_t>(acc & MASK);
+                acc >>= Bits;
+            } else {
+                dst[i] = static_cast<uint16_t>((acc >> bits) & MASK);
+                acc &= (1u << bits) - 1;
+            }
+        }
+    }
+
+    /**
+     * Unpack pairs * 2 samples into separate even and odd column outputs.
+     */
+    static void unpackToPairs(const uint8_t* src, uint16_t* even, uint16_t* odd, uint32_t pairs) {
+        // Batches of 16 samples always end on a byte boundary
+        uint16_t batch[16];
+        while (pairs > 0) {
+            const uint32_t n = std::min<uint32_t>(pairs, 8);
+            unpack(src, packedBytes(n * 2), batch, n * 2);
+            for (uint32_t i = 0; i < n; ++i) {
+                even[i] = batch[2 * i];
+                odd[i] = batch[2 * i + 1];
+            }
+            src += packedBytes(n * 2);
+            even += n;
+            odd += n;
+            pairs -= n;
+        }
+    }
+
+private:
+    static void packGroup(const uint16_t* src, uint8_t* dst) {
+        uint64_t word = 0;
+        for (uint32_t k = 0; k < GROUP_SAMPLES; ++k) {
+            const uint64_t sample = src[k] & MASK;
+            if (Order == BitOrder::LSB_FIRST) {
+                word |= sample << (k * Bits);
+            } else {
+                word = (word << Bits) | sample;
+            }
+        }
+        for (uint32_t j = 0; j < GROUP_BYTES; ++j) {
+            const uint32_t shift = (Order == BitOrder::LSB_FIRST) ? 8 * j : 8 * (GROUP_BYTES - 1 - j);
+            dst[j] = static_cast<uint8_t>(word >> shift);
+        }
+    }
+
+    static void unpackGroup(const uint8_t* src, uint16_t* dst) {
+        uint64_t word = 0;
+        for (uint32_t j = 0; j < GROUP_BYTES; ++j) {
+            if (Order == BitOrder::LSB_FIRST) {
+                word |= static_cast<uint64_t>(src[j]) << (8 * j);
+            } else {
+                word = (word << 8) | src[j];
+            }
+        }
+        for (uint32_t k = 0; k < GROUP_SAMPLES; ++k) {
+            const uint32_t shift = (Order == BitOrder::LSB_FIRST) ? k * Bits
+                                                                  : (GROUP_SAMPLES - 1 - k) * Bits;
+            dst[k] = static_cast<uint16_t>((word >> shift) & MASK);
+        }
+    }
+};
+
+// MIPI CSI-2 RAW10 / RAW12 lines. Both store the high 8 bits of each pixel
+// in its own byte, followed by one byte of low bits per group.
+
+/**
+ * Unpack MIPI RAW10 groups (4 pixels in 5 bytes) to 16-bit samples.
+ */
+inline void unpackMipiRaw10(const uint8_t* src, uint16_t* dst, uint32_t groups) {
+    for (uint32_t g = 0; g < groups; ++g) {
+        const uint8_t low = src[4];
+        dst[0] = static_cast<uint16_t>((src[0] << 2) | (low & 0x3));
+        dst[1] = static_cast<uint16_t>((src[1] << 2) | ((low >> 2) & 0x3));
+        dst[2] = static_cast<uint16_t>((src[2] << 2) | ((low >> 4) & 0x3));
+        dst[3] = static_cast<uint16_t>((src[3] << 2) | (low >> 6));
+        src += 5;
+        dst += 4;
+    }
+}
+
+/**
+ * Unpack MIPI RAW12 groups (2 pixels in 3 bytes) to 16-bit samples.
+ */
+inline void unpackMipiRaw12(const uint8_t* src, uint16_t* dst, uint32_t groups) {
+    for (uint32_t g = 0; g < groups; ++g) {
+        dst[0] = static_cast<uint16_t>((src[0] << 4) | (src[2] & 0xF));
+        dst[1] = static_cast<uint16_t>((src[1] << 4) | (src[2] >> 4));
+        src += 3;
+        dst += 2;
+    }
+}
+
+/**
+ * Repack MIPI RAW10 groups into VRAW 10-bit packing (LSB-first), which
+ * uses the same 5 bytes per 4 pixels. Every output byte mixes bits of two
+ * pixels at a different shift, so unlike RAW12 this stays a scalar loop.
+ */
+inline void mipiRaw10ToPacked(const uint8_t* src, uint8_t* dst, uint32_t groups) {
+    for (uint32_t g = 0; g < groups; ++g) {
+        const uint32_t low = src[4];
+        const uint32_t p0 = (static_cast<uint32_t>(src[0]) << 2) | (low & 0x3);
+        const uint32_t p1 = (static_cast<uint32_t>(src[1]) << 2) | ((low >> 2) & 0x3);
+        const uint32_t p2 = (static_cast<uint32_t>(src[2]) << 2) | ((low >> 4) & 0x3);
+        const uint32_t p3 = (static_cast<uint32_t>(src[3]) << 2) | (low >> 6);
+        dst[0] = static_cast<uint8_t>(p0);
+        dst[1] = static_cast<uint8_t>((p0 >> 8) | (p1 << 2));
+        dst[2] = static_cast<uint8_t>((p1 >> 6) | (p2 << 4));
+        dst[3] = static_cast<uint8_t>((p2 >> 4) | (p3 << 6));
+        dst[4] = static_cast<uint8_t>(p3 >> 2);
+        src += 5;
+        dst += 5;
+    }
+}
+
+/**
+ * Repack MIPI RAW12 groups into VRAW 12-bit packing (MSB-first). Both use
+ * 3 bytes per pixel pair, so this is a byte and nibble shuffle: NEON
+ * deinterleaves 16 groups per step, SSSE3 (when enabled at compile time)
+ * shuffles 5 groups per pshufb; the rest runs scalar.
+ */
+inline void mipiRaw12ToPacked(const uint8_t* src, uint8_t* dst, uint32_t groups) {
+    uint32_t g = 0;
+#if defined(VRAW_MIPI_NEON)
+    for (; g + 16 <= groups; g += 16) {
+        // val[0] = high0, val[1] = high1, val[2] = low nibbles of both
+        uint8x16x3_t in = vld3q_u8(src);
+        uint8x16x3_t out;
+        out.val[0] = in.val[0];
+        out.val[1] = vorrq_u8(vshlq_n_u8(in.val[2], 4), vshrq_n_u8(in.val[1], 4));
+        out.val[2] = vorrq_u8(vshlq_n_u8(in.val[1], 4), vshrq_n_u8(in.val[2], 4));
+        vst3q_u8(dst, out);
+        src += 48;
+        dst += 48;
+    }
+#elif defined(VRAW_MIPI_SSSE3)
+    // Per group, `left` holds (high0, low, high1) and `right` (-, high1, low):
+    // byte 0 is high0 as is, bytes 1 and 2 are left << 4 | right >> 4
+    const __m128i leftIndex = _mm_setr_epi8(0, 2, 1, 3, 5, 4, 6, 8, 7, 9, 11, 10, 12, 14, 13, -1);
+    const __m128i rightIndex = _mm_setr_epi8(-1, 1, 2, -1, 4, 5, -1, 7, 8, -1, 10, 11, -1, 13, 14, -1);
+    const __m128i wholeByte = _mm_setr_epi8(-1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, 0);
+    const __m128i highNibbles = _mm_set1_epi8(static_cast<char>(0xF0));
+    const __m128i lowNibbles = _mm_set1_epi8(0x0F);
+    // Each step reads and writes 16 bytes but advances 15 (5 groups)
+    for (; g + 6 <= groups; g += 5) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i left = _mm_shuffle_epi8(in, leftIndex);
+        const __m128i right = _mm_shuffle_epi8(in, rightIndex);
+        const __m128i shifted = _mm_or_si128(
+            _mm_and_si128(_mm_slli_epi16(left, 4), highNibbles),
+            _mm_and_si128(_mm_srli_epi16(right, 4), lowNibbles));
+        const __m128i out = _mm_or_si128(_mm_and_si128(wholeByte, left),
+                                         _mm_andnot_si128(wholeByte, shifted));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), out);
+        src += 15;
+        dst += 15;
+    }
+#endif
+    for (; g < groups; ++g) {
+        const uint8_t high0 = src[0];
+        const uint8_t high1 = src[1];
+        const uint8_t low = src[2];
+        dst[0] = high0;
+        dst[1] = static_cast<uint8_t>(((low & 0xF) << 4) | (high1 >> 4));
+        dst[2] = static_cast<uint8_t>(((high1 & 0xF) << 4) | (low >> 4));
+        src += 3;
+        dst += 3;
+    }
+}
+
+} // namespace detail
+} // namespace vraw
+
+#endif // VRAW_BIT_PACKING_H
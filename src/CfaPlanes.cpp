@@ -0,0 +1,161 @@
+/**
+ * VRAW Library - CFA plane helpers implementation
+ */
+
+#include "CfaPlanes.h"
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define HAS_NEON 1
+#else
+#define HAS_NEON 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAS_SSE2 1
+#else
+#define HAS_SSE2 0
+#endif
+
+namespace vraw {
+namespace detail {
+
+int cfaPlanePosition(BayerPattern pattern, int plane) {
+    // Per pattern: plane (R, G1, G2, B) -> tile position
+    static const uint8_t positions[4][4] = {
+        {0, 1, 2, 3},   // RGGB: R G1 / G2 B
+        {1, 0, 3, 2},   // GRBG: G1 R / B G2
+        {2, 3, 0, 1},   // GBRG: G2 B / R G1
+        {3, 2, 1, 0},   // BGGR: B G2 / G1 R
+    };
+    uint8_t p = static_cast<uint8_t>(pattern);
+    return positions[p < 4 ? p : 0][plane & 3];
+}
+
+void cfaPlanesByPosition(BayerPattern pattern, uint16_t* planes, size_t planeSize,
+                         uint16_t* byPosition[4]) {
+    for (int plane = 0; plane < 4; ++plane) {
+        byPosition[cfaPlanePosition(pattern, plane)] = planes + plane * planeSize;
+    }
+}
+
+void deinterleaveRow(const uint16_t* src, uint16_t* even, uint16_t* odd, uint32_t pairs) {
+    uint32_t i = 0;
+#if HAS_NEON
+    for (; i + 8 <= pairs; i += 8) {
+        uint16x8x2_t v = vld2q_u16(src + i * 2);
+        vst1q_u16(even + i, v.val[0]);
+        vst1q_u16(odd + i, v.val[1]);
+    }
+#elif HAS_SSE2
+    for (; i + 8 <= pairs; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2 + 8));
+        // Sign-extend each 16-bit half so packs_epi32 keeps the bit pattern
+        __m128i evenA = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        __m128i evenB = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        __m128i oddA = _mm_srai_epi32(a, 16);
+        __m128i oddB = _mm_srai_epi32(b, 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(even + i), _mm_packs_epi32(evenA, evenB));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(odd + i), _mm_packs_epi32(oddA, oddB));
+    }
+#endif
+    for (; i < pairs; ++i) {
+        even[i] = src[i * 2];
+        odd[i] = src[i * 2 + 1];
+    }
+}
+
+void unpackRow12BitToPairs(const uint8_t* src, uint16_t* even, uint16_t* odd, uint32_t pairs) {
+    for (uint32_t i = 0; i < pairs; ++i) {
+        const uint8_t b0 = src[0];
+        const uint8_t b1 = src[1];
+        const uint8_t b2 = src[2];
+        even[i] = static_cast<uint16_t>((b0 << 4) | (b1 >> 4));
+        odd[i] = static_cast<uint16_t>(((b1 & 0x0F) << 8) | b2);
+        src += 3;
+    }
+}
+
+void unpackRow10BitToPairs(const uint8_t* src, uint16_t* even, uint16_t* odd, uint32_t pairs) {
+    // 4 pixels (2 pairs) per 5-byte group, little-endian bit order
+    for (uint32_t i = 0; i + 1 < pairs; i += 2) {
+        const uint64_t bits = static_cast<uint64_t>(src[0]) |
+                              (static_cast<uint64_t>(src[1]) << 8) |
+                              (static_cast<uint64_t>(src[2]) << 16) |
+                              (static_cast<uint64_t>(src[3]) << 24) |
+                              (static_cast<uint64_t>(src[4]) << 32);
+        even[i] = static_cast<uint16_t>(bits & 0x3FF);
+        odd[i] = static_cast<uint16_t>((bits >> 10) & 0x3FF);
+        even[i + 1] = static_cast<uint16_t>((bits >> 20) & 0x3FF);
+        odd[i + 1] = static_cast<uint16_t>((bits >> 30) & 0x3FF);
+        src += 5;
+    }
+}
+
+void mosaicToPlanes(const uint16_t* src, uint32_t width, uint32_t height,
+                    BayerPattern pattern, uint16_t* planes) {
+    const uint32_t planeW = width / 2;
+    const size_t planeSize = static_cast<size_t>(planeW) * (height / 2);
+    uint16_t* byPosition[4];
+    cfaPlanesByPosition(pattern, planes, planeSize, byPosition);
+
+    for (uint32_t y = 0; y < (height & ~1u); ++y) {
+        const size_t outRow = static_cast<size_t>(y / 2) * planeW;
+        const int rowPos = (y & 1) * 2;
+        deinterleaveRow(src + static_cast<size_t>(y) * width,
+                        byPosition[rowPos] + outRow,
+                        byPosition[rowPos + 1] + outRow,
+                        planeW);
+    }
+}
+
+void interleaveRow(const uint16_t* even, const uint16_t* odd, uint16_t* dst, uint32_t pairs) {
+    uint32_t i = 0;
+#if HAS_NEON
+    for (; i + 8 <= pairs; i += 8) {
+        uint16x8x2_t v;
+        v.val[0] = vld1q_u16(even + i);
+        v.val[1] = vld1q_u16(odd + i);
+        vst2q_u16(dst + i * 2, v);
+    }
+#elif HAS_SSE2
+    for (; i + 8 <= pairs; i += 8) {
+        __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(even + i));
+        __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(odd + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), _mm_unpacklo_epi16(e, o));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2 + 8), _mm_unpackhi_epi16(e, o));
+    }
+#endif
+    for (; i < pairs; ++i) {
+        dst[i * 2] = even[i];
+        dst[i * 2 + 1] = odd[i];
+    }
+}
+
+void planesToMosaic(const uint16_t* planes, uint32_t width, uint32_t height,
+                    BayerPattern pattern, uint16_t* dst) {
+    const uint32_t planeW = width / 2;
+    const size_t planeSize = static_cast<size_t>(planeW) * (height / 2);
+    const uint16_t* byPosition[4];
+    for (int plane = 0; plane < 4; ++plane) {
+        byPosition[cfaPlanePosition(pattern, plane)] = planes + plane * planeSize;
+    }
+
+    for (uint32_t y = 0; y < (height & ~1u); ++y) {
+        const size_t inRow = static_cast<size_t>(y / 2) * planeW;
+        const int rowPos = (y & 1) * 2;
+        interleaveRow(byPosition[rowPos] + inRow, byPosition[rowPos + 1] + inRow,
+                      dst + static_cast<size_t>(y) * width, planeW);
+    }
+}
+
+void offsetSamples(uint16_t* samples, size_t count, uint16_t add, uint16_t mask) {
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] = static_cast<uint16_t>((samples[i] + add) & mask);
+    }
+}
+
+} // namespace detail
+} // namespace vraw
@@ -0,0 +1,85 @@
+/**
+ * VRAW Library - CFA plane helpers
+ *
+ * Deinterleave / interleave kernels between the Bayer mosaic and
+ * half-resolution R, G1, G2, B planes. Not part of the public API.
+ */
+
+#ifndef VRAW_CFA_PLANES_H
+#define VRAW_CFA_PLANES_H
+
+#include "VrawTypes.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace vraw {
+namespace detail {
+
+/**
+ * Tile position (row * 2 + col) of a CFA plane (0=R, 1=G1, 2=G2, 3=B).
+ * G1 is the green sample on the red row, G2 the green sample on the blue row.
+ */
+int cfaPlanePosition(BayerPattern pattern, int plane);
+
+/**
+ * Resolve the destination plane for each 2x2 tile position.
+ *
+ * @param planes Base of four consecutive planes (R, G1, G2, B)
+ * @param planeSize Samples per plane
+ * @param byPosition Output: plane base pointer for tile position 0..3
+ */
+void cfaPlanesByPosition(BayerPattern pattern, uint16_t* planes, size_t planeSize,
+                         uint16_t* byPosition[4]);
+
+/**
+ * Split one mosaic row into its even and odd columns.
+ *
+ * @param src Mosaic row (at least pairs * 2 samples)
+ * @param even Output for columns 0, 2, 4, ...
+ * @param odd Output for columns 1, 3, 5, ...
+ * @param pairs Number of column pairs
+ */
+void deinterleaveRow(const uint16_t* src, uint16_t* even, uint16_t* odd, uint32_t pairs);
+
+/**
+ * Unpack one 12-bit packed row (MSB-first, 3 bytes per pixel pair)
+ * directly into even/odd column outputs.
+ */
+void unpackRow12BitToPairs(const uint8_t* src, uint16_t* even, uint16_t* odd, uint32_t pairs);
+
+/**
+ * Unpack one 10-bit packed row (LSB-first, 5 bytes per 4 pixels) directly
+ * into even/odd column outputs. pairs must be even (row width multiple of 4).
+ */
+void unpackRow10BitToPairs(const uint8_t* src, uint16_t* even, uint16_t* odd, uint32_t pairs);
+
+/**
+ * Deinterleave a full mosaic frame into R, G1, G2, B planes of
+ * (width / 2) x (height / 2) samples. Odd trailing rows/columns are dropped.
+ */
+void mosaicToPlanes(const uint16_t* src, uint32_t width, uint32_t height,
+                    BayerPattern pattern, uint16_t* planes);
+
+/**
+ * Merge even and odd column outputs back into one mosaic row.
+ */
+void interleaveRow(const uint16_t* even, const uint16_t* odd, uint16_t* dst, uint32_t pairs);
+
+/**
+ * Interleave R, G1, G2, B planes back into a mosaic frame. Inverse of
+ * mosaicToPlanes(); width and height must be even.
+ */
+void planesToMosaic(const uint16_t* planes, uint32_t width, uint32_t height,
+                    BayerPattern pattern, uint16_t* dst);
+
+/**
+ * In-place modular add: samples[i] = (samples[i] + add) & mask.
+ * Used to remove (add = mask + 1 - black) or restore (add = black) a
+ * per-plane black level losslessly within the sample bit depth.
+ */
+void offsetSamples(uint16_t* samples, size_t count, uint16_t add, uint16_t mask);
+
+} // namespace detail
+} // namespace vraw
+
+#endif // VRAW_CFA_PLANES_H
@@ -0,0 +1,466 @@
+/**
+ * VRAW Library - Clip Scanner Implementation
+ */
+
+#include "ClipScanner.h"
+#include "InputSource.h"
+#include "ThreadPool.h"
+#include "VrawFormat.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <sys/stat.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOG_TAG "ClipScanner"
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#define LOGE(...) do { fprintf(stderr, "[VRAW ERROR] "); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); } while(0)
+#endif
+
+namespace fs = std::filesystem;
+
+namespace vraw {
+
+namespace {
+
+// Cache file: CacheFileHeader, then per clip a u32 path length, the path
+// and a CacheRecord
+#pragma pack(push, 1)
+struct CacheFileHeader {
+    char magic[4];              // "VSCN"
+    uint32_t version;           // 1
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct CacheRecord {
+    uint64_t file_size;
+    uint64_t inode;
+    int64_t mtime_ns;
+    uint32_t width;
+    uint32_t height;
+    uint8_t encoding;
+    uint8_t compression;
+    uint8_t storage_layout;
+    uint8_t flags;              // CACHE_FLAG_*
+    uint32_t frame_count;
+    uint64_t first_timestamp_us;
+    uint64_t duration_us;
+    uint64_t video_bytes;
+    uint64_t bitrate;
+    uint16_t audio_channels;
+    uint16_t reserved;
+    uint32_t audio_sample_rate;
+    uint64_t audio_sample_count;
+};
+#pragma pack(pop)
+
+const uint8_t CACHE_FLAG_FINALIZED = 0x01;
+const uint8_t CACHE_FLAG_AUDIO = 0x02;
+const uint8_t CACHE_FLAG_STATS = 0x04;
+
+const uint64_t FILE_HEADER_BYTES = sizeof(SimpleFileHeader);
+
+// Paths longer than this in a cache file mean it is corrupt
+const uint32_t MAX_CACHED_PATH = 64 * 1024;
+
+struct FileIdentity {
+    uint64_t size = 0;
+    uint64_t inode = 0;
+    int64_t mtimeNs = 0;
+};
+
+bool statFile(const std::string& path, FileIdentity& id) {
+#ifdef _WIN32
+    std::error_code ec;
+    id.size = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    const auto mtime = fs::last_write_time(path, ec);
+    id.inode = 0;
+    id.mtimeNs = ec ? 0 : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              mtime.time_since_epoch()).count();
+    return true;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    id.size = static_cast<uint64_t>(st.st_size);
+    id.inode = static_cast<uint64_t>(st.st_ino);
+#ifdef __APPLE__
+    id.mtimeNs = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    id.mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+#endif
+}
+
+bool hasExtension(const std::string& path, const std::vector<std::string>& extensions) {
+    for (const std::string& ext : extensions) {
+        if (path.size() >= ext.size() &&
+            std::equal(ext.begin(), ext.end(), path.end() - ext.size(), [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) ==
+                       std::tolower(static_cast<unsigned char>(b));
+            })) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* encodingName(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::LINEAR_10BIT: return "LINEAR_10BIT";
+        case Encoding::LOG2_10BIT: return "LOG2_10BIT";
+        case Encoding::LOG_8BIT: return "LOG_8BIT";
+        case Encoding::CINEON_10BIT: return "CINEON_10BIT";
+        case Encoding::LOG2_12BIT: return "LOG2_12BIT";
+        case Encoding::LINEAR_12BIT: return "LINEAR_12BIT";
+        case Encoding::LINEAR_14BIT: return "LINEAR_14BIT";
+        default: return "UNKNOWN";
+    }
+}
+
+void appendJsonString(std::string& out, const std::string& s) {
+    out += '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+bool ClipScanner::readClipInfo(const std::string& path, ClipInfo& info) {
+    FileIdentity id;
+    FileSource source;
+    if (!statFile(path, id) || !source.open(path)) {
+        return false;
+    }
+
+    SimpleFileHeader raw;
+    if (!source.readAt(0, &raw, sizeof(raw)) ||
+        (memcmp(raw.magic, "VRAW", 4) != 0 && memcmp(raw.magic, "MRAW", 4) != 0)) {
+        return false;
+    }
+
+    info = ClipInfo();
+    info.path = path;
+    info.fileSize = source.size();
+    info.inode = id.inode;
+    info.mtimeNs = id.mtimeNs;
+    info.width = raw.width;
+    info.height = raw.height;
+    info.encoding = static_cast<Encoding>(raw.encoding);
+    info.compression = static_cast<Compression>(raw.compression);
+    info.frameCount = raw.frame_count;
+    const bool v2 = raw.version >= 2;
+    if (v2) {
+        info.storageLayout = static_cast<FrameLayout>(raw.storage_layout);
+    }
+
+    // A finished file ends its index with an "MIDX" footer
+    uint64_t lastFrameOffset = 0;
+    if (raw.index_offset >= FILE_HEADER_BYTES && raw.frame_count > 0) {
+        const uint64_t footer = raw.index_offset + static_cast<uint64_t>(raw.frame_count) * sizeof(uint64_t);
+        char magic[4];
+        if (footer + 16 <= info.fileSize && source.readAt(footer, magic, sizeof(magic)) &&
+            memcmp(magic, "MIDX", 4) == 0 &&
+            source.readAt(footer - sizeof(uint64_t), &lastFrameOffset, sizeof(lastFrameOffset))) {
+            info.finalized = true;
+        }
+    }
+
+    SimpleFrameHeader first;
+    if (info.frameCount > 0 && source.readAt(FILE_HEADER_BYTES, &first, sizeof(first))) {
+        info.firstTimestampUs = first.timestamp_us;
+        SimpleFrameHeader last;
+        if (info.finalized && info.frameCount > 1 && lastFrameOffset + sizeof(last) <= info.fileSize &&
+            source.readAt(lastFrameOffset, &last, sizeof(last)) && last.timestamp_us > first.timestamp_us) {
+            const uint64_t span = last.timestamp_us - first.timestamp_us;
+            info.durationUs = span + span / (info.frameCount - 1);
+        }
+    }
+
+    // Frames run from the file header to the audio stream or index
+    uint64_t videoEnd = info.fileSize;
+    if (info.finalized) {
+        videoEnd = raw.index_offset;
+    }
+    if (v2 && raw.has_audio && raw.audio_offset >= FILE_HEADER_BYTES && raw.audio_offset < videoEnd) {
+        videoEnd = raw.audio_offset;
+    }
+    info.videoBytes = videoEnd > FILE_HEADER_BYTES ? videoEnd - FILE_HEADER_BYTES : 0;
+    if (info.durationUs > 0) {
+        info.bitrate = static_cast<uint64_t>(static_cast<double>(info.videoBytes) * 8.0 * 1e6 /
+                                             static_cast<double>(info.durationUs));
+    }
+
+    AudioStreamHeader ash;
+    if (v2 && raw.has_audio && raw.audio_offset >= FILE_HEADER_BYTES &&
+        source.readAt(raw.audio_offset, &ash, sizeof(ash)) && memcmp(ash.magic, "MAUD", 4) == 0) {
+        info.hasAudio = true;
+        info.audioChannels = ash.channels;
+        info.audioSampleRate = ash.sample_rate;
+        info.audioSampleCount = ash.sample_count;
+    }
+
+    FrameStatsTableHeader th;
+    info.hasFrameStats = v2 && raw.stats_offset >= FILE_HEADER_BYTES &&
+                         source.readAt(raw.stats_offset, &th, sizeof(th)) &&
+                         memcmp(th.magic, "MSTA", 4) == 0;
+    return true;
+}
+
+bool ClipScanner::loadCache(const std::string& path) {
+    catalogue_.clear();
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+
+    CacheFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, "VSCN", 4) == 0 &&
+              header.version == 1;
+    for (uint32_t i = 0; ok && i < header.count; ++i) {
+        uint32_t pathLength = 0;
+        CacheRecord r;
+        ClipInfo info;
+        ok = fread(&pathLength, sizeof(pathLength), 1, f) == 1 && pathLength <= MAX_CACHED_PATH;
+        if (ok) {
+            info.path.resize(pathLength);
+            ok = (pathLength == 0 || fread(&info.path[0], pathLength, 1, f) == 1) &&
+                 fread(&r, sizeof(r), 1, f) == 1;
+        }
+        if (!ok) {
+            break;
+        }
+        info.fileSize = r.file_size;
+        info.inode = r.inode;
+        info.mtimeNs = r.mtime_ns;
+        info.width = r.width;
+        info.height = r.height;
+        info.encoding = static_cast<Encoding>(r.encoding);
+        info.compression = static_cast<Compression>(r.compression);
+        info.storageLayout = static_cast<FrameLayout>(r.storage_layout);
+        info.frameCount = r.frame_count;
+        info.finalized = (r.flags & CACHE_FLAG_FINALIZED) != 0;
+        info.firstTimestampUs = r.first_timestamp_us;
+        info.durationUs = r.duration_us;
+        info.videoBytes = r.video_bytes;
+        info.bitrate = r.bitrate;
+        info.hasAudio = (r.flags & CACHE_FLAG_AUDIO) != 0;
+        info.audioChannels = r.audio_channels;
+        info.audioSampleRate = r.audio_sample_rate;
+        info.audioSampleCount = r.audio_sample_count;
+        info.hasFrameStats = (r.flags & CACHE_FLAG_STATS) != 0;
+        catalogue_.push_back(std::move(info));
+    }
+    fclose(f);
+
+    if (!ok) {
+        LOGE("Ignoring unreadable scan cache: %s", path.c_str());
+        catalogue_.clear();
+        return false;
+    }
+    std::sort(catalogue_.begin(), catalogue_.end(),
+              [](const ClipInfo& a, const ClipInfo& b) { return a.path < b.path; });
+    return true;
+}
+
+bool ClipScanner::saveCache(const std::string& path) const {
+    // Written beside the target and renamed, so a crash never leaves half a cache
+    const std::string temp = path + ".tmp";
+    FILE* f = fopen(temp.c_str(), "wb");
+    if (!f) {
+        LOGE("Failed to create scan cache: %s", temp.c_str());
+        return false;
+    }
+
+    CacheFileHeader header = {};
+    memcpy(header.magic, "VSCN", 4);
+    header.version = 1;
+    header.count = static_cast<uint32_t>(catalogue_.size());
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (const ClipInfo& info : catalogue_) {
+        if (!ok) {
+            break;
+        }
+        CacheRecord r = {};
+        r.file_size = info.fileSize;
+        r.inode = info.inode;
+        r.mtime_ns = info.mtimeNs;
+        r.width = info.width;
+        r.height = info.height;
+        r.encoding = static_cast<uint8_t>(info.encoding);
+        r.compression = static_cast<uint8_t>(info.compression);
+        r.storage_layout = static_cast<uint8_t>(info.storageLayout);
+        r.flags = (info.finalized ? CACHE_FLAG_FINALIZED : 0) | (info.hasAudio ? CACHE_FLAG_AUDIO : 0) |
+                  (info.hasFrameStats ? CACHE_FLAG_STATS : 0);
+        r.frame_count = info.frameCount;
+        r.first_timestamp_us = info.firstTimestampUs;
+        r.duration_us = info.durationUs;
+        r.video_bytes = info.videoBytes;
+        r.bitrate = info.bitrate;
+        r.audio_channels = info.audioChannels;
+        r.audio_sample_rate = info.audioSampleRate;
+        r.audio_sample_count = info.audioSampleCount;
+
+        const uint32_t pathLength = static_cast<uint32_t>(info.path.size());
+        ok = fwrite(&pathLength, sizeof(pathLength), 1, f) == 1 &&
+             (pathLength == 0 || fwrite(info.path.data(), pathLength, 1, f) == 1) &&
+             fwrite(&r, sizeof(r), 1, f) == 1;
+    }
+    ok = (fclose(f) == 0) && ok;
+
+    std::error_code ec;
+    if (ok) {
+        fs::rename(temp, path, ec);
+    }
+    if (!ok || ec) {
+        LOGE("Failed to write scan cache: %s", path.c_str());
+        fs::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+bool ClipScanner::scan(const std::vector<std::string>& roots, const Options& options,
+                       std::vector<ClipInfo>& clips) {
+    clips.clear();
+    cachedCount_ = 0;
+    readCount_ = 0;
+    detail::ThreadPool pool(options.threads);
+    bool ok = true;
+
+    // Roots that are files are taken as clips whatever their extension
+    std::vector<std::string> files;
+    std::vector<std::string> level;
+    for (const std::string& root : roots) {
+        std::error_code ec;
+        const fs::file_status status = fs::status(root, ec);
+        if (fs::is_directory(status)) {
+            level.push_back(root);
+        } else if (fs::is_regular_file(status)) {
+            files.push_back(root);
+        } else {
+            LOGE("Cannot scan %s", root.c_str());
+            ok = false;
+        }
+    }
+
+    // Walk one directory level at a time, listing its directories in parallel
+    while (!level.empty()) {
+        std::vector<std::vector<std::string>> subdirs(level.size());
+        std::vector<std::vector<std::string>> found(level.size());
+        pool.parallelFor(static_cast<uint32_t>(level.size()), [&](uint32_t i) {
+            std::error_code ec;
+            for (fs::directory_iterator it(level[i], fs::directory_options::skip_permission_denied, ec), end;
+                 !ec && it != end; it.increment(ec)) {
+                // Symlinked directories are not followed, so links cannot loop
+                const fs::file_status linkStatus = it->symlink_status(ec);
+                if (ec) {
+                    break;
+                }
+                if (fs::is_directory(linkStatus)) {
+                    if (options.recursive) {
+                        subdirs[i].push_back(it->path().string());
+                    }
+                } else if (hasExtension(it->path().string(), options.extensions)) {
+                    found[i].push_back(it->path().string());
+                }
+            }
+        });
+        level.clear();
+        for (size_t i = 0; i < subdirs.size(); ++i) {
+            level.insert(level.end(), subdirs[i].begin(), subdirs[i].end());
+            files.insert(files.end(), found[i].begin(), found[i].end());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    // Unchanged files come from the cache; the rest are read in parallel
+    std::vector<ClipInfo> entries(files.size());
+    std::vector<uint8_t> valid(files.size(), 0);
+    std::vector<uint8_t> fromCache(files.size(), 0);
+    pool.parallelFor(static_cast<uint32_t>(files.size()), [&](uint32_t i) {
+        FileIdentity id;
+        if (!statFile(files[i], id)) {
+            return;
+        }
+        auto cached = std::lower_bound(catalogue_.begin(), catalogue_.end(), files[i],
+                                       [](const ClipInfo& c, const std::string& p) { return c.path < p; });
+        if (cached != catalogue_.end() && cached->path == files[i] && cached->fileSize == id.size &&
+            cached->inode == id.inode && cached->mtimeNs == id.mtimeNs) {
+            entries[i] = *cached;
+            valid[i] = 1;
+            fromCache[i] = 1;
+            return;
+        }
+        valid[i] = readClipInfo(files[i], entries[i]) ? 1 : 0;
+    });
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!valid[i]) {
+            continue;
+        }
+        if (fromCache[i]) {
+            cachedCount_++;
+        } else {
+            readCount_++;
+        }
+        clips.push_back(std::move(entries[i]));
+    }
+    catalogue_ = clips;
+    return ok;
+}
+
+std::string ClipScanner::toJson(const std::vector<ClipInfo>& clips) {
+    std::string out = "[";
+    char buffer[512];
+    for (size_t i = 0; i < clips.size(); ++i) {
+        const ClipInfo& c = clips[i];
+        out += i ? ",\n  {\"path\": " : "\n  {\"path\": ";
+        appendJsonString(out, c.path);
+        snprintf(buffer, sizeof(buffer),
+                 ", \"size\": %llu, \"width\": %u, \"height\": %u, \"encoding\": \"%s\", "
+                 "\"compressed\": %s, \"frames\": %u, \"finalized\": %s, \"duration_s\": %.3f, "
+                 "\"fps\": %.3f, \"bitrate\": %llu, \"frame_stats\": %s",
+                 static_cast<unsigned long long>(c.fileSize), c.width, c.height, encodingName(c.encoding),
+                 c.compression != Compression::NONE ? "true" : "false", c.frameCount,
+                 c.finalized ? "true" : "false", c.durationUs / 1e6,
+                 c.durationUs ? c.frameCount * 1e6 / c.durationUs : 0.0,
+                 static_cast<unsigned long long>(c.bitrate), c.hasFrameStats ? "true" : "false");
+        out += buffer;
+        if (c.hasAudio) {
+            snprintf(buffer, sizeof(buffer),
+                     ", \"audio\": {\"channels\": %u, \"sample_rate\": %u, \"duration_s\": %.3f}",
+                     c.audioChannels, c.audioSampleRate,
+                     c.audioSampleRate ? static_cast<double>(c.audioSampleCount) / c.audioSampleRate : 0.0);
+            out += buffer;
+        }
+        out += "}";
+    }
+    out += clips.empty() ? "]\n" : "\n]\n";
+    return out;
+}
+
+} // namespace vraw
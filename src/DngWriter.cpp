@@ -0,0 +1,394 @@
+/**
+ * VRAW Library - DNG Writer Implementation
+ */
+
+#include "DngWriter.h"
+#include "BitPacking.h"
+#include "Encoding.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vraw {
+
+namespace {
+
+// TIFF field types
+enum : uint16_t {
+    TIFF_BYTE = 1,
+    TIFF_ASCII = 2,
+    TIFF_SHORT = 3,
+    TIFF_LONG = 4,
+    TIFF_RATIONAL = 5,
+    TIFF_SRATIONAL = 10
+};
+
+// Tags, in the ascending order the IFD requires
+enum : uint16_t {
+    TAG_NEW_SUBFILE_TYPE = 254,
+    TAG_IMAGE_WIDTH = 256,
+    TAG_IMAGE_LENGTH = 257,
+    TAG_BITS_PER_SAMPLE = 258,
+    TAG_COMPRESSION = 259,
+    TAG_PHOTOMETRIC = 262,
+    TAG_STRIP_OFFSETS = 273,
+    TAG_ORIENTATION = 274,
+    TAG_SAMPLES_PER_PIXEL = 277,
+    TAG_ROWS_PER_STRIP = 278,
+    TAG_STRIP_BYTE_COUNTS = 279,
+    TAG_PLANAR_CONFIGURATION = 284,
+    TAG_SOFTWARE = 305,
+    TAG_CFA_REPEAT_PATTERN_DIM = 33421,
+    TAG_CFA_PATTERN = 33422,
+    TAG_DNG_VERSION = 50706,
+    TAG_DNG_BACKWARD_VERSION = 50707,
+    TAG_UNIQUE_CAMERA_MODEL = 50708,
+    TAG_CFA_PLANE_COLOR = 50710,
+    TAG_CFA_LAYOUT = 50711,
+    TAG_LINEARIZATION_TABLE = 50712,
+    TAG_BLACK_LEVEL_REPEAT_DIM = 50713,
+    TAG_BLACK_LEVEL = 50714,
+    TAG_WHITE_LEVEL = 50717,
+    TAG_COLOR_MATRIX_1 = 50721,
+    TAG_AS_SHOT_NEUTRAL = 50728,
+    TAG_CALIBRATION_ILLUMINANT_1 = 50778,
+    TAG_TIME_CODES = 51043,
+    TAG_FRAME_RATE = 51044
+};
+
+const uint16_t PHOTOMETRIC_CFA = 32803;
+const uint16_t ILLUMINANT_D65 = 21;
+const uint32_t PIXEL_DATA_ALIGNMENT = 16;
+
+struct Tag {
+    uint16_t id;
+    uint16_t type;
+    uint32_t count;
+    std::vector<uint8_t> data;  // Little-endian values; inline in the entry when <= 4 bytes
+};
+
+void put16(std::vector<uint8_t>& v, uint16_t value) {
+    v.push_back(static_cast<uint8_t>(value));
+    v.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void put32(std::vector<uint8_t>& v, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        v.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+Tag& addTag(std::vector<Tag>& tags, uint16_t id, uint16_t type, uint32_t count) {
+    tags.push_back(Tag{id, type, count, {}});
+    return tags.back();
+}
+
+void addShorts(std::vector<Tag>& tags, uint16_t id, std::initializer_list<uint16_t> values) {
+    Tag& tag = addTag(tags, id, TIFF_SHORT, static_cast<uint32_t>(values.size()));
+    for (uint16_t value : values) {
+        put16(tag.data, value);
+    }
+}
+
+void addLongs(std::vector<Tag>& tags, uint16_t id, std::initializer_list<uint32_t> values) {
+    Tag& tag = addTag(tags, id, TIFF_LONG, static_cast<uint32_t>(values.size()));
+    for (uint32_t value : values) {
+        put32(tag.data, value);
+    }
+}
+
+void addBytes(std::vector<Tag>& tags, uint16_t id, std::initializer_list<uint8_t> values) {
+    Tag& tag = addTag(tags, id, TIFF_BYTE, static_cast<uint32_t>(values.size()));
+    tag.data.assign(values.begin(), values.end());
+}
+
+void addAscii(std::vector<Tag>& tags, uint16_t id, const std::string& text) {
+    Tag& tag = addTag(tags, id, TIFF_ASCII, static_cast<uint32_t>(text.size() + 1));
+    tag.data.assign(text.begin(), text.end());
+    tag.data.push_back(0);
+}
+
+// Rationals with a fixed denominator; enough precision for gains and matrices
+void addRationals(std::vector<Tag>& tags, uint16_t id, uint16_t type,
+                  const float* values, uint32_t count, uint32_t denominator) {
+    Tag& tag = addTag(tags, id, type, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const double scaled = std::round(static_cast<double>(values[i]) * denominator);
+        if (type == TIFF_SRATIONAL) {
+            put32(tag.data, static_cast<uint32_t>(static_cast<int32_t>(scaled)));
+        } else {
+            put32(tag.data, static_cast<uint32_t>(std::max(0.0, scaled)));
+        }
+        put32(tag.data, denominator);
+    }
+}
+
+void cfaColors(BayerPattern pattern, uint8_t colors[4]) {
+    // 0 = red, 1 = green, 2 = blue, in CFAPlaneColor order
+    static const uint8_t PATTERNS[4][4] = {
+        {0, 1, 1, 2},  // RGGB
+        {1, 0, 2, 1},  // GRBG
+        {1, 2, 0, 1},  // GBRG
+        {2, 1, 1, 0}   // BGGR
+    };
+    memcpy(colors, PATTERNS[static_cast<uint8_t>(pattern) & 3], 4);
+}
+
+uint16_t tiffOrientation(int32_t sensorOrientation) {
+    // Clockwise rotation needed to display upright -> TIFF Orientation
+    switch (((sensorOrientation % 360) + 360) % 360) {
+        case 90:  return 6;
+        case 180: return 3;
+        case 270: return 8;
+        default:  return 1;
+    }
+}
+
+uint8_t toBcd(uint32_t value) {
+    return static_cast<uint8_t>(((value / 10) << 4) | (value % 10));
+}
+
+// SMPTE timecode of the clip's start timecode plus frameOffset frames,
+// in the 8-byte CinemaDNG TimeCodes form
+void offsetTimecode(const Timecode& tc, uint32_t frameOffset, uint8_t out[8]) {
+    const uint64_t fps = tc.fps;
+    const uint64_t dropPerMinute = tc.dropFrame ? fps / 15 : 0;  // 2 at 30 fps, 4 at 60 fps
+    const uint64_t framesPerMinute = fps * 60 - dropPerMinute;
+    const uint64_t framesPer10Minutes = fps * 600 - dropPerMinute * 9;
+
+    const uint64_t minutes = tc.hours * 60ull + tc.minutes;
+    uint64_t count = (minutes * 60 + tc.seconds) * fps + tc.frames
+                     - dropPerMinute * (minutes - minutes / 10);
+    count = (count + frameOffset) % (framesPer10Minutes * 6 * 24);
+
+    if (dropPerMinute > 0) {
+        const uint64_t tens = count / framesPer10Minutes;
+        const uint64_t rest = count % framesPer10Minutes;
+        count += dropPerMinute * 9 * tens;
+        if (rest > dropPerMinute) {
+            count += dropPerMinute * ((rest - dropPerMinute) / framesPerMinute);
+        }
+    }
+
+    memset(out, 0, 8);
+    out[0] = static_cast<uint8_t>(toBcd(static_cast<uint32_t>(count % fps)) | (tc.dropFrame ? 0x40 : 0));
+    out[1] = toBcd(static_cast<uint32_t>(count / fps % 60));
+    out[2] = toBcd(static_cast<uint32_t>(count / fps / 60 % 60));
+    out[3] = toBcd(static_cast<uint32_t>(count / fps / 3600 % 24));
+}
+
+bool isLog(Encoding encoding) {
+    return encoding == Encoding::LOG2_10BIT || encoding == Encoding::LOG2_12BIT;
+}
+
+uint32_t storedBits(const FileHeader& file, const DngOptions& options) {
+    return options.packed ? DngWriter::bitDepth(file.encoding) : 16;
+}
+
+uint64_t imageBytes(const FileHeader& file, const DngOptions& options) {
+    const uint64_t rowBytes = (static_cast<uint64_t>(file.width) * storedBits(file, options) + 7) / 8;
+    return rowBytes * file.height;
+}
+
+// Every tag except the strip offset, whose value depends on the layout
+void buildTags(const FileHeader& file, const FrameHeader& frame, const DngOptions& options,
+               std::vector<Tag>& tags) {
+    const uint32_t bits = storedBits(file, options);
+    uint8_t cfa[4];
+    cfaColors(file.bayerPattern, cfa);
+
+    addLongs(tags, TAG_NEW_SUBFILE_TYPE, {0});
+    addLongs(tags, TAG_IMAGE_WIDTH, {file.width});
+    addLongs(tags, TAG_IMAGE_LENGTH, {file.height});
+    addShorts(tags, TAG_BITS_PER_SAMPLE, {static_cast<uint16_t>(bits)});
+    addShorts(tags, TAG_COMPRESSION, {1});
+    addShorts(tags, TAG_PHOTOMETRIC, {PHOTOMETRIC_CFA});
+    addLongs(tags, TAG_STRIP_OFFSETS, {0});
+    addShorts(tags, TAG_ORIENTATION, {tiffOrientation(file.sensorOrientation)});
+    addShorts(tags, TAG_SAMPLES_PER_PIXEL, {1});
+    addLongs(tags, TAG_ROWS_PER_STRIP, {file.height});
+    addLongs(tags, TAG_STRIP_BYTE_COUNTS, {static_cast<uint32_t>(imageBytes(file, options))});
+    addShorts(tags, TAG_PLANAR_CONFIGURATION, {1});
+    addAscii(tags, TAG_SOFTWARE, "VRAW Library");
+    addShorts(tags, TAG_CFA_REPEAT_PATTERN_DIM, {2, 2});
+    addBytes(tags, TAG_CFA_PATTERN, {cfa[0], cfa[1], cfa[2], cfa[3]});
+    addBytes(tags, TAG_DNG_VERSION, {1, 4, 0, 0});
+    addBytes(tags, TAG_DNG_BACKWARD_VERSION, {1, 1, 0, 0});
+    addAscii(tags, TAG_UNIQUE_CAMERA_MODEL, options.cameraModel);
+    addBytes(tags, TAG_CFA_PLANE_COLOR, {0, 1, 2});
+    addShorts(tags, TAG_CFA_LAYOUT, {1});
+
+    uint32_t black[4];
+    if (isLog(file.encoding)) {
+        // Log codes are stored as-is; the table maps them back to linear
+        // values the same way VrawWriter encoded them (around the mean
+        // black level), so the black level is that mean in every position
+        const uint16_t avgBlack = static_cast<uint16_t>(
+            (file.blackLevel[0] + file.blackLevel[1] + file.blackLevel[2] + file.blackLevel[3]) / 4);
+        const uint32_t codes = (file.encoding == Encoding::LOG2_12BIT) ? 4096 : 1024;
+        Tag& table = addTag(tags, TAG_LINEARIZATION_TABLE, TIFF_SHORT, codes);
+        table.data.reserve(codes * 2);
+        for (uint32_t code = 0; code < codes; ++code) {
+            put16(table.data, (file.encoding == Encoding::LOG2_12BIT)
+                              ? decodePixelLog12Bit(static_cast<uint16_t>(code), avgBlack, file.whiteLevel)
+                              : decodePixelLog10Bit(static_cast<uint16_t>(code), avgBlack, file.whiteLevel));
+        }
+        std::fill(black, black + 4, avgBlack);
+    } else {
+        const uint16_t* level = file.blackLevel;
+        for (int i = 0; i < 4; ++i) {
+            if (frame.dynamicBlackLevel[i] != 0) {
+                level = frame.dynamicBlackLevel;
+            }
+        }
+        std::copy(level, level + 4, black);
+    }
+    addShorts(tags, TAG_BLACK_LEVEL_REPEAT_DIM, {2, 2});
+    addLongs(tags, TAG_BLACK_LEVEL, {black[0], black[1], black[2], black[3]});
+    addLongs(tags, TAG_WHITE_LEVEL, {file.whiteLevel});
+    addRationals(tags, TAG_COLOR_MATRIX_1, TIFF_SRATIONAL, options.colorMatrix, 9, 10000);
+
+    // White balance multipliers -> camera-space neutral, normalised to green
+    float neutral[3] = {1.0f, 1.0f, 1.0f};
+    if (frame.whiteBalanceR > 0.0f && frame.whiteBalanceG > 0.0f && frame.whiteBalanceB > 0.0f) {
+        neutral[0] = frame.whiteBalanceG / frame.whiteBalanceR;
+        neutral[2] = frame.whiteBalanceG / frame.whiteBalanceB;
+    }
+    addRationals(tags, TAG_AS_SHOT_NEUTRAL, TIFF_RATIONAL, neutral, 3, 1000000);
+    addShorts(tags, TAG_CALIBRATION_ILLUMINANT_1, {ILLUMINANT_D65});
+
+    if (file.hasTimecode && file.timecode.fps > 0) {
+        uint8_t tc[8];
+        offsetTimecode(file.timecode, frame.frameNumber, tc);
+        Tag& tag = addTag(tags, TAG_TIME_CODES, TIFF_BYTE, 8);
+        tag.data.assign(tc, tc + 8);
+    }
+    if (options.frameRate > 0.0f) {
+        addRationals(tags, TAG_FRAME_RATE, TIFF_SRATIONAL, &options.frameRate, 1, 1000);
+    }
+}
+
+// Offset of the pixel data: header, IFD, then out-of-line tag values
+uint32_t layoutTags(const std::vector<Tag>& tags) {
+    uint32_t offset = 8 + 2 + static_cast<uint32_t>(tags.size()) * 12 + 4;
+    for (const Tag& tag : tags) {
+        if (tag.data.size() > 4) {
+            offset += static_cast<uint32_t>((tag.data.size() + 1) & ~size_t(1));
+        }
+    }
+    return (offset + PIXEL_DATA_ALIGNMENT - 1) & ~(PIXEL_DATA_ALIGNMENT - 1);
+}
+
+bool representable(const FileHeader& file) {
+    return file.width > 0 && file.height > 0 && file.width % 2 == 0 && file.height % 2 == 0 &&
+           DngWriter::bitDepth(file.encoding) != 0;
+}
+
+template <int Bits>
+void packRows(const uint16_t* mosaic, uint32_t width, uint32_t height, uint8_t* dst) {
+    // DNG packs odd bit depths MSB-first, each row starting on a byte
+    using Packer = detail::BitPacker<Bits, detail::BitOrder::MSB_FIRST>;
+    const uint32_t rowBytes = Packer::packedBytes(width);
+    for (uint32_t y = 0; y < height; ++y) {
+        Packer::pack(mosaic + static_cast<size_t>(y) * width, width, dst + static_cast<size_t>(y) * rowBytes);
+    }
+}
+
+} // namespace
+
+uint32_t DngWriter::bitDepth(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::LINEAR_10BIT:
+        case Encoding::LOG2_10BIT:
+            return 10;
+        case Encoding::LINEAR_12BIT:
+        case Encoding::LOG2_12BIT:
+            return 12;
+        case Encoding::LINEAR_14BIT:
+            return 14;
+        default:
+            return 0;
+    }
+}
+
+uint64_t DngWriter::encodedSize(const FileHeader& file, const DngOptions& options) {
+    if (!representable(file)) {
+        return 0;
+    }
+    std::vector<Tag> tags;
+    FrameHeader frame = {};
+    buildTags(file, frame, options, tags);
+    return layoutTags(tags) + imageBytes(file, options);
+}
+
+bool DngWriter::encode(const FileHeader& file, const FrameHeader& frame, const uint16_t* mosaic,
+                       const DngOptions& options, std::vector<uint8_t>& out) {
+    if (!representable(file) || mosaic == nullptr) {
+        return false;
+    }
+
+    std::vector<Tag> tags;
+    tags.reserve(32);
+    buildTags(file, frame, options, tags);
+    std::sort(tags.begin(), tags.end(), [](const Tag& a, const Tag& b) { return a.id < b.id; });
+
+    const uint32_t pixelOffset = layoutTags(tags);
+    for (Tag& tag : tags) {
+        if (tag.id == TAG_STRIP_OFFSETS) {
+            tag.data.clear();
+            put32(tag.data, pixelOffset);
+        }
+    }
+
+    const uint64_t pixelBytes = imageBytes(file, options);
+    out.clear();
+    out.reserve(pixelOffset + pixelBytes);
+
+    // Little-endian TIFF header, IFD straight after it
+    out.push_back('I');
+    out.push_back('I');
+    put16(out, 42);
+    put32(out, 8);
+
+    put16(out, static_cast<uint16_t>(tags.size()));
+    uint32_t dataOffset = 8 + 2 + static_cast<uint32_t>(tags.size()) * 12 + 4;
+    for (const Tag& tag : tags) {
+        put16(out, tag.id);
+        put16(out, tag.type);
+        put32(out, tag.count);
+        if (tag.data.size() <= 4) {
+            for (size_t i = 0; i < 4; ++i) {
+                out.push_back(i < tag.data.size() ? tag.data[i] : 0);
+            }
+        } else {
+            put32(out, dataOffset);
+            dataOffset += static_cast<uint32_t>((tag.data.size() + 1) & ~size_t(1));
+        }
+    }
+    put32(out, 0);  // No further IFDs
+
+    for (const Tag& tag : tags) {
+        if (tag.data.size() > 4) {
+            out.insert(out.end(), tag.data.begin(), tag.data.end());
+            if (tag.data.size() & 1) {
+                out.push_back(0);
+            }
+        }
+    }
+    out.resize(pixelOffset, 0);
+    out.resize(pixelOffset + pixelBytes);
+
+    uint8_t* pixels = out.data() + pixelOffset;
+    switch (storedBits(file, options)) {
+        case 10: packRows<10>(mosaic, file.width, file.height, pixels); break;
+        case 12: packRows<12>(mosaic, file.width, file.height, pixels); break;
+        case 14: packRows<14>(mosaic, file.width, file.height, pixels); break;
+        default:
+            // 16-bit samples in the file's (and VRAW's) little-endian order
+            memcpy(pixels, mosaic, pixelBytes);
+            break;
+    }
+    return true;
+}
+
+} // namespace vraw
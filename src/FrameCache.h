@@ -0,0 +1,109 @@
+/**
+ * VRAW Library - Byte-budgeted LRU cache
+ *
+ * Backs the decoded and stored frame tiers of VrawReader.
+ * Not part of the public API.
+ */
+
+#ifndef VRAW_FRAME_CACHE_H
+#define VRAW_FRAME_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace vraw {
+namespace detail {
+
+template <typename Value>
+class LruCache {
+public:
+    explicit LruCache(uint64_t budget = 0)
+        : budget_(budget),
+          bytes_(0) {
+    }
+
+    /**
+     * Change the byte budget, evicting least recently used entries as needed.
+     */
+    void setBudget(uint64_t budget) {
+        budget_ = budget;
+        evict(0);
+    }
+
+    uint64_t budget() const { return budget_; }
+    uint64_t bytes() const { return bytes_; }
+    size_t size() const { return map_.size(); }
+
+    /**
+     * Look up an entry and mark it most recently used.
+     *
+     * @return nullptr on a miss
+     */
+    const Value* find(uint64_t key) {
+        auto it = map_.find(key);
+        if (it == map_.end()) {
+            return nullptr;
+        }
+        order_.splice(order_.begin(), order_, it->second);
+        return &it->second->value;
+    }
+
+    /**
+     * Insert or replace an entry. Entries larger than the whole budget are
+     * not cached.
+     */
+    void insert(uint64_t key, Value value, uint64_t bytes) {
+        erase(key);
+        if (bytes > budget_) {
+            return;
+        }
+        evict(bytes);
+        order_.push_front(Node{key, std::move(value), bytes});
+        map_[key] = order_.begin();
+        bytes_ += bytes;
+    }
+
+    void erase(uint64_t key) {
+        auto it = map_.find(key);
+        if (it == map_.end()) {
+            return;
+        }
+        bytes_ -= it->second->bytes;
+        order_.erase(it->second);
+        map_.erase(it);
+    }
+
+    void clear() {
+        order_.clear();
+        map_.clear();
+        bytes_ = 0;
+    }
+
+private:
+    struct Node {
+        uint64_t key;
+        Value value;
+        uint64_t bytes;
+    };
+
+    // Make room for `incoming` bytes
+    void evict(uint64_t incoming) {
+        while (!order_.empty() && bytes_ + incoming > budget_) {
+            bytes_ -= order_.back().bytes;
+            map_.erase(order_.back().key);
+            order_.pop_back();
+        }
+    }
+
+    std::list<Node> order_;  // Most recently used first
+    std::unordered_map<uint64_t, typename std::list<Node>::iterator> map_;
+    uint64_t budget_;
+    uint64_t bytes_;
+};
+
+} // namespace detail
+} // namespace vraw
+
+#endif // VRAW_FRAME_CACHE_H
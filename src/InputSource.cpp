@@ -0,0 +1,379 @@
+/**
+ * VRAW Library - Input Sources Implementation
+ */
+
+#include "InputSource.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// preadv: glibc/musl on Linux, bionic from API 24
+#if defined(__linux__) && (!defined(__ANDROID__) || __ANDROID_API__ >= 24)
+#define VRAW_HAVE_PREADV 1
+#endif
+
+namespace vraw {
+
+static void closeFd(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+static bool fileSize(int fd, uint64_t& size) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_fstat64(fd, &st) != 0) {
+        return false;
+    }
+#else
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+#endif
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+static int openReadOnly(const std::string& path) {
+#ifdef _WIN32
+    return _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// FileSource
+
+FileSource::FileSource()
+    : fd_(-1),
+      ownsFd_(false),
+      size_(0) {
+}
+
+FileSource::~FileSource() {
+    close();
+}
+
+bool FileSource::open(const std::string& path) {
+    return openFd(openReadOnly(path), true);
+}
+
+bool FileSource::openFd(int fd, bool takeOwnership) {
+    close();
+    if (fd < 0) {
+        return false;
+    }
+    if (!fileSize(fd, size_)) {
+        if (takeOwnership) {
+            closeFd(fd);
+        }
+        return false;
+    }
+    fd_ = fd;
+    ownsFd_ = takeOwnership;
+    return true;
+}
+
+void FileSource::close() {
+    if (fd_ >= 0 && ownsFd_) {
+        closeFd(fd_);
+    }
+    fd_ = -1;
+    ownsFd_ = false;
+    size_ = 0;
+}
+
+bool FileSource::readAt(uint64_t offset, void* dst, size_t size) {
+    if (fd_ < 0 || offset > size_ || size > size_ - offset) {
+        return false;
+    }
+    uint8_t* p = static_cast<uint8_t*>(dst);
+#ifdef _WIN32
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (_lseeki64(fd_, static_cast<int64_t>(offset), SEEK_SET) < 0) {
+        return false;
+    }
+    while (size > 0) {
+        int n = _read(fd_, p, static_cast<unsigned>(size));
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+#else
+    while (size > 0) {
+        ssize_t n = ::pread(fd_, p, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        offset += static_cast<uint64_t>(n);
+        size -= static_cast<size_t>(n);
+    }
+#endif
+    return true;
+}
+
+bool FileSource::readAtv(uint64_t offset, const ReadSlice* slices, size_t count) {
+#ifdef VRAW_HAVE_PREADV
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += slices[i].size;
+    }
+    if (fd_ < 0 || offset > size_ || total > size_ - offset) {
+        return false;
+    }
+    struct iovec iov[8];
+    size_t first = 0;
+    while (first < count) {
+        // Build the remaining vector (short reads resume mid-slice)
+        size_t n = 0;
+        for (size_t i = first; i < count && n < 8; ++i, ++n) {
+            iov[n].iov_base = slices[i].data;
+            iov[n].iov_len = slices[i].size;
+        }
+        ssize_t got;
+        do {
+            got = ::preadv(fd_, iov, static_cast<int>(n), static_cast<off_t>(offset));
+        } while (got < 0 && errno == EINTR);
+        if (got <= 0) {
+            return total == 0;
+        }
+        offset += static_cast<uint64_t>(got);
+        total -= static_cast<uint64_t>(got);
+        size_t skip = static_cast<size_t>(got);
+        // Finish a partially filled slice with plain reads
+        while (first < count && skip >= slices[first].size) {
+            skip -= slices[first].size;
+            ++first;
+        }
+        if (first < count && skip > 0) {
+            const size_t rest = slices[first].size - skip;
+            if (!readAt(offset, static_cast<uint8_t*>(slices[first].data) + skip, rest)) {
+                return false;
+            }
+            offset += rest;
+            total -= rest;
+            ++first;
+        }
+    }
+    return true;
+#else
+    return InputSource::readAtv(offset, slices, count);
+#endif
+}
+
+void FileSource::adviseAccess(AccessHint hint) {
+#if defined(__linux__)
+    if (fd_ < 0) {
+        return;
+    }
+    int advice = POSIX_FADV_NORMAL;
+    if (hint == AccessHint::SEQUENTIAL) {
+        advice = POSIX_FADV_SEQUENTIAL;
+    } else if (hint == AccessHint::RANDOM) {
+        advice = POSIX_FADV_RANDOM;
+    }
+    posix_fadvise(fd_, 0, 0, advice);
+#else
+    (void)hint;
+#endif
+}
+
+void FileSource::willNeed(uint64_t offset, uint64_t size) {
+#if defined(__linux__)
+    if (fd_ >= 0) {
+        posix_fadvise(fd_, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+    }
+#else
+    (void)offset;
+    (void)size;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// MmapSource
+
+MmapSource::MmapSource()
+    : data_(nullptr),
+      size_(0),
+      fd_(-1),
+      ownsFd_(false),
+      open_(false) {
+}
+
+MmapSource::~MmapSource() {
+    close();
+}
+
+bool MmapSource::open(const std::string& path) {
+    return openFd(openReadOnly(path), true);
+}
+
+bool MmapSource::openFd(int fd, bool takeOwnership) {
+    close();
+    if (fd < 0) {
+        return false;
+    }
+#ifdef _WIN32
+    if (takeOwnership) {
+        closeFd(fd);
+    }
+    return false;
+#else
+    uint64_t size = 0;
+    if (!fileSize(fd, size)) {
+        if (takeOwnership) {
+            closeFd(fd);
+        }
+        return false;
+    }
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            if (takeOwnership) {
+                closeFd(fd);
+            }
+            return false;
+        }
+        data_ = static_cast<const uint8_t*>(mapped);
+    }
+    size_ = size;
+    fd_ = fd;
+    ownsFd_ = takeOwnership;
+    open_ = true;
+    return true;
+#endif
+}
+
+void MmapSource::close() {
+#ifndef _WIN32
+    if (data_) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+    if (fd_ >= 0 && ownsFd_) {
+        closeFd(fd_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    fd_ = -1;
+    ownsFd_ = false;
+    open_ = false;
+}
+
+bool MmapSource::readAt(uint64_t offset, void* dst, size_t size) {
+    const uint8_t* src = map(offset, size);
+    if (!src) {
+        return size == 0 && open_ && offset <= size_;
+    }
+    memcpy(dst, src, size);
+    return true;
+}
+
+const uint8_t* MmapSource::map(uint64_t offset, size_t size) {
+    if (!data_ || offset > size_ || size > size_ - offset) {
+        return nullptr;
+    }
+    return data_ + offset;
+}
+
+void MmapSource::adviseAccess(AccessHint hint) {
+#ifndef _WIN32
+    if (!data_) {
+        return;
+    }
+    int advice = MADV_NORMAL;
+    if (hint == AccessHint::SEQUENTIAL) {
+        advice = MADV_SEQUENTIAL;
+    } else if (hint == AccessHint::RANDOM) {
+        advice = MADV_RANDOM;
+    }
+    madvise(const_cast<uint8_t*>(data_), size_, advice);
+#else
+    (void)hint;
+#endif
+}
+
+void MmapSource::willNeed(uint64_t offset, uint64_t size) {
+#ifndef _WIN32
+    if (!data_ || offset >= size_) {
+        return;
+    }
+    // madvise needs a page-aligned start
+    const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t start = offset & ~(page - 1);
+    const uint64_t end = std::min(offset + size, size_);
+    madvise(const_cast<uint8_t*>(data_) + start, end - start, MADV_WILLNEED);
+#else
+    (void)offset;
+    (void)size;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// MemorySource
+
+MemorySource::MemorySource(const void* data, size_t size)
+    : data_(static_cast<const uint8_t*>(data)),
+      size_(data ? size : 0) {
+}
+
+MemorySource::MemorySource(std::vector<uint8_t> data)
+    : owned_(std::move(data)),
+      data_(owned_.data()),
+      size_(owned_.size()) {
+}
+
+bool MemorySource::readAt(uint64_t offset, void* dst, size_t size) {
+    if (offset > size_ || size > size_ - offset) {
+        return false;
+    }
+    if (size > 0) {
+        memcpy(dst, data_ + offset, size);
+    }
+    return true;
+}
+
+const uint8_t* MemorySource::map(uint64_t offset, size_t size) {
+    if (!data_ || offset > size_ || size > size_ - offset) {
+        return nullptr;
+    }
+    return data_ + offset;
+}
+
+// ---------------------------------------------------------------------------
+// CallbackSource
+
+CallbackSource::CallbackSource(ReadFn read, uint64_t size)
+    : read_(std::move(read)),
+      size_(size) {
+}
+
+bool CallbackSource::readAt(uint64_t offset, void* dst, size_t size) {
+    if (!read_ || offset > size_ || size > size_ - offset) {
+        return false;
+    }
+    return size == 0 || read_(offset, dst, size);
+}
+
+} // namespace vraw
@@ -0,0 +1,276 @@
+/**
+ * VRAW Library - Minimal io_uring reader implementation
+ */
+
+#include "IoUring.h"
+
+#if defined(__linux__) && !defined(__ANDROID__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define VRAW_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace vraw {
+namespace detail {
+
+IoUring::IoUring()
+    : ringFd_(-1),
+      entries_(0),
+      queued_(0),
+      sqRing_(nullptr),
+      sqRingSize_(0),
+      cqRing_(nullptr),
+      cqRingSize_(0),
+      sqes_(nullptr),
+      sqesSize_(0),
+      sqHead_(nullptr),
+      sqTail_(nullptr),
+      sqMask_(nullptr),
+      sqArray_(nullptr),
+      cqHead_(nullptr),
+      cqTail_(nullptr),
+      cqMask_(nullptr),
+      cqes_(nullptr) {
+}
+
+IoUring::~IoUring() {
+    close();
+}
+
+#ifdef VRAW_HAVE_IO_URING
+
+bool IoUring::init(unsigned entries) {
+    close();
+    if (entries == 0) {
+        return false;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+        return false;
+    }
+    ringFd_ = fd;
+    entries_ = params.sq_entries;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) {
+        sqRingSize_ = cqRingSize_ = (sqRingSize_ > cqRingSize_) ? sqRingSize_ : cqRingSize_;
+    }
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   fd, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        sqRing_ = nullptr;
+        close();
+        return false;
+    }
+    if (singleMap) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            cqRing_ = nullptr;
+            close();
+            return false;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 fd, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        close();
+        return false;
+    }
+
+    uint8_t* sq = static_cast<uint8_t*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    uint8_t* cq = static_cast<uint8_t*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+    return true;
+}
+
+bool IoUring::queueRead(int fd, uint64_t offset, void* dst, uint32_t size, uint64_t userData) {
+    if (ringFd_ < 0) {
+        return false;
+    }
+    const unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    const unsigned tail = *sqTail_ + queued_;
+    if (tail - head >= entries_) {
+        return false;
+    }
+    const unsigned index = tail & *sqMask_;
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqes_) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = reinterpret_cast<uint64_t>(dst);
+    sqe->len = size;
+    sqe->user_data = userData;
+    sqArray_[index] = index;
+    queued_++;
+    return true;
+}
+
+bool IoUring::submit(unsigned waitFor) {
+    if (ringFd_ < 0) {
+        return false;
+    }
+    // Publish queued entries before the kernel sees the new tail
+    const unsigned toSubmit = queued_;
+    if (toSubmit > 0) {
+        __atomic_store_n(sqTail_, *sqTail_ + toSubmit, __ATOMIC_RELEASE);
+        queued_ = 0;
+    }
+    unsigned submitted = 0;
+    while (submitted < toSubmit || waitFor > 0) {
+        const unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+        long ret = syscall(__NR_io_uring_enter, ringFd_, toSubmit - submitted, waitFor, flags,
+                           nullptr, 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        submitted += static_cast<unsigned>(ret);
+        waitFor = 0;
+        if (ret == 0 && submitted < toSubmit) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IoUring::popCompletion(uint64_t& userData, int32_t& result) {
+    if (ringFd_ < 0) {
+        return false;
+    }
+    const unsigned head = *cqHead_;
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    const struct io_uring_cqe* cqe =
+        static_cast<const struct io_uring_cqe*>(cqes_) + (head & *cqMask_);
+    userData = cqe->user_data;
+    result = cqe->res;
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+unsigned IoUring::withdrawUnsubmitted(std::vector<uint64_t>& userData) {
+    if (ringFd_ < 0) {
+        return 0;
+    }
+    // Without SQPOLL the kernel only consumes entries inside io_uring_enter,
+    // so everything between its head and our tail is still ours
+    const unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    const unsigned tail = *sqTail_ + queued_;
+    for (unsigned pos = head; pos != tail; ++pos) {
+        const struct io_uring_sqe* sqe =
+            static_cast<const struct io_uring_sqe*>(sqes_) + sqArray_[pos & *sqMask_];
+        userData.push_back(sqe->user_data);
+    }
+    __atomic_store_n(sqTail_, head, __ATOMIC_RELEASE);
+    queued_ = 0;
+    return tail - head;
+}
+
+bool IoUring::waitCompletion() {
+    if (ringFd_ < 0) {
+        return false;
+    }
+    for (;;) {
+        long ret = syscall(__NR_io_uring_enter, ringFd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret >= 0) {
+            return true;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return false;
+        }
+    }
+}
+
+void IoUring::close() {
+    if (sqes_) {
+        munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ && cqRing_ != sqRing_) {
+        munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_) {
+        munmap(sqRing_, sqRingSize_);
+    }
+    if (ringFd_ >= 0) {
+        ::close(ringFd_);
+    }
+    ringFd_ = -1;
+    entries_ = 0;
+    queued_ = 0;
+    sqRing_ = cqRing_ = sqes_ = nullptr;
+    sqRingSize_ = cqRingSize_ = sqesSize_ = 0;
+}
+
+#else // !VRAW_HAVE_IO_URING
+
+bool IoUring::init(unsigned entries) {
+    (void)entries;
+    return false;
+}
+
+bool IoUring::queueRead(int fd, uint64_t offset, void* dst, uint32_t size, uint64_t userData) {
+    (void)fd;
+    (void)offset;
+    (void)dst;
+    (void)size;
+    (void)userData;
+    return false;
+}
+
+bool IoUring::submit(unsigned waitFor) {
+    (void)waitFor;
+    return false;
+}
+
+bool IoUring::popCompletion(uint64_t& userData, int32_t& result) {
+    (void)userData;
+    (void)result;
+    return false;
+}
+
+unsigned IoUring::withdrawUnsubmitted(std::vector<uint64_t>& userData) {
+    (void)userData;
+    return 0;
+}
+
+bool IoUring::waitCompletion() {
+    return false;
+}
+
+void IoUring::close() {
+}
+
+#endif // VRAW_HAVE_IO_URING
+
+} // namespace detail
+} // namespace vraw
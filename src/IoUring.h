@@ -0,0 +1,112 @@
+/**
+ * VRAW Library - Minimal io_uring reader
+ *
+ * Thin wrapper over the raw io_uring syscalls (no liburing dependency),
+ * used by VrawReader::readFrames() to keep many reads in flight.
+ * Not part of the public API.
+ */
+
+#ifndef VRAW_IO_URING_H
+#define VRAW_IO_URING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vraw {
+namespace detail {
+
+class IoUring {
+public:
+    IoUring();
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /**
+     * Set up a ring with room for `entries` reads in flight.
+     *
+     * @return false when io_uring is unavailable (old kernel, non-Linux,
+     *         blocked by seccomp); callers fall back to pread
+     */
+    bool init(unsigned entries);
+
+    bool isReady() const { return ringFd_ >= 0; }
+
+    /**
+     * Number of reads that can be in flight at once.
+     */
+    unsigned capacity() const { return entries_; }
+
+    /**
+     * Queue a read of `size` bytes at `offset` into dst. Call submit() to
+     * hand queued reads to the kernel.
+     *
+     * @return false if the submission queue is full
+     */
+    bool queueRead(int fd, uint64_t offset, void* dst, uint32_t size, uint64_t userData);
+
+    /**
+     * Submit queued reads and wait for at least `waitFor` completions.
+     */
+    bool submit(unsigned waitFor);
+
+    /**
+     * Pop one completion if available.
+     *
+     * @param result Bytes read, or -errno
+     */
+    bool popCompletion(uint64_t& userData, int32_t& result);
+
+    /**
+     * Withdraw reads that are queued, or were published by a failed
+     * submit(), but were never consumed by the kernel. They will not
+     * complete; their user data is appended to `userData`.
+     *
+     * @return Number of reads withdrawn
+     */
+    unsigned withdrawUnsubmitted(std::vector<uint64_t>& userData);
+
+    /**
+     * Block until at least one completion is available.
+     *
+     * @return false if waiting failed
+     */
+    bool waitCompletion();
+
+    /**
+     * Unmap and close the ring. Teardown is asynchronous: reads the kernel
+     * already accepted may still write into their buffers afterwards, so
+     * pop their completions before closing or freeing the buffers.
+     */
+    void close();
+
+private:
+    int ringFd_;
+    unsigned entries_;
+    unsigned queued_;
+
+    // Mapped ring memory
+    void* sqRing_;
+    size_t sqRingSize_;
+    void* cqRing_;
+    size_t cqRingSize_;
+    void* sqes_;
+    size_t sqesSize_;
+
+    // Pointers into the rings
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqArray_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    void* cqes_;
+};
+
+} // namespace detail
+} // namespace vraw
+
+#endif // VRAW_IO_URING_H
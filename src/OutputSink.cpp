@@ -0,0 +1,325 @@
+/**
+ * VRAW Library - Output Sinks Implementation
+ */
+
+#include "OutputSink.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vraw {
+
+// 64-bit seeks for large file support (>2GB)
+#ifdef _WIN32
+static int seekFile(FILE* stream, uint64_t offset, int origin) {
+    return _fseeki64(stream, static_cast<int64_t>(offset), origin);
+}
+#else
+static int seekFile(FILE* stream, uint64_t offset, int origin) {
+    return fseeko(stream, static_cast<off_t>(offset), origin);
+}
+#endif
+
+// Flush file data (not metadata) to the device
+static bool dataSyncFd(int fd) {
+    if (fd < 0) {
+        return false;
+    }
+#if defined(_WIN32)
+    return _commit(fd) == 0;
+#elif defined(__linux__)
+    return fdatasync(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
+// Range writeback (sync_file_range where available, else a full data sync)
+static bool syncFdRange(int fd, uint64_t offset, uint64_t size, bool wait) {
+    if (fd < 0) {
+        return false;
+    }
+#if defined(__linux__)
+    unsigned int flags = SYNC_FILE_RANGE_WRITE;
+    if (wait) {
+        flags |= SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WAIT_AFTER;
+    }
+    return sync_file_range(fd, static_cast<off64_t>(offset), static_cast<off64_t>(size), flags) == 0;
+#else
+    (void)offset;
+    (void)size;
+    return !wait || dataSyncFd(fd);
+#endif
+}
+
+// Drop clean cached pages of a range (no-op where fadvise is unavailable)
+static bool dropFdCache(int fd, uint64_t offset, uint64_t size) {
+    if (fd < 0) {
+        return false;
+    }
+#if defined(__linux__)
+    return posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size),
+                         POSIX_FADV_DONTNEED) == 0;
+#else
+    (void)offset;
+    (void)size;
+    return true;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// FileSink
+
+FileSink::FileSink()
+    : file_(nullptr),
+      size_(0) {
+}
+
+FileSink::~FileSink() {
+    close();
+}
+
+bool FileSink::open(const std::string& path) {
+    close();
+    file_ = fopen(path.c_str(), "wb");
+    size_ = 0;
+    return file_ != nullptr;
+}
+
+bool FileSink::openFd(int fd) {
+    close();
+    if (fd < 0) {
+        return false;
+    }
+    file_ = fdopen(fd, "wb");
+    size_ = 0;
+    return file_ != nullptr;
+}
+
+void FileSink::close() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool FileSink::append(const void* data, size_t size) {
+    if (!file_) {
+        return false;
+    }
+    if (size > 0 && fwrite(data, 1, size, file_) != size) {
+        return false;
+    }
+    size_ += size;
+    return true;
+}
+
+bool FileSink::writeAt(uint64_t offset, const void* data, size_t size) {
+    if (!file_ || offset + size > size_) {
+        return false;
+    }
+    if (seekFile(file_, offset, SEEK_SET) != 0) {
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, file_) == size;
+    // Return to the append position
+    if (seekFile(file_, 0, SEEK_END) != 0) {
+        return false;
+    }
+    return ok;
+}
+
+bool FileSink::flush() {
+    return file_ && fflush(file_) == 0;
+}
+
+bool FileSink::sync() {
+    if (!flush()) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file_)) == 0;
+#else
+    return fsync(fileno(file_)) == 0;
+#endif
+}
+
+bool FileSink::syncRange(uint64_t offset, uint64_t size, bool wait) {
+    return syncFdRange(nativeHandle(), offset, size, wait);
+}
+
+bool FileSink::dataSync() {
+    return dataSyncFd(nativeHandle());
+}
+
+bool FileSink::dropCache(uint64_t offset, uint64_t size) {
+    return dropFdCache(nativeHandle(), offset, size);
+}
+
+int FileSink::nativeHandle() const {
+#ifdef _WIN32
+    return file_ ? _fileno(file_) : -1;
+#else
+    return file_ ? fileno(file_) : -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// FdSink
+
+FdSink::FdSink(int fd, bool takeOwnership)
+    : fd_(fd),
+      ownsFd_(takeOwnership),
+      size_(0) {
+}
+
+FdSink::~FdSink() {
+    if (ownsFd_ && fd_ >= 0) {
+#ifdef _WIN32
+        _close(fd_);
+#else
+        ::close(fd_);
+#endif
+    }
+}
+
+bool FdSink::append(const void* data, size_t size) {
+    if (fd_ < 0) {
+        return false;
+    }
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t remaining = size;
+    while (remaining > 0) {
+#ifdef _WIN32
+        int n = _write(fd_, p, static_cast<unsigned>(remaining));
+#else
+        ssize_t n = ::write(fd_, p, remaining);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        remaining -= static_cast<size_t>(n);
+    }
+    size_ += size;
+    return true;
+}
+
+bool FdSink::writeAt(uint64_t offset, const void* data, size_t size) {
+    if (fd_ < 0 || offset + size > size_) {
+        return false;
+    }
+#ifdef _WIN32
+    // No pwrite: seek, write, seek back to the append position
+    if (_lseeki64(fd_, static_cast<int64_t>(offset), SEEK_SET) < 0) {
+        return false;
+    }
+    bool ok = _write(fd_, data, static_cast<unsigned>(size)) == static_cast<int>(size);
+    _lseeki64(fd_, static_cast<int64_t>(size_), SEEK_SET);
+    return ok;
+#else
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t remaining = size;
+    while (remaining > 0) {
+        ssize_t n = ::pwrite(fd_, p, remaining, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        offset += static_cast<uint64_t>(n);
+        remaining -= static_cast<size_t>(n);
+    }
+    return true;
+#endif
+}
+
+bool FdSink::sync() {
+#ifdef _WIN32
+    return fd_ >= 0 && _commit(fd_) == 0;
+#else
+    return fd_ >= 0 && fsync(fd_) == 0;
+#endif
+}
+
+bool FdSink::syncRange(uint64_t offset, uint64_t size, bool wait) {
+    return syncFdRange(fd_, offset, size, wait);
+}
+
+bool FdSink::dataSync() {
+    return dataSyncFd(fd_);
+}
+
+bool FdSink::dropCache(uint64_t offset, uint64_t size) {
+    return dropFdCache(fd_, offset, size);
+}
+
+// ---------------------------------------------------------------------------
+// MemorySink
+
+bool MemorySink::append(const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    data_.insert(data_.end(), p, p + size);
+    return true;
+}
+
+bool MemorySink::writeAt(uint64_t offset, const void* data, size_t size) {
+    if (offset + size > data_.size()) {
+        return false;
+    }
+    memcpy(data_.data() + offset, data, size);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// CallbackSink
+
+CallbackSink::CallbackSink(WriteFn write, SyncFn sync, SyncFn flush)
+    : write_(std::move(write)),
+      sync_(std::move(sync)),
+      flush_(std::move(flush)),
+      size_(0) {
+}
+
+bool CallbackSink::append(const void* data, size_t size) {
+    if (!write_ || !write_(size_, data, size)) {
+        return false;
+    }
+    size_ += size;
+    return true;
+}
+
+bool CallbackSink::writeAt(uint64_t offset, const void* data, size_t size) {
+    if (!write_ || offset + size > size_) {
+        return false;
+    }
+    return write_(offset, data, size);
+}
+
+bool CallbackSink::flush() {
+    return flush_ ? flush_() : true;
+}
+
+bool CallbackSink::sync() {
+    if (!flush()) {
+        return false;
+    }
+    return sync_ ? sync_() : true;
+}
+
+bool CallbackSink::dataSync() {
+    return sync_ ? sync_() : true;
+}
+
+} // namespace vraw
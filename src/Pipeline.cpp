@@ -0,0 +1,166 @@
+/**
+ * VRAW Library - Specialised sample pipeline tables
+ */
+
+#include "Pipeline.h"
+#include "CfaPlanes.h"
+#include "Encoding.h"
+#include <algorithm>
+#include <cstring>
+
+namespace vraw {
+namespace detail {
+
+namespace {
+
+template <int Bits, bool Log, bool Packed, bool Compressed>
+struct EncodeVariant {
+    static void encode(const uint16_t* in, uint16_t* out, uint32_t count, const uint16_t* logTable) {
+        for (uint32_t i = 0; i < count; ++i) {
+            out[i] = logTable[in[i]];
+        }
+    }
+
+    static uint32_t pack(const uint16_t* src, uint32_t count, uint8_t* dst) {
+        StoredPacker<Bits>::pack(src, count, dst);
+        return StoredPacker<Bits>::packedBytes(count);
+    }
+
+    static uint32_t storedBytes(uint32_t count) {
+        return Packed ? StoredPacker<Bits>::packedBytes(count) : count * 2;
+    }
+
+    static EncodePipeline make() {
+        EncodePipeline pipeline;
+        pipeline.log = Log;
+        pipeline.packed = Packed;
+        pipeline.compressed = Compressed;
+        pipeline.mask = StoredPacker<Bits>::MASK;
+        pipeline.encode = Log ? &encode : nullptr;
+        pipeline.pack = Packed ? &pack : nullptr;
+        pipeline.storedBytes = &storedBytes;
+        return pipeline;
+    }
+};
+
+template <int Bits, bool Packed>
+struct DecodeVariant {
+    // 10- and 12-bit rows have dedicated kernels in CfaPlanes
+    static constexpr auto rowToPairs() {
+        if constexpr (Bits == 10) {
+            return &unpackRow10BitToPairs;
+        } else if constexpr (Bits == 12) {
+            return &unpackRow12BitToPairs;
+        } else {
+            return &StoredPacker<Bits>::unpackToPairs;
+        }
+    }
+
+    static void unpack(const uint8_t* src, uint32_t srcBytes, uint16_t* dst, uint32_t count) {
+        if (Packed) {
+            StoredPacker<Bits>::unpack(src, srcBytes, dst, count);
+        } else {
+            memcpy(dst, src, std::min<size_t>(static_cast<size_t>(count) * 2, srcBytes));
+        }
+    }
+
+    static DecodePipeline make() {
+        DecodePipeline pipeline;
+        pipeline.packed = Packed;
+        pipeline.mask = StoredPacker<Bits>::MASK;
+        pipeline.groupSamples = Packed ? StoredPacker<Bits>::GROUP_SAMPLES : 1;
+        pipeline.groupBytes = Packed ? StoredPacker<Bits>::GROUP_BYTES : 2;
+        pipeline.unpack = &unpack;
+        pipeline.unpackRowToPairs = !Packed ? nullptr : rowToPairs();
+        return pipeline;
+    }
+};
+
+// Index: encoding * 4 + packed * 2 + compressed, with encodings ordered
+// linear 10-bit, linear 12-bit, log 10-bit, log 12-bit, linear 14-bit
+const EncodePipeline ENCODE_PIPELINES[20] = {
+    EncodeVariant<10, false, false, false>::make(),
+    EncodeVariant<10, false, false, true>::make(),
+    EncodeVariant<10, false, true, false>::make(),
+    EncodeVariant<10, false, true, true>::make(),
+    EncodeVariant<12, false, false, false>::make(),
+    EncodeVariant<12, false, false, true>::make(),
+    EncodeVariant<12, false, true, false>::make(),
+    EncodeVariant<12, false, true, true>::make(),
+    EncodeVariant<10, true, false, false>::make(),
+    EncodeVariant<10, true, false, true>::make(),
+    EncodeVariant<10, true, true, false>::make(),
+    EncodeVariant<10, true, true, true>::make(),
+    EncodeVariant<12, true, false, false>::make(),
+    EncodeVariant<12, true, false, true>::make(),
+    EncodeVariant<12, true, true, false>::make(),
+    EncodeVariant<12, true, true, true>::make(),
+    EncodeVariant<14, false, false, false>::make(),
+    EncodeVariant<14, false, false, true>::make(),
+    EncodeVariant<14, false, true, false>::make(),
+    EncodeVariant<14, false, true, true>::make(),
+};
+
+const DecodePipeline DECODE_PIPELINES_10BIT[2] = {
+    DecodeVariant<10, false>::make(),
+    DecodeVariant<10, true>::make(),
+};
+
+const DecodePipeline DECODE_PIPELINES_12BIT[2] = {
+    DecodeVariant<12, false>::make(),
+    DecodeVariant<12, true>::make(),
+};
+
+const DecodePipeline DECODE_PIPELINES_14BIT[2] = {
+    DecodeVariant<14, false>::make(),
+    DecodeVariant<14, true>::make(),
+};
+
+int encodingIndex(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::LINEAR_10BIT: return 0;
+        case Encoding::LINEAR_12BIT: return 1;
+        case Encoding::LOG2_10BIT: return 2;
+        case Encoding::LOG2_12BIT: return 3;
+        case Encoding::LINEAR_14BIT: return 4;
+        default: return 0;  // Reserved encodings are stored as linear 10-bit
+    }
+}
+
+
+} // namespace
+
+const EncodePipeline& selectEncodePipeline(Encoding encoding, bool packed, bool compressed) {
+    return ENCODE_PIPELINES[encodingIndex(encoding) * 4 + (packed ? 2 : 0) + (compressed ? 1 : 0)];
+}
+
+const DecodePipeline* selectDecodePipelines(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::LINEAR_12BIT:
+        case Encoding::LOG2_12BIT:
+            return DECODE_PIPELINES_12BIT;
+        case Encoding::LINEAR_14BIT:
+            return DECODE_PIPELINES_14BIT;
+        default:
+            return DECODE_PIPELINES_10BIT;
+    }
+}
+
+void buildLogTable(Encoding encoding, uint16_t blackLevel, uint16_t whiteLevel,
+                   std::vector<uint16_t>& table) {
+    if (encoding != Encoding::LOG2_10BIT && encoding != Encoding::LOG2_12BIT) {
+        table.clear();
+        return;
+    }
+    // One pass over every input value; afterwards a code is one load
+    table.resize(65536);
+    for (uint32_t value = 0; value < 65536; ++value) {
+        const uint16_t pixel = static_cast<uint16_t>(value);
+        table[value] = (encoding == Encoding::LOG2_12BIT)
+                       ? encodePixelLog12Bit(pixel, blackLevel, whiteLevel)
+                       : encodePixelLog10Bit(pixel, blackLevel, whiteLevel);
+    }
+}
+
+} // namespace detail
+} // namespace vraw
@@ -0,0 +1,85 @@
+/**
+ * VRAW Library - Specialised sample pipelines
+ *
+ * Encode and decode kernels instantiated per stream variant (bit depth,
+ * log/linear, packing, compression) from templates. The writer and reader
+ * resolve their variant once from a dispatch table at init()/open(), so
+ * the per-sample loops carry no format branches and are fully inlined.
+ * Not part of the public API.
+ */
+
+#ifndef VRAW_PIPELINE_H
+#define VRAW_PIPELINE_H
+
+#include "BitPacking.h"
+#include "VrawTypes.h"
+#include <cstdint>
+#include <vector>
+
+namespace vraw {
+namespace detail {
+
+// Stored bit order per sample width: 12-bit is MSB-first, the others
+// (10-bit, 14-bit) LSB-first
+template <int Bits>
+using StoredPacker = BitPacker<Bits, Bits == 12 ? BitOrder::MSB_FIRST : BitOrder::LSB_FIRST>;
+
+/**
+ * Writer-side kernels for one stream variant.
+ */
+struct EncodePipeline {
+    bool log;
+    bool packed;
+    bool compressed;
+    uint16_t mask;  // Sample range of the encoding
+
+    // Log-encode through a table from buildLogTable(); nullptr for linear
+    void (*encode)(const uint16_t* in, uint16_t* out, uint32_t count, const uint16_t* logTable);
+
+    // Bit-pack samples into dst and return the bytes written; nullptr when
+    // 16-bit samples are stored as-is
+    uint32_t (*pack)(const uint16_t* src, uint32_t count, uint8_t* dst);
+
+    // Stored stream bytes (before LZ4) for count samples
+    uint32_t (*storedBytes)(uint32_t count);
+};
+
+/**
+ * Reader-side kernels for one bit depth and packing.
+ */
+struct DecodePipeline {
+    bool packed;
+    uint16_t mask;
+    uint32_t groupSamples;  // Samples per indivisible stored group
+    uint32_t groupBytes;    // Bytes per stored group
+
+    // Stored stream to 16-bit samples
+    void (*unpack)(const uint8_t* src, uint32_t srcBytes, uint16_t* dst, uint32_t count);
+
+    // One packed mosaic row straight into even/odd columns; nullptr when unpacked
+    void (*unpackRowToPairs)(const uint8_t* src, uint16_t* even, uint16_t* odd, uint32_t pairs);
+};
+
+/**
+ * Resolve the writer pipeline for an encoding, packing and compression.
+ */
+const EncodePipeline& selectEncodePipeline(Encoding encoding, bool packed, bool compressed);
+
+/**
+ * Resolve the reader pipelines for an encoding.
+ *
+ * @return Two entries: [0] unpacked 16-bit samples, [1] bit-packed
+ */
+const DecodePipeline* selectDecodePipelines(Encoding encoding);
+
+/**
+ * Fill table with the log code of every 16-bit input value. Empty for
+ * linear encodings.
+ */
+void buildLogTable(Encoding encoding, uint16_t blackLevel, uint16_t whiteLevel,
+                   std::vector<uint16_t>& table);
+
+} // namespace detail
+} // namespace vraw
+
+#endif // VRAW_PIPELINE_H
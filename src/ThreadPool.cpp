@@ -0,0 +1,122 @@
+/**
+ * VRAW Library - Internal worker pool implementation
+ */
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace vraw {
+namespace detail {
+
+unsigned defaultThreadCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 2;
+}
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : active_(0),
+      stopping_(false) {
+    if (threadCount == 0) {
+        threadCount = defaultThreadCount();
+    }
+    workers_.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    taskCv_.notify_all();
+    for (auto& t : workers_) {
+        t.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    taskCv_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idleCv_.wait(lock, [this] { return tasks_.empty() && active_ == 0; });
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    if (count == 1) {
+        fn(0);
+        return;
+    }
+
+    // Shared counter: helpers and the caller pull indices until exhausted.
+    // State is reference-counted because a helper may be dequeued after the
+    // caller has already drained everything and returned.
+    struct State {
+        std::atomic<uint32_t> next{0};
+        std::atomic<uint32_t> done{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    auto state = std::make_shared<State>();
+    const std::function<void(uint32_t)>* body = &fn;
+
+    auto drain = [state, body, count]() {
+        uint32_t finished = 0;
+        for (uint32_t i = state->next.fetch_add(1); i < count; i = state->next.fetch_add(1)) {
+            (*body)(i);
+            ++finished;
+        }
+        if (finished > 0 && state->done.fetch_add(finished) + finished == count) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->cv.notify_all();
+        }
+    };
+
+    const uint32_t helpers = std::min<uint32_t>(size(), count - 1);
+    for (uint32_t i = 0; i < helpers; ++i) {
+        submit(drain);
+    }
+    drain();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&] { return state->done.load() == count; });
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            taskCv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+            ++active_;
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --active_;
+            if (tasks_.empty() && active_ == 0) {
+                idleCv_.notify_all();
+            }
+        }
+    }
+}
+
+} // namespace detail
+} // namespace vraw
@@ -0,0 +1,71 @@
+/**
+ * VRAW Library - Internal worker pool
+ *
+ * Small fixed-size executor shared by the parallel read/decode paths.
+ * Not part of the public API.
+ */
+
+#ifndef VRAW_THREAD_POOL_H
+#define VRAW_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vraw {
+namespace detail {
+
+/**
+ * Number of worker threads to use when the caller passes 0.
+ */
+unsigned defaultThreadCount();
+
+class ThreadPool {
+public:
+    /**
+     * @param threadCount Number of workers (0 = defaultThreadCount())
+     */
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Queue a task. Tasks run in FIFO order on any worker.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * Block until every task submitted so far has finished.
+     */
+    void wait();
+
+    /**
+     * Run fn(i) for i in [0, count) across the workers and wait for completion.
+     * The calling thread participates, so this is safe to call with a pool of 1.
+     */
+    void parallelFor(uint32_t count, const std::function<void(uint32_t)>& fn);
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable taskCv_;
+    std::condition_variable idleCv_;
+    uint32_t active_;
+    bool stopping_;
+};
+
+} // namespace detail
+} // namespace vraw
+
+#endif // VRAW_THREAD_POOL_H
@@ -0,0 +1,176 @@
+/**
+ * VRAW Library - On-disk structures
+ *
+ * Packed file, frame and audio headers shared by the reader and writer
+ * (must match format spec). Not part of the public API.
+ */
+
+#ifndef VRAW_FORMAT_H
+#define VRAW_FORMAT_H
+
+#include <cstdint>
+
+namespace vraw {
+
+#pragma pack(push, 1)
+
+struct SimpleFrameHeader {
+    uint64_t timestamp_us;
+    uint32_t frame_number;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    float iso;
+    float exposure_time_ms;
+    float white_balance_r;
+    float white_balance_g;
+    float white_balance_b;
+    float focal_length;
+    float aperture;
+    float focus_distance;
+    uint16_t dynamic_black_level[4];
+    uint8_t reserved[4];
+};
+
+struct SimpleFileHeader {
+    char magic[4];              // "MRAW"
+    uint32_t version;           // 2
+    uint32_t width;
+    uint32_t height;
+    uint8_t bayer_pattern;
+    uint8_t encoding;
+    uint8_t compression;
+    uint8_t reserved1;
+    uint16_t black_level[4];
+    uint16_t white_level;
+    uint16_t reserved2;
+    uint32_t frame_count;
+    uint64_t index_offset;
+
+    // V2 fields
+    uint32_t native_width;
+    uint32_t native_height;
+    uint32_t binning_num;
+    uint32_t binning_den;
+
+    uint8_t has_audio;
+    uint8_t audio_channels;
+    uint8_t audio_bit_depth;
+    uint8_t reserved3;
+    uint32_t audio_sample_rate;
+    uint64_t audio_offset;
+    uint64_t audio_start_time_us;
+
+    uint8_t has_timecode;
+    uint8_t timecode_format;
+    uint8_t timecode_fps;
+    uint8_t timecode_drop_frame;
+    uint32_t timecode_start_frame;
+    uint8_t timecode_hours;
+    uint8_t timecode_minutes;
+    uint8_t timecode_seconds;
+    uint8_t timecode_frames;
+    uint8_t reserved_tc[4];
+
+    int32_t sensor_orientation;
+
+    // Storage layout (zero in files written before these fields existed)
+    uint8_t storage_layout;     // FrameLayout of stored samples
+    uint8_t storage_flags;      // STORAGE_FLAG_*
+    uint8_t reserved_layout[2];
+
+    // Per-frame statistics table, after the index (0 = none)
+    uint64_t stats_offset;
+
+    // Audio peak table, after the index and stats table (0 = none)
+    uint64_t audio_peaks_offset;
+
+    uint8_t reserved[388];
+};
+
+// Precedes each LZ4 block of a chunked frame (FRAME_FLAG_CHUNKED)
+struct FrameChunkHeader {
+    uint32_t compressed_size;   // Bytes of the LZ4 block that follows
+    uint32_t raw_size;          // Bytes it decompresses to
+};
+
+struct AudioStreamHeader {
+    char magic[4];              // "MAUD"
+    uint32_t version;
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bit_depth;
+    uint64_t sample_count;
+    uint64_t start_timestamp_us;
+    uint8_t reserved[32];
+};
+
+// Per-frame statistics table: this header, then frame_count records
+struct FrameStatsTableHeader {
+    char magic[4];              // "MSTA"
+    uint32_t version;           // 1
+    uint32_t frame_count;
+    uint16_t channels;          // 4 (CFA positions)
+    uint16_t histogram_bins;    // FrameStats::HISTOGRAM_BINS
+    uint32_t record_size;       // Bytes per frame record
+    uint8_t reserved[12];
+};
+
+struct FrameStatsChannelRecord {
+    uint16_t min;
+    uint16_t max;
+    float mean;
+    uint32_t clipped;
+    uint32_t histogram[32];
+};
+
+struct FrameStatsRecord {
+    FrameStatsChannelRecord channels[4];
+};
+
+// Audio peak table: this header, level_count level records, then each
+// level's peak_count * channels peak records (channel-interleaved)
+struct AudioPeakTableHeader {
+    char magic[4];              // "MPKS"
+    uint32_t version;           // 1
+    uint16_t channels;
+    uint16_t level_count;
+    uint32_t reserved0;
+    uint64_t sample_count;      // Samples per channel summarised
+    uint8_t reserved[8];
+};
+
+struct AudioPeakLevelRecord {
+    uint32_t samples_per_peak;
+    uint32_t peak_count;
+    uint64_t data_offset;       // From the start of the table
+};
+
+struct AudioPeakRecord {
+    int16_t min;
+    int16_t max;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(SimpleFrameHeader) == 64, "frame header must be 64 bytes");
+static_assert(sizeof(SimpleFileHeader) == 512, "file header must be 512 bytes");
+static_assert(sizeof(AudioStreamHeader) == 64, "audio header must be 64 bytes");
+static_assert(sizeof(FrameChunkHeader) == 8, "chunk header must be 8 bytes");
+static_assert(sizeof(FrameStatsTableHeader) == 32, "stats table header must be 32 bytes");
+static_assert(sizeof(FrameStatsRecord) == 4 * 140, "stats record must be 560 bytes");
+static_assert(sizeof(AudioPeakTableHeader) == 32, "audio peak table header must be 32 bytes");
+static_assert(sizeof(AudioPeakLevelRecord) == 16, "audio peak level record must be 16 bytes");
+static_assert(sizeof(AudioPeakRecord) == 4, "audio peak record must be 4 bytes");
+
+// storage_flags bits
+static const uint8_t STORAGE_FLAG_BLACK_SUBTRACTED = 0x01;  // Per-plane black level removed (mod bit depth)
+
+// SimpleFrameHeader::reserved[0] bits
+static const uint8_t FRAME_FLAG_CHUNKED = 0x01;  // Payload is FrameChunkHeader + LZ4 block pairs forming one LZ4 stream
+
+// LZ4 stream history carried between chunks
+static const uint32_t LZ4_DICT_BYTES = 64 * 1024;
+
+} // namespace vraw
+
+#endif // VRAW_FORMAT_H
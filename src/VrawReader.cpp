@@ -3,10 +3,23 @@
  */
 
 #include "VrawReader.h"
+#include "CfaPlanes.h"
+#include "FrameCache.h"
+#include "IoUring.h"
+#include "Pipeline.h"
+#include "ThreadPool.h"
+#include "VrawFormat.h"
 #include "lz4.h"
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdio>
+#include <mutex>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 #ifdef __ANDROID__
 #include <android/log.h>
@@ -18,116 +31,98 @@
 #define LOGE(...) do { fprintf(stderr, "[VRAW ERROR] "); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); } while(0)
 #endif
 
-// 64-bit file operations for large file support (>2GB)
-// On Windows, long is 32-bit, so we need _fseeki64/_ftelli64
-#ifdef _WIN32
-#include <io.h>
-inline int fseek64(FILE* stream, int64_t offset, int origin) {
-    return _fseeki64(stream, offset, origin);
-}
-inline int64_t ftell64(FILE* stream) {
-    return _ftelli64(stream);
-}
-#else
-// On Unix/Linux/macOS, use standard functions (off_t is 64-bit with _FILE_OFFSET_BITS=64)
-inline int fseek64(FILE* stream, int64_t offset, int origin) {
-    return fseeko(stream, static_cast<off_t>(offset), origin);
-}
-inline int64_t ftell64(FILE* stream) {
-    return static_cast<int64_t>(ftello(stream));
-}
-#endif
-
 namespace vraw {
 
-// Forward declarations for unpacking functions
-static void unpackFrame10Bit(const uint8_t* src, uint32_t srcBytes, std::vector<uint8_t>& dst, uint32_t pixelCount);
-static void unpackFrame12Bit(const uint8_t* src, uint32_t srcBytes, std::vector<uint8_t>& dst, uint32_t pixelCount);
-
-// Internal file structures
-#pragma pack(push, 1)
-
-struct SimpleFrameHeader {
-    uint64_t timestamp_us;
-    uint32_t frame_number;
-    uint32_t compressed_size;
-    uint32_t uncompressed_size;
-    float iso;
-    float exposure_time_ms;
-    float white_balance_r;
-    float white_balance_g;
-    float white_balance_b;
-    float focal_length;
-    float aperture;
-    float focus_distance;
-    uint16_t dynamic_black_level[4];
-    uint8_t reserved[4];
-};
+static const int FILE_HEADER_SIZE = 512;
+static const int FRAME_HEADER_SIZE = 64;
+
+// Access pattern detection (AccessHint::AUTO)
+static const uint32_t SEQUENTIAL_RUN = 4;   // Consecutive frames before SEQUENTIAL
+static const uint32_t RANDOM_RUN = 4;       // Jumps in a row before RANDOM
+static const uint32_t READAHEAD_FRAMES = 8; // Frames requested ahead with WILLNEED
+
+// loadIntoMemory()
+static const uint64_t LOAD_CHUNK_SIZE = 16 * 1024 * 1024;  // Bytes per parallel read
+static const uint64_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+namespace {
+
+// Backing store of a loaded clip: anonymous mapping (huge pages where the
+// kernel supports them), or the heap as a fallback
+struct ResidentBuffer {
+    uint8_t* data = nullptr;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    std::vector<uint8_t> heap;
+
+    bool allocate(uint64_t size) {
+#ifndef _WIN32
+        // Over-allocate so the buffer can start on a huge-page boundary
+        mappingSize = static_cast<size_t>(size + HUGE_PAGE_SIZE);
+        mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping != MAP_FAILED) {
+            uintptr_t start = (reinterpret_cast<uintptr_t>(mapping) + HUGE_PAGE_SIZE - 1) &
+                              ~static_cast<uintptr_t>(HUGE_PAGE_SIZE - 1);
+            data = reinterpret_cast<uint8_t*>(start);
+#ifdef MADV_HUGEPAGE
+            madvise(data, static_cast<size_t>(size), MADV_HUGEPAGE);
+#endif
+            return true;
+        }
+        mapping = nullptr;
+        mappingSize = 0;
+#endif
+        heap.resize(static_cast<size_t>(size));
+        data = heap.data();
+        return true;
+    }
 
-struct SimpleFileHeader {
-    char magic[4];
-    uint32_t version;
-    uint32_t width;
-    uint32_t height;
-    uint8_t bayer_pattern;
-    uint8_t encoding;
-    uint8_t compression;
-    uint8_t reserved1;
-    uint16_t black_level[4];
-    uint16_t white_level;
-    uint16_t reserved2;
-    uint32_t frame_count;
-    uint64_t index_offset;
-
-    uint32_t native_width;
-    uint32_t native_height;
-    uint32_t binning_num;
-    uint32_t binning_den;
-
-    uint8_t has_audio;
-    uint8_t audio_channels;
-    uint8_t audio_bit_depth;
-    uint8_t reserved3;
-    uint32_t audio_sample_rate;
-    uint64_t audio_offset;
-    uint64_t audio_start_time_us;
-
-    uint8_t has_timecode;
-    uint8_t timecode_format;
-    uint8_t timecode_fps;
-    uint8_t timecode_drop_frame;
-    uint32_t timecode_start_frame;
-    uint8_t timecode_hours;
-    uint8_t timecode_minutes;
-    uint8_t timecode_seconds;
-    uint8_t timecode_frames;
-    uint8_t reserved_tc[4];
-
-    int32_t sensor_orientation;
-    uint8_t reserved[408];
+    ~ResidentBuffer() {
+#ifndef _WIN32
+        if (mapping) {
+            munmap(mapping, mappingSize);
+        }
+#endif
+    }
 };
 
-struct AudioStreamHeaderRaw {
-    char magic[4];
-    uint32_t version;
-    uint32_t sample_rate;
-    uint16_t channels;
-    uint16_t bit_depth;
-    uint64_t sample_count;
-    uint64_t start_timestamp_us;
-    uint8_t reserved[32];
+// MemorySource that owns a ResidentBuffer
+class ResidentSource : public MemorySource {
+public:
+    ResidentSource(std::unique_ptr<ResidentBuffer> buffer, uint64_t size)
+        : MemorySource(buffer->data, static_cast<size_t>(size)),
+          buffer_(std::move(buffer)) {
+    }
+
+private:
+    std::unique_ptr<ResidentBuffer> buffer_;
 };
 
-#pragma pack(pop)
+} // namespace
 
-static const int FILE_HEADER_SIZE = 512;
-static const int FRAME_HEADER_SIZE = 64;
+struct VrawReader::FrameCaches {
+    struct Decoded {
+        FrameHeader header;
+        std::vector<uint16_t> pixels;
+    };
+    detail::LruCache<Decoded> decoded;            // Key: frame number and output layout
+    detail::LruCache<std::vector<uint8_t>> stored;  // Key: frame number; frame header + payload
+};
 
 VrawReader::VrawReader()
-    : file_(nullptr),
+    : statsCount_(0),
+      peakChannels_(0),
+      caches_(new FrameCaches()),
+      outputLayout_(FrameLayout::MOSAIC),
       isPacked_(false),
-      usingFd_(false),
-      fd_(-1) {
+      pipelines_(detail::selectDecodePipelines(Encoding::LINEAR_12BIT)),
+      loadedIntoMemory_(false),
+      accessHint_(AccessHint::AUTO),
+      lastFrameRead_(0),
+      hasLastFrame_(false),
+      sequentialRun_(0),
+      randomRun_(0),
+      willNeedUpTo_(0) {
     memset(&fileHeader_, 0, sizeof(fileHeader_));
 }
 
@@ -136,22 +131,53 @@ VrawReader::~VrawReader() {
 }
 
 bool VrawReader::open(const std::string& path) {
-    if (file_) {
-        close();
-    }
+    close();
 
-    file_ = fopen(path.c_str(), "rb");
-    if (!file_) {
+    std::unique_ptr<FileSource> file(new FileSource());
+    if (!file->open(path)) {
         LOGE("Failed to open file: %s", path.c_str());
         return false;
     }
+    return openWithSource(std::move(file), path);
+}
+
+bool VrawReader::openWithFd(int fd, const std::string& displayPath) {
+    close();
+
+    if (fd < 0) {
+        LOGE("Invalid file descriptor: %d", fd);
+        return false;
+    }
+
+    std::unique_ptr<FileSource> file(new FileSource());
+    if (!file->openFd(fd)) {
+        LOGE("Failed to read descriptor: %d", fd);
+        return false;
+    }
+    return openWithSource(std::move(file), displayPath);
+}
 
-    filePath_ = path;
-    usingFd_ = false;
-    fd_ = -1;
+bool VrawReader::openWithSource(std::unique_ptr<InputSource> source, const std::string& displayName) {
+    close();
+
+    if (!source) {
+        LOGE("Invalid input source");
+        return false;
+    }
+
+    source_ = std::move(source);
+    filePath_ = displayName;
+    stats_ = Stats();
+    hasLastFrame_ = false;
+    sequentialRun_ = 0;
+    randomRun_ = 0;
+    willNeedUpTo_ = 0;
+    if (accessHint_ != AccessHint::AUTO) {
+        applyAccessHint(accessHint_);
+    }
 
     if (!readFileHeader()) {
-        LOGE("Failed to read file header: %s", path.c_str());
+        LOGE("Failed to read file header: %s", displayName.c_str());
         close();
         return false;
     }
@@ -159,7 +185,7 @@ bool VrawReader::open(const std::string& path) {
     if (!readIndexTable()) {
         // Try building sequential index
         if (!buildSequentialIndex()) {
-            LOGE("Failed to build frame index: %s", path.c_str());
+            LOGE("Failed to build frame index: %s", displayName.c_str());
             close();
             return false;
         }
@@ -167,81 +193,198 @@ bool VrawReader::open(const std::string& path) {
 
     if (!validateIndex()) {
         if (!buildSequentialIndex()) {
-            LOGE("Failed to validate frame index: %s", path.c_str());
+            LOGE("Failed to validate frame index: %s", displayName.c_str());
             close();
             return false;
         }
     }
+    computeFrameSizes();
+    readStatsTableHeader();
+    readAudioPeakTableHeader();
 
-    LOGI("Opened: %s (%ux%u, %u frames)", path.c_str(),
+    LOGI("Opened: %s (%ux%u, %u frames)", displayName.c_str(),
          fileHeader_.width, fileHeader_.height, fileHeader_.frameCount);
     return true;
 }
 
-bool VrawReader::openWithFd(int fd, const std::string& displayPath) {
-    if (file_) {
-        close();
-    }
+void VrawReader::close() {
+    source_.reset();
+    loadedIntoMemory_ = false;
+    clearCache();
+    frameIndex_.clear();
+    frameSizes_.clear();
+    statsCount_ = 0;
+    peakLevels_.clear();
+    peakChannels_ = 0;
+    filePath_.clear();
+}
 
-    if (fd < 0) {
-        LOGE("Invalid file descriptor: %d", fd);
+bool VrawReader::loadIntoMemory(uint64_t budgetBytes, const LoadProgress& progress) {
+    if (!source_) {
         return false;
     }
+    if (loadedIntoMemory_) {
+        return true;
+    }
 
-    file_ = fdopen(fd, "rb");
-    if (!file_) {
-        LOGE("Failed to fdopen descriptor: %d", fd);
+    const uint64_t total = source_->size();
+    if (total > budgetBytes) {
+        LOGI("Not loading %s into memory: %llu bytes exceeds budget of %llu", filePath_.c_str(),
+             static_cast<unsigned long long>(total), static_cast<unsigned long long>(budgetBytes));
         return false;
     }
 
-    filePath_ = displayPath;
-    usingFd_ = true;
-    fd_ = fd;
-
-    if (!readFileHeader()) {
-        LOGE("Failed to read file header: %s", displayPath.c_str());
-        close();
+    std::unique_ptr<ResidentBuffer> buffer(new ResidentBuffer());
+    if (!buffer->allocate(total)) {
+        LOGE("Failed to allocate %llu bytes for %s", static_cast<unsigned long long>(total),
+             filePath_.c_str());
         return false;
     }
 
-    if (!readIndexTable()) {
-        // Try building sequential index
-        if (!buildSequentialIndex()) {
-            LOGE("Failed to build frame index: %s", displayPath.c_str());
-            close();
-            return false;
+    // Large chunks in parallel keep several requests queued at the device
+    if (!pool_) {
+        pool_.reset(new detail::ThreadPool());
+    }
+    const uint32_t chunks = static_cast<uint32_t>((total + LOAD_CHUNK_SIZE - 1) / LOAD_CHUNK_SIZE);
+    std::atomic<bool> failed(false);
+    std::mutex progressMutex;
+    uint64_t loaded = 0;
+    pool_->parallelFor(chunks, [&](uint32_t chunk) {
+        if (failed.load()) {
+            return;
+        }
+        const uint64_t offset = static_cast<uint64_t>(chunk) * LOAD_CHUNK_SIZE;
+        const uint64_t size = std::min(LOAD_CHUNK_SIZE, total - offset);
+        if (!source_->readAt(offset, buffer->data + offset, static_cast<size_t>(size))) {
+            failed = true;
+            return;
         }
+        std::lock_guard<std::mutex> lock(progressMutex);
+        loaded += size;
+        if (progress && !progress(loaded, total)) {
+            failed = true;
+        }
+    });
+    if (failed.load()) {
+        LOGI("Loading %s into memory failed or was cancelled", filePath_.c_str());
+        return false;
     }
 
-    if (!validateIndex()) {
-        if (!buildSequentialIndex()) {
-            LOGE("Failed to validate frame index: %s", displayPath.c_str());
-            close();
-            return false;
+    source_.reset(new ResidentSource(std::move(buffer), total));
+    loadedIntoMemory_ = true;
+    stats_.appliedHint = AccessHint::NORMAL;
+    willNeedUpTo_ = 0;
+    LOGI("Loaded %s into memory (%llu bytes)", filePath_.c_str(), static_cast<unsigned long long>(total));
+    return true;
+}
+
+void VrawReader::setCacheConfig(const CacheConfig& config) {
+    cacheConfig_ = config;
+    caches_->decoded.setBudget(config.decodedBytes);
+    caches_->stored.setBudget(config.storedBytes);
+    stats_.decodedCacheBytes = caches_->decoded.bytes();
+    stats_.storedCacheBytes = caches_->stored.bytes();
+}
+
+void VrawReader::clearCache() {
+    caches_->decoded.clear();
+    caches_->stored.clear();
+    stats_.decodedCacheBytes = 0;
+    stats_.storedCacheBytes = 0;
+}
+
+void VrawReader::setAccessHint(AccessHint hint) {
+    accessHint_ = hint;
+    if (source_) {
+        applyAccessHint(hint == AccessHint::AUTO ? AccessHint::NORMAL : hint);
+    }
+}
+
+void VrawReader::applyAccessHint(AccessHint hint) {
+    if (hint == stats_.appliedHint) {
+        return;
+    }
+    source_->adviseAccess(hint);
+    stats_.appliedHint = hint;
+    stats_.hintChanges++;
+    willNeedUpTo_ = 0;
+}
+
+void VrawReader::noteFrameAccess(uint32_t frameNumber) {
+    if (hasLastFrame_ && frameNumber == lastFrameRead_ + 1) {
+        stats_.sequentialReads++;
+        sequentialRun_++;
+        randomRun_ = 0;
+    } else if (!hasLastFrame_ || frameNumber != lastFrameRead_) {
+        if (hasLastFrame_) {
+            stats_.randomReads++;
+            randomRun_++;
+        }
+        sequentialRun_ = 0;
+        willNeedUpTo_ = 0;
+    }
+    lastFrameRead_ = frameNumber;
+    hasLastFrame_ = true;
+    stats_.framesRead++;
+
+    if (accessHint_ == AccessHint::AUTO) {
+        if (sequentialRun_ >= SEQUENTIAL_RUN) {
+            applyAccessHint(AccessHint::SEQUENTIAL);
+        } else if (randomRun_ >= RANDOM_RUN) {
+            applyAccessHint(AccessHint::RANDOM);
         }
     }
 
-    LOGI("Opened fd=%d: %s (%ux%u, %u frames)", fd, displayPath.c_str(),
-         fileHeader_.width, fileHeader_.height, fileHeader_.frameCount);
-    return true;
+    // Keep the next frames requested while playing forward, topping the
+    // window up once half of it has been consumed
+    if (stats_.appliedHint != AccessHint::SEQUENTIAL ||
+        frameNumber + READAHEAD_FRAMES / 2 < willNeedUpTo_) {
+        return;
+    }
+    const uint32_t count = static_cast<uint32_t>(frameIndex_.size());
+    const uint32_t first = std::max(frameNumber + 1, willNeedUpTo_);
+    const uint32_t last = std::min(frameNumber + 1 + READAHEAD_FRAMES, count);
+    if (first >= last) {
+        return;
+    }
+    uint64_t end = source_->size();
+    if (last < count) {
+        end = frameIndex_[last];
+    } else {
+        // Stop before the audio stream / index trailer
+        if (fileHeader_.audioOffset > frameIndex_[first]) {
+            end = std::min(end, fileHeader_.audioOffset);
+        }
+        if (fileHeader_.indexOffset > frameIndex_[first]) {
+            end = std::min(end, fileHeader_.indexOffset);
+        }
+    }
+    if (end > frameIndex_[first]) {
+        source_->willNeed(frameIndex_[first], end - frameIndex_[first]);
+        stats_.willNeedRequests++;
+    }
+    willNeedUpTo_ = last;
 }
 
-void VrawReader::close() {
-    if (file_) {
-        fclose(file_);
-        file_ = nullptr;
+const uint8_t* VrawReader::fetchRange(uint64_t offset, uint32_t size, std::vector<uint8_t>& scratch) {
+    // Zero-copy when the source can map the range
+    const uint8_t* mapped = source_->map(offset, size);
+    if (mapped) {
+        return mapped;
     }
-    frameIndex_.clear();
-    filePath_.clear();
-    usingFd_ = false;
-    fd_ = -1;
+    if (scratch.size() < size) {
+        scratch.resize(size);
+    }
+    if (!source_->readAt(offset, scratch.data(), size)) {
+        return nullptr;
+    }
+    return scratch.data();
 }
 
 bool VrawReader::readFileHeader() {
     SimpleFileHeader raw;
 
-    fseek64(file_, 0, SEEK_SET);
-    if (fread(&raw, sizeof(raw), 1, file_) != 1) {
+    if (!source_->readAt(0, &raw, sizeof(raw))) {
         return false;
     }
 
@@ -289,6 +432,17 @@ bool VrawReader::readFileHeader() {
         }
 
         fileHeader_.sensorOrientation = raw.sensor_orientation;
+
+        // Planar storage is only written for even dimensions
+        if (raw.storage_layout > static_cast<uint8_t>(FrameLayout::CFA_PLANES) ||
+            (raw.storage_layout == static_cast<uint8_t>(FrameLayout::CFA_PLANES) &&
+             ((raw.width | raw.height) & 1))) {
+            return false;
+        }
+        fileHeader_.storageLayout = static_cast<FrameLayout>(raw.storage_layout);
+        fileHeader_.blackLevelSubtracted = (raw.storage_flags & STORAGE_FLAG_BLACK_SUBTRACTED) != 0;
+        fileHeader_.statsOffset = raw.stats_offset;
+        fileHeader_.audioPeaksOffset = raw.audio_peaks_offset;
     } else {
         fileHeader_.nativeWidth = raw.width;
         fileHeader_.nativeHeight = raw.height;
@@ -297,8 +451,13 @@ bool VrawReader::readFileHeader() {
         fileHeader_.hasAudio = false;
         fileHeader_.hasTimecode = false;
         fileHeader_.sensorOrientation = 0;
+        fileHeader_.storageLayout = FrameLayout::MOSAIC;
+        fileHeader_.blackLevelSubtracted = false;
+        fileHeader_.statsOffset = 0;
+        fileHeader_.audioPeaksOffset = 0;
     }
 
+    pipelines_ = detail::selectDecodePipelines(fileHeader_.encoding);
     return true;
 }
 
@@ -307,15 +466,11 @@ bool VrawReader::readIndexTable() {
         return false;
     }
 
-    // Use 64-bit seek for large file support (files >2GB)
-    fseek64(file_, static_cast<int64_t>(fileHeader_.indexOffset), SEEK_SET);
-
     frameIndex_.resize(fileHeader_.frameCount);
-    for (uint32_t i = 0; i < fileHeader_.frameCount; i++) {
-        if (fread(&frameIndex_[i], sizeof(uint64_t), 1, file_) != 1) {
-            frameIndex_.clear();
-            return false;
-        }
+    if (!source_->readAt(fileHeader_.indexOffset, frameIndex_.data(),
+                         frameIndex_.size() * sizeof(uint64_t))) {
+        frameIndex_.clear();
+        return false;
     }
 
     return true;
@@ -324,18 +479,15 @@ bool VrawReader::readIndexTable() {
 bool VrawReader::buildSequentialIndex() {
     frameIndex_.clear();
 
-    // Use 64-bit file operations for large file support (>2GB)
-    fseek64(file_, 0, SEEK_END);
-    int64_t fileLen = ftell64(file_);
+    const int64_t fileLen = static_cast<int64_t>(source_->size());
 
     int64_t pos = FILE_HEADER_SIZE;
     uint32_t count = 0;
 
     while (pos + FRAME_HEADER_SIZE <= fileLen && count < fileHeader_.frameCount) {
         // Read frame header BEFORE adding to index to validate completeness
-        fseek64(file_, pos, SEEK_SET);
         SimpleFrameHeader fh;
-        if (fread(&fh, sizeof(fh), 1, file_) != 1) {
+        if (!source_->readAt(static_cast<uint64_t>(pos), &fh, sizeof(fh))) {
             break;
         }
 
@@ -364,12 +516,10 @@ bool VrawReader::validateIndex() {
         return false;
     }
 
-    // Use 64-bit file operations for large file support (>2GB)
-    fseek64(file_, 0, SEEK_END);
-    int64_t fileLen = ftell64(file_);
+    const uint64_t fileLen = source_->size();
 
     for (uint64_t offset : frameIndex_) {
-        if (offset < FILE_HEADER_SIZE || offset >= static_cast<uint64_t>(fileLen)) {
+        if (offset < FILE_HEADER_SIZE || offset >= fileLen) {
             return false;
         }
     }
@@ -377,220 +527,1169 @@ bool VrawReader::validateIndex() {
     return true;
 }
 
+// Undo LZ4 on a frame payload: one block, or a chunked stream whose blocks
+// reference the previous 64 KB of output
+static bool decompressPayload(const SimpleFrameHeader& fh, const uint8_t* src, uint32_t srcSize,
+                              uint8_t* dst, uint32_t dstSize) {
+    if (!(fh.reserved[0] & FRAME_FLAG_CHUNKED)) {
+        return LZ4_decompress_safe(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+                                   static_cast<int>(srcSize), static_cast<int>(dstSize)) >= 0;
+    }
+    uint32_t in = 0;
+    uint32_t out = 0;
+    while (in < srcSize) {
+        FrameChunkHeader chunk;
+        if (srcSize - in < sizeof(chunk)) {
+            return false;
+        }
+        memcpy(&chunk, src + in, sizeof(chunk));
+        in += sizeof(chunk);
+        if (chunk.compressed_size > srcSize - in || chunk.raw_size > dstSize - out) {
+            return false;
+        }
+        const uint32_t dictSize = std::min(out, LZ4_DICT_BYTES);
+        if (LZ4_decompress_safe_usingDict(reinterpret_cast<const char*>(src + in),
+                                          reinterpret_cast<char*>(dst + out),
+                                          static_cast<int>(chunk.compressed_size),
+                                          static_cast<int>(chunk.raw_size),
+                                          reinterpret_cast<const char*>(dst + out - dictSize),
+                                          static_cast<int>(dictSize)) != static_cast<int>(chunk.raw_size)) {
+            return false;
+        }
+        in += chunk.compressed_size;
+        out += chunk.raw_size;
+    }
+    return out == dstSize;
+}
+
+static void convertFrameHeader(const SimpleFrameHeader& fh, FrameHeader& header) {
+    header.timestampUs = fh.timestamp_us;
+    header.frameNumber = fh.frame_number;
+    header.compressedSize = fh.compressed_size;
+    header.uncompressedSize = fh.uncompressed_size;
+    header.iso = fh.iso;
+    header.exposureTimeMs = fh.exposure_time_ms;
+    header.whiteBalanceR = fh.white_balance_r;
+    header.whiteBalanceG = fh.white_balance_g;
+    header.whiteBalanceB = fh.white_balance_b;
+    header.focalLength = fh.focal_length;
+    header.aperture = fh.aperture;
+    header.focusDistance = fh.focus_distance;
+    for (int i = 0; i < 4; i++) {
+        header.dynamicBlackLevel[i] = fh.dynamic_black_level[i];
+    }
+}
+
 VrawReader::Frame VrawReader::readFrame(uint32_t frameNumber) {
     Frame result;
     result.valid = false;
 
-    if (!file_ || frameNumber >= frameIndex_.size()) {
+    if (!source_ || frameNumber >= frameIndex_.size()) {
         return result;
     }
 
-    uint64_t frameOffset = frameIndex_[frameNumber];
-    // Use 64-bit seek for large file support (>2GB)
-    fseek64(file_, static_cast<int64_t>(frameOffset), SEEK_SET);
+    result.pixelData.resize(getFrameSizeBytes());
+    result.valid = readFrameInto(frameNumber, result.pixelData.data(),
+                                 result.pixelData.size(), &result.header);
+    if (!result.valid) {
+        result.pixelData.clear();
+    }
+    return result;
+}
+
+size_t VrawReader::getFrameSizeBytes() const {
+    if (outputLayout_ == FrameLayout::CFA_PLANES) {
+        return static_cast<size_t>(fileHeader_.width / 2) * (fileHeader_.height / 2) * 4 * 2;
+    }
+    return static_cast<size_t>(fileHeader_.width) * fileHeader_.height * 2;
+}
+
+bool VrawReader::readFrameInto(uint32_t frameNumber, void* dst, size_t dstBytes,
+                               FrameHeader* header) {
+    if (!source_ || !dst || frameNumber >= frameIndex_.size() || dstBytes < getFrameSizeBytes()) {
+        return false;
+    }
+
+    uint16_t* out = static_cast<uint16_t*>(dst);
+    const bool planarOut = (outputLayout_ == FrameLayout::CFA_PLANES);
+    const bool planarStored = (fileHeader_.storageLayout == FrameLayout::CFA_PLANES);
+    const size_t frameBytes = getFrameSizeBytes();
+    const uint32_t sampleCount = storedSampleCount();
+    const uint64_t decodedKey = (static_cast<uint64_t>(frameNumber) << 1) | (planarOut ? 1 : 0);
+    const bool useDecodedCache = cacheConfig_.decodedBytes > 0;
+    const bool useStoredCache = cacheConfig_.storedBytes > 0;
+
+    if (useDecodedCache) {
+        const FrameCaches::Decoded* hit = caches_->decoded.find(decodedKey);
+        if (hit) {
+            memcpy(out, hit->pixels.data(), frameBytes);
+            if (header) {
+                *header = hit->header;
+            }
+            stats_.decodedCacheHits++;
+            stats_.framesRead++;
+            return true;
+        }
+    }
 
     SimpleFrameHeader fh;
-    if (fread(&fh, sizeof(fh), 1, file_) != 1) {
-        return result;
+    const uint8_t* stored = nullptr;
+    bool fromSource = true;
+    if (useStoredCache) {
+        const std::vector<uint8_t>* hit = caches_->stored.find(frameNumber);
+        if (hit) {
+            memcpy(&fh, hit->data(), sizeof(fh));
+            stored = hit->data() + sizeof(fh);
+            fromSource = false;
+            stats_.storedCacheHits++;
+            stats_.framesRead++;
+        }
     }
 
-    result.header.timestampUs = fh.timestamp_us;
-    result.header.frameNumber = fh.frame_number;
-    result.header.compressedSize = fh.compressed_size;
-    result.header.uncompressedSize = fh.uncompressed_size;
-    result.header.iso = fh.iso;
-    result.header.exposureTimeMs = fh.exposure_time_ms;
-    result.header.whiteBalanceR = fh.white_balance_r;
-    result.header.whiteBalanceG = fh.white_balance_g;
-    result.header.whiteBalanceB = fh.white_balance_b;
-    result.header.focalLength = fh.focal_length;
-    result.header.aperture = fh.aperture;
-    result.header.focusDistance = fh.focus_distance;
-    for (int i = 0; i < 4; i++) {
-        result.header.dynamicBlackLevel[i] = fh.dynamic_black_level[i];
+    if (fromSource) {
+        // Where raw 16-bit samples can land without conversion
+        uint16_t* samples = nullptr;
+        if (planarStored) {
+            samples = out;
+            if (!planarOut) {
+                if (scratch_.mosaic.size() < sampleCount) {
+                    scratch_.mosaic.resize(sampleCount);
+                }
+                samples = scratch_.mosaic.data();
+            }
+        } else if (!planarOut) {
+            samples = out;
+        }
+
+        if (!fetchFrame(frameNumber, fh, stored, samples,
+                        samples ? static_cast<size_t>(sampleCount) * 2 : 0)) {
+            return false;
+        }
+        noteFrameAccess(frameNumber);
+        const uint32_t dataSize = (fh.compressed_size > 0) ? fh.compressed_size : fh.uncompressed_size;
+        stats_.bytesRead += sizeof(fh) + dataSize;
+        if (useDecodedCache || useStoredCache) {
+            stats_.cacheMisses++;
+        }
+
+        // Only worth keeping as stored when smaller than the decoded frame
+        if (useStoredCache && dataSize < static_cast<uint64_t>(sampleCount) * 2) {
+            std::vector<uint8_t> entry(sizeof(fh) + dataSize);
+            memcpy(entry.data(), &fh, sizeof(fh));
+            memcpy(entry.data() + sizeof(fh), stored, dataSize);
+            caches_->stored.insert(frameNumber, std::move(entry), sizeof(fh) + dataSize);
+            stats_.storedCacheBytes = caches_->stored.bytes();
+        }
+    }
+    isPacked_ = (fh.uncompressed_size > 0 && fh.uncompressed_size < sampleCount * 2);
+
+    if (header) {
+        convertFrameHeader(fh, *header);
+    }
+    if (!decodeFrame(fh, stored, out, scratch_)) {
+        return false;
+    }
+
+    if (useDecodedCache) {
+        FrameCaches::Decoded entry;
+        convertFrameHeader(fh, entry.header);
+        entry.pixels.assign(out, out + frameBytes / 2);
+        caches_->decoded.insert(decodedKey, std::move(entry), frameBytes);
+        stats_.decodedCacheBytes = caches_->decoded.bytes();
+    }
+    return true;
+}
+
+bool VrawReader::readFrames(const std::vector<uint32_t>& frames, const FrameCallback& onFrame) {
+    return readFrames(frames, onFrame, BatchReadOptions());
+}
+
+bool VrawReader::readFrames(const std::vector<uint32_t>& frames, const FrameCallback& onFrame,
+                            const BatchReadOptions& options) {
+    if (!source_ || !onFrame) {
+        return false;
+    }
+
+    // A run of neighbouring frames fetched with one read
+    struct Extent {
+        uint64_t offset;
+        uint64_t size;           // 0: frame size unknown, fetched header-first
+        size_t first;            // Range in `order`
+        size_t count;
+        uint64_t done;           // Bytes landed so far (io_uring short reads)
+        const uint8_t* bytes;
+        std::vector<uint8_t> buffer;
+    };
+
+    // Per-worker decode state
+    struct Worker {
+        DecodeScratch scratch;
+        std::vector<uint16_t> pixels;
+    };
+
+    const FrameHeader emptyHeader = FrameHeader();
+    std::atomic<uint32_t> failures(0);
+
+    std::vector<size_t> order;
+    order.reserve(frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (frames[i] < frameIndex_.size()) {
+            order.push_back(i);
+        } else {
+            onFrame(i, frames[i], nullptr, emptyHeader);
+            failures++;
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return frameIndex_[frames[a]] < frameIndex_[frames[b]];
+    });
+
+    // Merge frames that touch or overlap (duplicates) into one extent
+    std::vector<Extent> extents;
+    for (size_t k = 0; k < order.size(); ++k) {
+        const uint32_t f = frames[order[k]];
+        const uint64_t start = frameIndex_[f];
+        const uint64_t size = frameSizes_[f];
+        if (size > 0 && !extents.empty()) {
+            Extent& last = extents.back();
+            const uint64_t end = std::max(last.offset + last.size, start + size);
+            if (last.size > 0 && start <= last.offset + last.size &&
+                end - last.offset <= std::max<uint64_t>(options.maxMergeBytes, last.size)) {
+                last.size = end - last.offset;
+                last.count++;
+                continue;
+            }
+        }
+        extents.push_back(Extent{start, size, k, 1, 0, nullptr, std::vector<uint8_t>()});
+    }
+
+    const unsigned threads = options.decodeThreads ? options.decodeThreads : detail::defaultThreadCount();
+    if (!pool_ || pool_->size() != threads) {
+        pool_.reset(new detail::ThreadPool(threads));
+    }
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<Worker*> freeWorkers;
+    std::mutex workerMutex;
+
+    // Bounds extents read or in flight but not yet decoded
+    const uint32_t depth = std::max<uint32_t>(options.queueDepth, 1);
+    uint32_t pending = 0;
+    std::mutex pendingMutex;
+    std::condition_variable pendingCv;
+
+    auto decodeExtent = [&](Extent& ext, bool readOk) {
+        Worker* worker = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(workerMutex);
+            if (freeWorkers.empty()) {
+                workers.emplace_back(new Worker());
+                freeWorkers.push_back(workers.back().get());
+            }
+            worker = freeWorkers.back();
+            freeWorkers.pop_back();
+        }
+        if (worker->pixels.size() * 2 < getFrameSizeBytes()) {
+            worker->pixels.resize(getFrameSizeBytes() / 2);
+        }
+
+        for (size_t k = ext.first; k < ext.first + ext.count; ++k) {
+            const size_t index = order[k];
+            const uint32_t f = frames[index];
+            SimpleFrameHeader fh;
+            const uint8_t* stored = nullptr;
+            bool ok = readOk;
+            if (ok && ext.size > 0) {
+                const uint8_t* frame = ext.bytes + (frameIndex_[f] - ext.offset);
+                memcpy(&fh, frame, sizeof(fh));
+                const uint32_t dataSize = (fh.compressed_size > 0) ? fh.compressed_size : fh.uncompressed_size;
+                ok = dataSize > 0 && dataSize <= frameSizes_[f] - sizeof(fh);
+                stored = frame + sizeof(fh);
+            } else if (ok) {
+                // Size unknown: header first, then the payload it describes
+                ok = source_->readAt(frameIndex_[f], &fh, sizeof(fh));
+                const uint32_t dataSize = (fh.compressed_size > 0) ? fh.compressed_size : fh.uncompressed_size;
+                ok = ok && dataSize > 0;
+                if (ok) {
+                    std::vector<uint8_t>& payload = worker->scratch.read;
+                    if (payload.size() < dataSize) {
+                        payload.resize(dataSize);
+                    }
+                    ok = source_->readAt(frameIndex_[f] + sizeof(fh), payload.data(), dataSize);
+                    stored = payload.data();
+                }
+            }
+            ok = ok && decodeFrame(fh, stored, worker->pixels.data(), worker->scratch);
+            if (ok) {
+                FrameHeader header;
+                convertFrameHeader(fh, header);
+                onFrame(index, f, worker->pixels.data(), header);
+            } else {
+                onFrame(index, f, nullptr, emptyHeader);
+                failures++;
+            }
+        }
+
+        // Release the stored bytes as soon as they are decoded
+        std::vector<uint8_t>().swap(ext.buffer);
+        {
+            std::lock_guard<std::mutex> lock(workerMutex);
+            freeWorkers.push_back(worker);
+        }
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            pending--;
+        }
+        pendingCv.notify_all();
+    };
+
+    auto dispatch = [&](size_t e, bool readOk) {
+        pool_->submit([&decodeExtent, &extents, e, readOk]() { decodeExtent(extents[e], readOk); });
+    };
+
+    // Thread-pool fallback: the worker reads the extent, then decodes it
+    auto readOnWorker = [&](size_t e) {
+        pool_->submit([&decodeExtent, &extents, this, e]() {
+            Extent& ext = extents[e];
+            decodeExtent(ext, source_->readAt(ext.offset, ext.buffer.data(), ext.size));
+        });
+    };
+
+    // Waits for a free slot; with `canBlock` false returns false instead
+    auto acquireSlot = [&](bool canBlock) {
+        std::unique_lock<std::mutex> lock(pendingMutex);
+        if (!canBlock && pending >= depth) {
+            return false;
+        }
+        pendingCv.wait(lock, [&] { return pending < depth; });
+        pending++;
+        return true;
+    };
+
+    // Points the extent at a mapping or allocates its read buffer.
+    // Returns true if the bytes still have to be read.
+    auto prepareExtent = [&](Extent& ext) {
+        if (ext.size == 0) {
+            return false;
+        }
+        ext.bytes = source_->map(ext.offset, ext.size);
+        if (!ext.bytes) {
+            ext.buffer.resize(ext.size);
+            ext.bytes = ext.buffer.data();
+            return true;
+        }
+        return false;
+    };
+
+    uint64_t bytesRead = 0;
+    uint32_t reads = 0;
+    uint32_t ringReads = 0;
+    const int fd = source_->nativeHandle();
+    detail::IoUring ring;
+    const bool useRing = options.useIoUring && fd >= 0 && !extents.empty() &&
+                         !source_->map(0, source_->size()) &&
+                         ring.init(std::min<uint32_t>(depth, 256));
+
+    size_t next = 0;
+    if (useRing) {
+        std::vector<bool> inRing(extents.size(), false);
+        unsigned inFlight = 0;
+        while (next < extents.size() || inFlight > 0) {
+            // Top up the queue; only block on decoders when nothing is in flight
+            while (next < extents.size() && acquireSlot(inFlight == 0)) {
+                Extent& ext = extents[next];
+                bytesRead += ext.size;
+                if (!prepareExtent(ext)) {
+                    dispatch(next++, true);
+                    continue;
+                }
+                reads++;
+                if (ring.queueRead(fd, ext.offset, ext.buffer.data(), static_cast<uint32_t>(ext.size), next)) {
+                    ringReads++;
+                    inRing[next] = true;
+                    inFlight++;
+                } else {
+                    readOnWorker(next);
+                }
+                next++;
+            }
+            if (inFlight == 0) {
+                continue;
+            }
+            if (!ring.submit(1)) {
+                // Give up on the ring and re-read everything that had not completed
+                LOGE("io_uring submit failed, finishing batch with pread");
+
+                // Reads the kernel never took will not complete; the ones it
+                // did may still land in their buffers, even after close(),
+                // so wait them all out before the buffers are refilled
+                std::vector<uint64_t> withdrawn;
+                inFlight -= ring.withdrawUnsubmitted(withdrawn);
+                bool drained = true;
+                while (inFlight > 0 && drained) {
+                    uint64_t id = 0;
+                    int32_t result = 0;
+                    while (ring.popCompletion(id, result)) {
+                        inFlight--;
+                    }
+                    drained = inFlight == 0 || ring.waitCompletion();
+                }
+                ring.close();
+
+                for (size_t e = 0; e < next; ++e) {
+                    if (!inRing[e]) {
+                        continue;
+                    }
+                    Extent& ext = extents[e];
+                    if (!drained) {
+                        // The kernel may still write into this buffer: abandon
+                        // it rather than reuse or free it
+                        new std::vector<uint8_t>(std::move(ext.buffer));
+                        ext.buffer.assign(ext.size, 0);
+                        ext.bytes = ext.buffer.data();
+                    }
+                    ext.done = 0;
+                    readOnWorker(e);
+                }
+                break;
+            }
+            uint64_t id = 0;
+            int32_t result = 0;
+            while (ring.popCompletion(id, result)) {
+                Extent& ext = extents[id];
+                if (result > 0) {
+                    ext.done += static_cast<uint64_t>(result);
+                }
+                if (ext.done < ext.size && result > 0 &&
+                    ring.queueRead(fd, ext.offset + ext.done, ext.buffer.data() + ext.done,
+                                   static_cast<uint32_t>(ext.size - ext.done), id)) {
+                    continue;  // Short read: queue the rest
+                }
+                inRing[id] = false;
+                inFlight--;
+                if (ext.done >= ext.size) {
+                    dispatch(id, true);
+                } else {
+                    // Error or unsupported opcode: finish with pread
+                    readOnWorker(id);
+                }
+            }
+        }
+    }
+
+    // Thread-pool path (and the rest of the batch after a ring failure)
+    for (; next < extents.size(); ++next) {
+        Extent& ext = extents[next];
+        acquireSlot(true);
+        bytesRead += ext.size;
+        if (prepareExtent(ext)) {
+            reads++;
+            readOnWorker(next);
+        } else {
+            dispatch(next, true);
+        }
+    }
+    pool_->wait();
+
+    stats_.framesRead += frames.size() - failures.load();
+    stats_.bytesRead += bytesRead;
+    stats_.batchReads += reads;
+    stats_.ioUringReads += ringReads;
+    return failures.load() == 0;
+}
+
+bool VrawReader::readFrameRows(uint32_t frameNumber, uint32_t rowsPerBand, const RowCallback& onRows,
+                               FrameHeader* header) {
+    if (!source_ || !onRows || frameNumber >= frameIndex_.size()) {
+        return false;
+    }
+
+    SimpleFrameHeader fh;
+    if (!source_->readAt(frameIndex_[frameNumber], &fh, sizeof(fh))) {
+        return false;
+    }
+    const uint64_t payloadOffset = frameIndex_[frameNumber] + sizeof(fh);
+    const uint32_t sampleCount = storedSampleCount();
+    const bool isCompressed = (fh.compressed_size > 0 && fileHeader_.compression != Compression::NONE);
+    const uint32_t dataSize = (fh.compressed_size > 0) ? fh.compressed_size : fh.uncompressed_size;
+    const bool isPacked = (fh.uncompressed_size > 0 && fh.uncompressed_size < sampleCount * 2);
+    if (dataSize == 0) {
+        return false;
+    }
+    noteFrameAccess(frameNumber);
+    stats_.bytesRead += sizeof(fh) + dataSize;
+    isPacked_ = isPacked;
+    if (header) {
+        convertFrameHeader(fh, *header);
+    }
+
+    // A single LZ4 block has no resumable decode point: decompress the
+    // (still packed) stream once, then unpack from it band by band.
+    // Chunked frames in mosaic order are instead decoded a chunk at a time
+    // into a sliding window (see streamRange below).
+    const bool isChunked = isCompressed && (fh.reserved[0] & FRAME_FLAG_CHUNKED) != 0;
+    const bool streamChunks = isChunked && fileHeader_.storageLayout != FrameLayout::CFA_PLANES;
+    const uint8_t* streamBytes = nullptr;
+    uint32_t streamSize = dataSize;
+    if (isCompressed && !streamChunks) {
+        const uint8_t* compressed = fetchRange(payloadOffset, dataSize, scratch_.read);
+        if (!compressed) {
+            return false;
+        }
+        if (scratch_.decompress.size() < fh.uncompressed_size) {
+            scratch_.decompress.resize(fh.uncompressed_size);
+        }
+        if (!decompressPayload(fh, compressed, dataSize, scratch_.decompress.data(), fh.uncompressed_size)) {
+            return false;
+        }
+        streamBytes = scratch_.decompress.data();
+    }
+    if (isCompressed) {
+        streamSize = fh.uncompressed_size;
+    }
+
+    // Decoded bytes [windowStart, windowStart + window.size()) of a chunked
+    // stream; the last 64 KB stay resident as history for the next chunk
+    std::vector<uint8_t> window;
+    std::vector<uint8_t> chunkBytes;
+    uint64_t windowStart = 0;
+    uint32_t chunkOffset = 0;
+    auto streamRange = [&](uint64_t offset, uint32_t size) -> const uint8_t* {
+        while (windowStart + window.size() < offset + size) {
+            FrameChunkHeader chunk;
+            if (dataSize - chunkOffset < sizeof(chunk) ||
+                !source_->readAt(payloadOffset + chunkOffset, &chunk, sizeof(chunk))) {
+                return nullptr;
+            }
+            chunkOffset += sizeof(chunk);
+            if (chunk.compressed_size > dataSize - chunkOffset) {
+                return nullptr;
+            }
+            const uint8_t* compressed = fetchRange(payloadOffset + chunkOffset, chunk.compressed_size, chunkBytes);
+            if (!compressed) {
+                return nullptr;
+            }
+            chunkOffset += chunk.compressed_size;
+
+            // Drop bytes no longer requested and outside the history
+            const uint64_t windowEnd = windowStart + window.size();
+            const uint64_t keepFrom = std::min<uint64_t>(offset, windowEnd - std::min<uint64_t>(windowEnd, LZ4_DICT_BYTES));
+            if (keepFrom > windowStart) {
+                const size_t drop = static_cast<size_t>(keepFrom - windowStart);
+                window.erase(window.begin(), window.begin() + drop);
+                windowStart = keepFrom;
+            }
+
+            const size_t history = std::min<size_t>(window.size(), LZ4_DICT_BYTES);
+            const size_t used = window.size();
+            window.resize(used + chunk.raw_size);
+            if (LZ4_decompress_safe_usingDict(reinterpret_cast<const char*>(compressed),
+                                              reinterpret_cast<char*>(window.data() + used),
+                                              static_cast<int>(chunk.compressed_size),
+                                              static_cast<int>(chunk.raw_size),
+                                              reinterpret_cast<const char*>(window.data() + used - history),
+                                              static_cast<int>(history)) != static_cast<int>(chunk.raw_size)) {
+                return nullptr;
+            }
+        }
+        if (offset < windowStart) {
+            return nullptr;
+        }
+        return window.data() + (offset - windowStart);
+    };
+
+    // Samples are stored in groups: 4 per 5 bytes (10-bit), 2 per 3 bytes
+    // (12-bit) or 1 per 2 bytes (16-bit)
+    const detail::DecodePipeline& pipeline = pipelines_[isPacked];
+    const uint32_t groupSamples = pipeline.groupSamples;
+    const uint32_t groupBytes = pipeline.groupBytes;
+    std::vector<uint8_t> bandBytes;
+    std::vector<uint16_t> unaligned;
+
+    // Decode samples [first, first + count) of the stored sample stream
+    auto loadSamples = [&](uint64_t first, uint32_t count, uint16_t* dst) {
+        const uint64_t lead = first % groupSamples;
+        const uint64_t byteOffset = (first / groupSamples) * groupBytes;
+        const uint64_t groups = (lead + count + groupSamples - 1) / groupSamples;
+        if (byteOffset >= streamSize) {
+            return false;
+        }
+        const uint32_t byteCount = static_cast<uint32_t>(std::min<uint64_t>(groups * groupBytes,
+                                                                            streamSize - byteOffset));
+        const uint8_t* bytes = nullptr;
+        if (streamBytes) {
+            bytes = streamBytes + byteOffset;
+        } else if (streamChunks) {
+            bytes = streamRange(byteOffset, byteCount);
+        } else {
+            bytes = fetchRange(payloadOffset + byteOffset, byteCount, bandBytes);
+        }
+        if (!bytes) {
+            return false;
+        }
+        uint16_t* target = dst;
+        if (lead > 0) {
+            if (unaligned.size() < lead + count) {
+                unaligned.resize(lead + count);
+            }
+            target = unaligned.data();
+        }
+        pipeline.unpack(bytes, byteCount, target, static_cast<uint32_t>(lead + count));
+        if (lead > 0) {
+            memcpy(dst, target + lead, static_cast<size_t>(count) * 2);
+        }
+        return true;
+    };
+
+    const uint32_t width = fileHeader_.width;
+    const uint32_t height = fileHeader_.height;
+    const uint32_t planeW = width / 2;
+    const size_t planeSize = static_cast<size_t>(planeW) * (height / 2);
+    const bool planarOut = (outputLayout_ == FrameLayout::CFA_PLANES);
+    const bool planarStored = (fileHeader_.storageLayout == FrameLayout::CFA_PLANES);
+    const uint16_t mask = pipeline.mask;
+
+    uint32_t bandRows = rowsPerBand ? rowsPerBand : 16;
+    bandRows = std::min(bandRows + (bandRows & 1), height + (height & 1));
+    std::vector<uint16_t> band(static_cast<size_t>(bandRows) * width);
+    std::vector<uint16_t> planeBand((planarOut || planarStored) ? static_cast<size_t>(bandRows / 2) * planeW * 4 : 0);
+
+    for (uint32_t y0 = 0; y0 < height; y0 += bandRows) {
+        const uint32_t rows = std::min(bandRows, height - y0);
+        const size_t bandPlaneSize = static_cast<size_t>(rows / 2) * planeW;
+        uint16_t* byPosition[4];
+        if (!planeBand.empty()) {
+            detail::cfaPlanesByPosition(fileHeader_.bayerPattern, planeBand.data(), bandPlaneSize, byPosition);
+        }
+
+        if (planarStored) {
+            // Matching rows of each stored plane
+            for (int plane = 0; plane < 4; ++plane) {
+                uint16_t* dst = planeBand.data() + plane * bandPlaneSize;
+                if (!loadSamples(plane * planeSize + static_cast<size_t>(y0 / 2) * planeW,
+                                 static_cast<uint32_t>(bandPlaneSize), dst)) {
+                    return false;
+                }
+                if (fileHeader_.blackLevelSubtracted) {
+                    const int pos = detail::cfaPlanePosition(fileHeader_.bayerPattern, plane);
+                    detail::offsetSamples(dst, bandPlaneSize, fh.dynamic_black_level[pos] & mask, mask);
+                }
+            }
+            if (!planarOut) {
+                for (uint32_t y = 0; y < rows; ++y) {
+                    const size_t inRow = static_cast<size_t>(y / 2) * planeW;
+                    const int rowPos = (y & 1) * 2;
+                    detail::interleaveRow(byPosition[rowPos] + inRow, byPosition[rowPos + 1] + inRow,
+                                          band.data() + static_cast<size_t>(y) * width, planeW);
+                }
+            }
+        } else {
+            if (!loadSamples(static_cast<uint64_t>(y0) * width, rows * width, band.data())) {
+                return false;
+            }
+            if (planarOut) {
+                for (uint32_t y = 0; y < (rows & ~1u); ++y) {
+                    const size_t outRow = static_cast<size_t>(y / 2) * planeW;
+                    const int rowPos = (y & 1) * 2;
+                    detail::deinterleaveRow(band.data() + static_cast<size_t>(y) * width,
+                                            byPosition[rowPos] + outRow, byPosition[rowPos + 1] + outRow,
+                                            planeW);
+                }
+            }
+        }
+
+        if (!onRows(y0, rows, planarOut ? planeBand.data() : band.data())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t VrawReader::storedSampleCount() const {
+    if (fileHeader_.storageLayout == FrameLayout::CFA_PLANES) {
+        return (fileHeader_.width / 2) * (fileHeader_.height / 2) * 4;
+    }
+    return fileHeader_.width * fileHeader_.height;
+}
+
+bool VrawReader::decodeFrame(const SimpleFrameHeader& fh, const uint8_t* stored, uint16_t* out,
+                             DecodeScratch& scratch) const {
+    const uint32_t width = fileHeader_.width;
+    const uint32_t height = fileHeader_.height;
+    const bool planarOut = (outputLayout_ == FrameLayout::CFA_PLANES);
+    const uint32_t sampleCount = storedSampleCount();
+
+    if (fileHeader_.storageLayout == FrameLayout::CFA_PLANES) {
+        // Stored as R, G1, G2, B planes: decode them in place or into scratch
+        const size_t planeSize = static_cast<size_t>(width / 2) * (height / 2);
+        uint16_t* planes = out;
+        if (!planarOut) {
+            if (scratch.mosaic.size() < sampleCount) {
+                scratch.mosaic.resize(sampleCount);
+            }
+            planes = scratch.mosaic.data();
+        }
+        if (!decodeStoredSamples(fh, stored, planes, sampleCount, scratch)) {
+            return false;
+        }
+        if (fileHeader_.blackLevelSubtracted) {
+            const uint16_t mask = pipelines_[0].mask;
+            for (int plane = 0; plane < 4; ++plane) {
+                const int pos = detail::cfaPlanePosition(fileHeader_.bayerPattern, plane);
+                detail::offsetSamples(planes + plane * planeSize, planeSize,
+                                      fh.dynamic_black_level[pos] & mask, mask);
+            }
+        }
+        if (!planarOut) {
+            detail::planesToMosaic(planes, width, height, fileHeader_.bayerPattern, out);
+        }
+        return true;
     }
 
-    // Determine data size and format
-    uint32_t pixelCount = fileHeader_.width * fileHeader_.height;
+    if (!planarOut) {
+        return decodeStoredSamples(fh, stored, out, sampleCount, scratch);
+    }
+
+    // Mosaic stored, planar requested: fuse the split into the copy/unpack step
+    uint32_t pixelCount = width * height;
     uint32_t fullFrameSize = pixelCount * 2;  // 16-bit samples
 
     bool isCompressed = (fh.compressed_size > 0 && fileHeader_.compression != Compression::NONE);
     uint32_t dataSize = (fh.compressed_size > 0) ? fh.compressed_size : fh.uncompressed_size;
-
-    // Detect packing: if uncompressed size is less than full frame size, data is packed
     bool isPacked = (fh.uncompressed_size > 0 && fh.uncompressed_size < fullFrameSize);
-
     if (dataSize == 0) {
-        return result;
+        return false;
     }
 
-    // Read pixel data
-    std::vector<uint8_t> rawData(dataSize);
-    if (fread(rawData.data(), 1, dataSize, file_) != dataSize) {
-        return result;
+    // Resolve the destination plane of each 2x2 tile position
+    const uint32_t planeW = width / 2;
+    const uint32_t planeRows = height & ~1u;
+    uint16_t* byPosition[4];
+    detail::cfaPlanesByPosition(fileHeader_.bayerPattern, out,
+                                static_cast<size_t>(planeW) * (height / 2), byPosition);
+
+    if (!isCompressed && !isPacked) {
+        if (dataSize < fullFrameSize) {
+            return false;
+        }
+        // Split rows straight from the stored payload
+        const uint16_t* mosaic = reinterpret_cast<const uint16_t*>(stored);
+        if (reinterpret_cast<uintptr_t>(stored) & 1) {
+            // Keep 16-bit loads aligned (mapped sources may start anywhere)
+            if (scratch.decompress.size() < fullFrameSize) {
+                scratch.decompress.resize(fullFrameSize);
+            }
+            memcpy(scratch.decompress.data(), stored, fullFrameSize);
+            mosaic = reinterpret_cast<const uint16_t*>(scratch.decompress.data());
+        }
+        for (uint32_t y = 0; y < planeRows; ++y) {
+            const size_t outRow = static_cast<size_t>(y / 2) * planeW;
+            const int rowPos = (y & 1) * 2;
+            detail::deinterleaveRow(mosaic + static_cast<size_t>(y) * width,
+                                    byPosition[rowPos] + outRow,
+                                    byPosition[rowPos + 1] + outRow, planeW);
+        }
+        return true;
     }
 
-    // Decompress if needed
-    std::vector<uint8_t> decompressedData;
-    const uint8_t* frameData = rawData.data();
-    uint32_t frameDataSize = dataSize;
+    if (!isPacked) {
+        // Compressed 16-bit: one LZ4 block, so decompress fully, then split
+        if (scratch.mosaic.size() < pixelCount) {
+            scratch.mosaic.resize(pixelCount);
+        }
+        if (!decodeStoredSamples(fh, stored, scratch.mosaic.data(), pixelCount, scratch)) {
+            return false;
+        }
+        detail::mosaicToPlanes(scratch.mosaic.data(), width, height, fileHeader_.bayerPattern, out);
+        return true;
+    }
+
+    const uint8_t* frameData = nullptr;
+    uint32_t frameDataSize = 0;
+    if (!readStoredPayload(fh, stored, frameData, frameDataSize, scratch)) {
+        return false;
+    }
 
-    if (isCompressed && fh.uncompressed_size > 0) {
-        decompressedData.resize(fh.uncompressed_size);
-        int decompressed = LZ4_decompress_safe(
-            reinterpret_cast<const char*>(rawData.data()),
-            reinterpret_cast<char*>(decompressedData.data()),
-            dataSize,
-            fh.uncompressed_size
-        );
-        if (decompressed < 0) {
-            return result;
+    // Rows start on a byte boundary when width is a whole number of packed
+    // groups (even for 12-bit, a multiple of 4 for 10-bit); unpack straight
+    // into the planes then.
+    const detail::DecodePipeline& pipeline = pipelines_[1];
+    const bool fused = (width % pipeline.groupSamples == 0);
+    const uint32_t rowBytes = width / pipeline.groupSamples * pipeline.groupBytes;
+    if (fused && static_cast<uint64_t>(rowBytes) * planeRows <= frameDataSize) {
+        for (uint32_t y = 0; y < planeRows; ++y) {
+            const uint8_t* row = frameData + static_cast<size_t>(y) * rowBytes;
+            const size_t outRow = static_cast<size_t>(y / 2) * planeW;
+            const int rowPos = (y & 1) * 2;
+            pipeline.unpackRowToPairs(row, byPosition[rowPos] + outRow,
+                                      byPosition[rowPos + 1] + outRow, planeW);
         }
-        frameData = decompressedData.data();
-        frameDataSize = fh.uncompressed_size;
+        return true;
     }
 
-    isPacked_ = isPacked;
+    // Unaligned rows: unpack the mosaic to scratch, then split
+    if (scratch.mosaic.size() < pixelCount) {
+        scratch.mosaic.resize(pixelCount);
+    }
+    pipeline.unpack(frameData, frameDataSize, scratch.mosaic.data(), pixelCount);
+    detail::mosaicToPlanes(scratch.mosaic.data(), width, height, fileHeader_.bayerPattern, out);
+    return true;
+}
 
-    // Unpack bit-packed data to 16-bit samples
-    bool is12Bit = (fileHeader_.encoding == Encoding::LOG2_12BIT ||
-                    fileHeader_.encoding == Encoding::LINEAR_12BIT);
+bool VrawReader::fetchFrame(uint32_t frameNumber, SimpleFrameHeader& fh, const uint8_t*& payload,
+                            void* direct, size_t directBytes) {
+    const uint64_t offset = frameIndex_[frameNumber];
+    const uint64_t frameSize = frameSizes_[frameNumber];
 
-    if (isPacked) {
-        if (is12Bit) {
-            unpackFrame12Bit(frameData, frameDataSize, result.pixelData, pixelCount);
+    if (frameSize <= sizeof(fh)) {
+        // Size unknown: header first, then the payload it describes
+        if (!source_->readAt(offset, &fh, sizeof(fh))) {
+            return false;
+        }
+        const uint32_t dataSize = (fh.compressed_size > 0) ? fh.compressed_size : fh.uncompressed_size;
+        if (dataSize == 0) {
+            return false;
+        }
+        payload = fetchRange(offset + sizeof(fh), dataSize, scratch_.read);
+        return payload != nullptr;
+    }
+
+    // Size known from the index: header and payload in one request
+    const uint64_t payloadCapacity = frameSize - sizeof(fh);
+    const uint8_t* frame = source_->map(offset, frameSize);
+    bool directRead = false;
+    if (!frame) {
+        if (direct && payloadCapacity == directBytes && fileHeader_.compression == Compression::NONE) {
+            // Raw samples: scatter the payload straight into the destination
+            ReadSlice slices[2] = {{&fh, sizeof(fh)}, {direct, directBytes}};
+            if (!source_->readAtv(offset, slices, 2)) {
+                return false;
+            }
+            directRead = true;
         } else {
-            unpackFrame10Bit(frameData, frameDataSize, result.pixelData, pixelCount);
+            if (scratch_.read.size() < frameSize) {
+                scratch_.read.resize(frameSize);
+            }
+            if (!source_->readAt(offset, scratch_.read.data(), frameSize)) {
+                return false;
+            }
+            frame = scratch_.read.data();
         }
-    } else if (isCompressed) {
-        result.pixelData = std::move(decompressedData);
+    }
+    if (!directRead) {
+        memcpy(&fh, frame, sizeof(fh));
+    }
+
+    const uint32_t dataSize = (fh.compressed_size > 0) ? fh.compressed_size : fh.uncompressed_size;
+    if (dataSize == 0 || dataSize > payloadCapacity) {
+        return false;
+    }
+    if (!directRead) {
+        payload = frame + sizeof(fh);
+    } else if (dataSize == directBytes && fh.uncompressed_size == directBytes) {
+        payload = static_cast<const uint8_t*>(direct);
     } else {
-        result.pixelData = std::move(rawData);
+        // Not raw after all: move the payload out of the way of the decoder
+        if (scratch_.read.size() < dataSize) {
+            scratch_.read.resize(dataSize);
+        }
+        memcpy(scratch_.read.data(), direct, dataSize);
+        payload = scratch_.read.data();
     }
+    return true;
+}
 
-    result.valid = true;
-    return result;
+void VrawReader::computeFrameSizes() {
+    // Frames are written back to back, so each one ends where the next
+    // begins; the last one ends at the audio stream, the index or EOF.
+    const size_t count = frameIndex_.size();
+    const uint64_t maxFrame = sizeof(SimpleFrameHeader) +
+        static_cast<uint64_t>(LZ4_compressBound(static_cast<int>(
+            std::min<uint64_t>(static_cast<uint64_t>(fileHeader_.width) * fileHeader_.height * 2,
+                               LZ4_MAX_INPUT_SIZE))));
+    frameSizes_.assign(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t start = frameIndex_[i];
+        uint64_t end = 0;
+        if (i + 1 < count) {
+            end = frameIndex_[i + 1];
+        } else {
+            end = source_->size();
+            if (fileHeader_.audioOffset > start) {
+                end = std::min(end, fileHeader_.audioOffset);
+            }
+            if (fileHeader_.indexOffset > start) {
+                end = std::min(end, fileHeader_.indexOffset);
+            }
+        }
+        // Out-of-order or oversized spans fall back to two reads
+        if (end > start + sizeof(SimpleFrameHeader) && end - start <= maxFrame) {
+            frameSizes_[i] = end - start;
+        }
+    }
 }
 
-bool VrawReader::readFrameHeader(uint32_t frameNumber, FrameHeader& header) {
-    if (!file_ || frameNumber >= frameIndex_.size()) {
+bool VrawReader::readStoredPayload(const SimpleFrameHeader& fh, const uint8_t* stored,
+                                   const uint8_t*& data, uint32_t& size,
+                                   DecodeScratch& scratch) const {
+    // Returns the payload with LZ4 removed (still bit-packed if it was packed)
+    bool isCompressed = (fh.compressed_size > 0 && fileHeader_.compression != Compression::NONE);
+    uint32_t dataSize = (fh.compressed_size > 0) ? fh.compressed_size : fh.uncompressed_size;
+    if (dataSize == 0) {
         return false;
     }
 
-    uint64_t frameOffset = frameIndex_[frameNumber];
-    // Use 64-bit seek for large file support (>2GB)
-    if (fseek64(file_, static_cast<int64_t>(frameOffset), SEEK_SET) != 0) {
+    if (!isCompressed || fh.uncompressed_size == 0) {
+        data = stored;
+        size = dataSize;
+        return true;
+    }
+
+    if (scratch.decompress.size() < fh.uncompressed_size) {
+        scratch.decompress.resize(fh.uncompressed_size);
+    }
+    if (!decompressPayload(fh, stored, dataSize, scratch.decompress.data(), fh.uncompressed_size)) {
         return false;
     }
+    data = scratch.decompress.data();
+    size = fh.uncompressed_size;
+    return true;
+}
 
-    // Read only the 64-byte frame header (no pixel data)
-    SimpleFrameHeader fh;
-    if (fread(&fh, sizeof(fh), 1, file_) != 1) {
+bool VrawReader::decodeStoredSamples(const SimpleFrameHeader& fh, const uint8_t* stored,
+                                     uint16_t* dst, uint32_t sampleCount,
+                                     DecodeScratch& scratch) const {
+    const uint32_t fullSize = sampleCount * 2;  // 16-bit samples
+
+    bool isCompressed = (fh.compressed_size > 0 && fileHeader_.compression != Compression::NONE);
+    uint32_t dataSize = (fh.compressed_size > 0) ? fh.compressed_size : fh.uncompressed_size;
+
+    // Detect packing: if uncompressed size is less than full frame size, data is packed
+    bool isPacked = (fh.uncompressed_size > 0 && fh.uncompressed_size < fullSize);
+
+    if (dataSize == 0) {
         return false;
     }
 
-    // Copy to public header structure
-    header.timestampUs = fh.timestamp_us;
-    header.frameNumber = fh.frame_number;
-    header.compressedSize = fh.compressed_size;
-    header.uncompressedSize = fh.uncompressed_size;
-    header.iso = fh.iso;
-    header.exposureTimeMs = fh.exposure_time_ms;
-    header.whiteBalanceR = fh.white_balance_r;
-    header.whiteBalanceG = fh.white_balance_g;
-    header.whiteBalanceB = fh.white_balance_b;
-    header.focalLength = fh.focal_length;
-    header.aperture = fh.aperture;
-    header.focusDistance = fh.focus_distance;
-    for (int i = 0; i < 4; i++) {
-        header.dynamicBlackLevel[i] = fh.dynamic_black_level[i];
+    // Plain 16-bit frames usually arrive in the destination already
+    if (!isCompressed && !isPacked) {
+        if (dataSize > fullSize) {
+            return false;
+        }
+        if (stored != reinterpret_cast<const uint8_t*>(dst)) {
+            memcpy(dst, stored, dataSize);
+        }
+        return true;
     }
 
-    return true;
-}
+    // Compressed unpacked frames decompress straight into the destination
+    if (isCompressed && !isPacked) {
+        if (fh.uncompressed_size > fullSize) {
+            return false;
+        }
+        return decompressPayload(fh, stored, dataSize, reinterpret_cast<uint8_t*>(dst),
+                                 fh.uncompressed_size);
+    }
 
-bool VrawReader::readAudio(AudioHeader& header, std::vector<int16_t>& samples) {
-    if (!file_ || !fileHeader_.hasAudio || fileHeader_.audioOffset == 0) {
+    const uint8_t* frameData = nullptr;
+    uint32_t frameDataSize = 0;
+    if (!readStoredPayload(fh, stored, frameData, frameDataSize, scratch)) {
         return false;
     }
 
-    // Use 64-bit seek for large file support (>2GB)
-    fseek64(file_, static_cast<int64_t>(fileHeader_.audioOffset), SEEK_SET);
+    // Unpack bit-packed data to 16-bit samples
+    pipelines_[1].unpack(frameData, frameDataSize, dst, sampleCount);
+    return true;
+}
 
-    AudioStreamHeaderRaw ash;
-    if (fread(&ash, sizeof(ash), 1, file_) != 1) {
+bool VrawReader::readFrameHeader(uint32_t frameNumber, FrameHeader& header) {
+    if (!source_ || frameNumber >= frameIndex_.size()) {
         return false;
     }
 
-    if (memcmp(ash.magic, "MAUD", 4) != 0) {
+    // Read only the 64-byte frame header (no pixel data)
+    SimpleFrameHeader fh;
+    if (!source_->readAt(frameIndex_[frameNumber], &fh, sizeof(fh))) {
         return false;
     }
 
-    header.sampleRate = ash.sample_rate;
-    header.channels = ash.channels;
-    header.bitDepth = ash.bit_depth;
-    header.sampleCount = ash.sample_count;
-    header.startTimestampUs = ash.start_timestamp_us;
+    // Copy to public header structure
+    convertFrameHeader(fh, header);
 
-    uint64_t totalSamples = ash.sample_count * ash.channels;
-    samples.resize(totalSamples);
+    return true;
+}
 
-    if (fread(samples.data(), sizeof(int16_t), totalSamples, file_) != totalSamples) {
-        samples.clear();
+void VrawReader::readStatsTableHeader() {
+    statsCount_ = 0;
+    if (fileHeader_.statsOffset == 0) {
+        return;
+    }
+    FrameStatsTableHeader th;
+    if (!source_->readAt(fileHeader_.statsOffset, &th, sizeof(th)) ||
+        memcmp(th.magic, "MSTA", 4) != 0 || th.version != 1 || th.channels != 4 ||
+        th.histogram_bins != FrameStats::HISTOGRAM_BINS || th.record_size != sizeof(FrameStatsRecord) ||
+        fileHeader_.statsOffset + sizeof(th) + static_cast<uint64_t>(th.frame_count) * th.record_size >
+            source_->size()) {
+        LOGE("Ignoring invalid frame statistics table: %s", filePath_.c_str());
+        return;
+    }
+    statsCount_ = std::min<uint32_t>(th.frame_count, static_cast<uint32_t>(frameIndex_.size()));
+}
+
+static void convertFrameStats(const FrameStatsRecord& record, FrameStats& stats) {
+    for (int c = 0; c < 4; ++c) {
+        const FrameStatsChannelRecord& rc = record.channels[c];
+        FrameStats::Channel& ch = stats.channels[c];
+        ch.min = rc.min;
+        ch.max = rc.max;
+        ch.mean = rc.mean;
+        ch.clipped = rc.clipped;
+        memcpy(ch.histogram, rc.histogram, sizeof(ch.histogram));
+    }
+}
+
+bool VrawReader::readFrameStats(uint32_t frameNumber, FrameStats& stats) {
+    if (!source_ || frameNumber >= statsCount_) {
         return false;
     }
+    FrameStatsRecord record;
+    if (!source_->readAt(fileHeader_.statsOffset + sizeof(FrameStatsTableHeader) +
+                             static_cast<uint64_t>(frameNumber) * sizeof(record),
+                         &record, sizeof(record))) {
+        return false;
+    }
+    convertFrameStats(record, stats);
+    return true;
+}
 
+bool VrawReader::readAllFrameStats(std::vector<FrameStats>& stats) {
+    if (!source_ || statsCount_ == 0) {
+        return false;
+    }
+    std::vector<FrameStatsRecord> records(statsCount_);
+    if (!source_->readAt(fileHeader_.statsOffset + sizeof(FrameStatsTableHeader), records.data(),
+                         records.size() * sizeof(FrameStatsRecord))) {
+        return false;
+    }
+    stats.resize(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        convertFrameStats(records[i], stats[i]);
+    }
     return true;
 }
 
-// Unpack 10-bit packed data to 16-bit samples
-static void unpackFrame10Bit(const uint8_t* src, uint32_t srcBytes, std::vector<uint8_t>& dst, uint32_t pixelCount) {
-    dst.resize(pixelCount * 2);
-    uint16_t* dstPtr = reinterpret_cast<uint16_t*>(dst.data());
+void VrawReader::readAudioPeakTableHeader() {
+    peakLevels_.clear();
+    peakChannels_ = 0;
+    if (fileHeader_.audioPeaksOffset == 0) {
+        return;
+    }
+    const uint64_t base = fileHeader_.audioPeaksOffset;
+    AudioPeakTableHeader th;
+    std::vector<AudioPeakLevelRecord> levels;
+    bool valid = source_->readAt(base, &th, sizeof(th)) && memcmp(th.magic, "MPKS", 4) == 0 &&
+                 th.version == 1 && th.channels > 0 && th.level_count > 0;
+    if (valid) {
+        levels.resize(th.level_count);
+        valid = source_->readAt(base + sizeof(th), levels.data(), levels.size() * sizeof(AudioPeakLevelRecord));
+    }
+    uint32_t previous = 0;
+    for (size_t i = 0; valid && i < levels.size(); ++i) {
+        const AudioPeakLevelRecord& lr = levels[i];
+        valid = lr.samples_per_peak > previous &&
+                base + lr.data_offset + static_cast<uint64_t>(lr.peak_count) * th.channels *
+                    sizeof(AudioPeakRecord) <= source_->size();
+        previous = lr.samples_per_peak;
+    }
+    if (!valid) {
+        LOGE("Ignoring invalid audio peak table: %s", filePath_.c_str());
+        return;
+    }
+    for (const AudioPeakLevelRecord& lr : levels) {
+        peakLevels_.push_back({lr.samples_per_peak, lr.peak_count, base + lr.data_offset});
+    }
+    peakChannels_ = th.channels;
+}
 
-    uint32_t bitBuffer = 0;
-    int bitCount = 0;
-    uint32_t srcIdx = 0;
-    uint32_t pixelIdx = 0;
+std::vector<uint32_t> VrawReader::getAudioPeakResolutions() const {
+    std::vector<uint32_t> resolutions;
+    for (const PeakLevel& level : peakLevels_) {
+        resolutions.push_back(level.samplesPerPeak);
+    }
+    return resolutions;
+}
 
-    while (pixelIdx < pixelCount && srcIdx < srcBytes) {
-        while (bitCount < 10 && srcIdx < srcBytes) {
-            bitBuffer |= static_cast<uint32_t>(src[srcIdx++]) << bitCount;
-            bitCount += 8;
+bool VrawReader::readAudioPeaks(uint32_t samplesPerPeak, std::vector<AudioPeak>& peaks) {
+    if (!source_ || samplesPerPeak == 0) {
+        return false;
+    }
+    const PeakLevel* level = nullptr;
+    for (const PeakLevel& candidate : peakLevels_) {
+        if (samplesPerPeak % candidate.samplesPerPeak == 0) {
+            level = &candidate;  // Levels are finest first; keep the coarsest match
         }
-        if (bitCount >= 10) {
-            dstPtr[pixelIdx++] = bitBuffer & 0x3FF;
-            bitBuffer >>= 10;
-            bitCount -= 10;
+    }
+    if (!level) {
+        return false;
+    }
+
+    const size_t channels = peakChannels_;
+    std::vector<AudioPeakRecord> records(static_cast<size_t>(level->peakCount) * channels);
+    if (!records.empty() &&
+        !source_->readAt(level->offset, records.data(), records.size() * sizeof(AudioPeakRecord))) {
+        return false;
+    }
+
+    const size_t factor = samplesPerPeak / level->samplesPerPeak;
+    const size_t outCount = (level->peakCount + factor - 1) / factor;
+    peaks.assign(outCount * channels, AudioPeak{INT16_MAX, INT16_MIN});
+    for (size_t i = 0; i < level->peakCount; ++i) {
+        AudioPeak* out = peaks.data() + (i / factor) * channels;
+        const AudioPeakRecord* in = records.data() + i * channels;
+        for (size_t c = 0; c < channels; ++c) {
+            out[c].min = std::min(out[c].min, in[c].min);
+            out[c].max = std::max(out[c].max, in[c].max);
         }
     }
+    return true;
 }
 
-// Unpack 12-bit packed data to 16-bit samples
-static void unpackFrame12Bit(const uint8_t* src, uint32_t srcBytes, std::vector<uint8_t>& dst, uint32_t pixelCount) {
-    dst.resize(pixelCount * 2);
-    uint16_t* dstPtr = reinterpret_cast<uint16_t*>(dst.data());
+bool VrawReader::readAudioHeader(AudioHeader& header) {
+    if (!source_ || !fileHeader_.hasAudio || fileHeader_.audioOffset == 0) {
+        return false;
+    }
 
-    uint32_t srcIdx = 0;
-    uint32_t pixelIdx = 0;
+    AudioStreamHeader ash;
+    if (!source_->readAt(fileHeader_.audioOffset, &ash, sizeof(ash))) {
+        return false;
+    }
 
-    while (pixelIdx < pixelCount && srcIdx + 2 < srcBytes) {
-        uint8_t b0 = src[srcIdx++];
-        uint8_t b1 = src[srcIdx++];
-        uint8_t b2 = src[srcIdx++];
+    if (memcmp(ash.magic, "MAUD", 4) != 0) {
+        return false;
+    }
 
-        dstPtr[pixelIdx++] = (static_cast<uint16_t>(b0) << 4) | ((b1 >> 4) & 0x0F);
-        if (pixelIdx < pixelCount) {
-            dstPtr[pixelIdx++] = (static_cast<uint16_t>(b1 & 0x0F) << 8) | b2;
-        }
+    header.sampleRate = ash.sample_rate;
+    header.channels = ash.channels;
+    header.bitDepth = ash.bit_depth;
+    header.sampleCount = ash.sample_count;
+    header.startTimestampUs = ash.start_timestamp_us;
+    return true;
+}
+
+bool VrawReader::readAudio(AudioHeader& header, std::vector<int16_t>& samples) {
+    if (!readAudioHeader(header)) {
+        return false;
     }
 
-    // Handle remaining byte pair if odd pixel count
-    if (pixelIdx < pixelCount && srcIdx + 1 < srcBytes) {
-        uint8_t b0 = src[srcIdx++];
-        uint8_t b1 = src[srcIdx++];
-        dstPtr[pixelIdx++] = (static_cast<uint16_t>(b0) << 4) | ((b1 >> 4) & 0x0F);
+    uint64_t totalSamples = header.sampleCount * header.channels;
+    samples.resize(totalSamples);
+
+    if (!source_->readAt(fileHeader_.audioOffset + sizeof(AudioStreamHeader), samples.data(),
+                         totalSamples * sizeof(int16_t))) {
+        samples.clear();
+        return false;
     }
+
+    return true;
 }
 
 } // namespace vraw
@@ -3,8 +3,13 @@
  */
 
 #include "VrawWriter.h"
-#include "Encoding.h"
+#include "VrawFormat.h"
+#include "BitPacking.h"
+#include "CfaPlanes.h"
+#include "Pipeline.h"
+#include "ThreadPool.h"
 #include "lz4.h"
+#include <cstddef>
 #include <cstring>
 #include <ctime>
 #include <algorithm>
@@ -22,88 +27,80 @@
 
 namespace vraw {
 
-// Internal file structures (must match format spec)
-#pragma pack(push, 1)
-
-struct SimpleFrameHeader {
-    uint64_t timestamp_us;
-    uint32_t frame_number;
-    uint32_t compressed_size;
-    uint32_t uncompressed_size;
-    float iso;
-    float exposure_time_ms;
-    float white_balance_r;
-    float white_balance_g;
-    float white_balance_b;
-    float focal_length;
-    float aperture;
-    float focus_distance;
-    uint16_t dynamic_black_level[4];
-    uint8_t reserved[4];
-};
+// Recycled payload buffers kept for the pre-roll ring
+static const size_t PRE_ROLL_POOL_SIZE = 8;
+
+// Chunked encoding: scratch per band sample (16-bit band, packed band and
+// LZ4 bound, with margin) and the smallest useful budget
+static const size_t CHUNK_BYTES_PER_SAMPLE = 7;
+static const size_t MIN_CHUNK_SCRATCH = 256 * 1024;
+
+static_assert(FrameStats::HISTOGRAM_BINS == sizeof(FrameStatsChannelRecord::histogram) / sizeof(uint32_t),
+              "stats record must hold every histogram bin");
+
+namespace {
+
+// Per CFA position sums for a run of whole mosaic rows, merged into the
+// frame's FrameStats
+struct StatsAccumulator {
+    uint64_t sum[4] = {};
+    uint64_t count[4] = {};
+    uint16_t min[4] = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
+    uint16_t max[4] = {};
+    uint32_t clipped[4] = {};
+    uint32_t histogram[4][FrameStats::HISTOGRAM_BINS] = {};
+
+    void addRows(const uint16_t* rows, uint32_t width, uint32_t firstRow, uint32_t rowCount,
+                 uint16_t whiteLevel) {
+        // Fixed-point bin width; samples are clamped to the white level first,
+        // so the bin index stays below HISTOGRAM_BINS
+        const uint32_t binScale = (FrameStats::HISTOGRAM_BINS << 16) / (static_cast<uint32_t>(whiteLevel) + 1);
+        for (uint32_t r = 0; r < rowCount; ++r) {
+            const uint16_t* row = rows + static_cast<size_t>(r) * width;
+            const int base = static_cast<int>((firstRow + r) & 1) * 2;
+            for (uint32_t x = 0; x < width; ++x) {
+                const int c = base + static_cast<int>(x & 1);
+                const uint16_t v = row[x];
+                sum[c] += v;
+                min[c] = std::min(min[c], v);
+                max[c] = std::max(max[c], v);
+                clipped[c] += (v >= whiteLevel);
+                histogram[c][(std::min(v, whiteLevel) * binScale) >> 16]++;
+            }
+            count[base] += (width + 1) / 2;
+            count[base + 1] += width / 2;
+        }
+    }
 
-struct SimpleFileHeader {
-    char magic[4];              // "MRAW"
-    uint32_t version;           // 2
-    uint32_t width;
-    uint32_t height;
-    uint8_t bayer_pattern;
-    uint8_t encoding;
-    uint8_t compression;
-    uint8_t reserved1;
-    uint16_t black_level[4];
-    uint16_t white_level;
-    uint16_t reserved2;
-    uint32_t frame_count;
-    uint64_t index_offset;
-
-    // V2 fields
-    uint32_t native_width;
-    uint32_t native_height;
-    uint32_t binning_num;
-    uint32_t binning_den;
-
-    uint8_t has_audio;
-    uint8_t audio_channels;
-    uint8_t audio_bit_depth;
-    uint8_t reserved3;
-    uint32_t audio_sample_rate;
-    uint64_t audio_offset;
-    uint64_t audio_start_time_us;
-
-    uint8_t has_timecode;
-    uint8_t timecode_format;
-    uint8_t timecode_fps;
-    uint8_t timecode_drop_frame;
-    uint32_t timecode_start_frame;
-    uint8_t timecode_hours;
-    uint8_t timecode_minutes;
-    uint8_t timecode_seconds;
-    uint8_t timecode_frames;
-    uint8_t reserved_tc[4];
-
-    int32_t sensor_orientation;
-    uint8_t reserved[408];
-};
+    void merge(const StatsAccumulator& other) {
+        for (int c = 0; c < 4; ++c) {
+            sum[c] += other.sum[c];
+            count[c] += other.count[c];
+            min[c] = std::min(min[c], other.min[c]);
+            max[c] = std::max(max[c], other.max[c]);
+            clipped[c] += other.clipped[c];
+            for (uint32_t b = 0; b < FrameStats::HISTOGRAM_BINS; ++b) {
+                histogram[c][b] += other.histogram[c][b];
+            }
+        }
+    }
 
-struct AudioStreamHeader {
-    char magic[4];              // "MAUD"
-    uint32_t version;
-    uint32_t sample_rate;
-    uint16_t channels;
-    uint16_t bit_depth;
-    uint64_t sample_count;
-    uint64_t start_timestamp_us;
-    uint8_t reserved[32];
+    void finish(FrameStats& stats) const {
+        for (int c = 0; c < 4; ++c) {
+            FrameStats::Channel& ch = stats.channels[c];
+            ch.min = count[c] ? min[c] : 0;
+            ch.max = max[c];
+            ch.mean = count[c] ? static_cast<float>(static_cast<double>(sum[c]) / count[c]) : 0.0f;
+            ch.clipped = clipped[c];
+            memcpy(ch.histogram, histogram[c], sizeof(ch.histogram));
+        }
+    }
 };
 
-#pragma pack(pop)
+} // namespace
 
 VrawWriter::VrawWriter()
-    : outputFile_(nullptr),
-      isRecording_(false),
-      usingFd_(false),
-      outputFd_(-1),
+    : isRecording_(false),
       width_(0),
       height_(0),
       nativeWidth_(0),
@@ -112,27 +109,49 @@ VrawWriter::VrawWriter()
       compression_(Compression::NONE),
       writePacked_(false),
       useCompression_(false),
+      pipeline_(nullptr),
       binningNum_(1),
       binningDen_(1),
       frameNumber_(0),
       bytesWritten_(0),
+      bayerPattern_(BayerPattern::RGGB),
+      storageLayout_(FrameLayout::MOSAIC),
+      subtractBlackLevel_(false),
+      chunkSamples_(0),
+      encodeThreads_(0),
+      frameStatsEnabled_(false),
       blackLevel_{64, 64, 64, 64},
       whiteLevel_(4095),
       sensorOrientation_(0),
       audioEnabled_(false),
       audioSampleRate_(48000),
       audioChannels_(2),
-      audioStartTime_(0) {
+      audioStartTime_(0),
+      audioPeakFill_(0),
+      preRollEnabled_(false),
+      preRollDurationUs_(0),
+      preRollMaxBytes_(0),
+      preRollBytes_(0),
+      preRollLiveBytes_(0),
+      flushingPreRoll_(false),
+      preRollFailed_(false),
+      preRollWriteFailed_(false),
+      liveFramesLost_(0),
+      syncedUpTo_(0),
+      stopSync_(false),
+      syncCount_(0),
+      droppedCacheBytes_(0) {
 }
 
 VrawWriter::~VrawWriter() {
     if (isRecording_) {
         stop();
     }
-    if (outputFile_) {
-        fclose(outputFile_);
-        outputFile_ = nullptr;
+    if (preRollThread_.joinable()) {
+        preRollThread_.join();
     }
+    stopSyncThread();
+    sink_.reset();
 }
 
 bool VrawWriter::init(uint32_t width, uint32_t height, const std::string& outputPath,
@@ -141,7 +160,7 @@ bool VrawWriter::init(uint32_t width, uint32_t height, const std::string& output
                       const uint16_t* blackLevel, uint16_t whiteLevel,
                       int32_t sensorOrientation,
                       uint32_t nativeWidth, uint32_t nativeHeight) {
-    if (outputFile_) {
+    if (sink_) {
         LOGE("Writer already initialized");
         return false;
     }
@@ -150,25 +169,15 @@ bool VrawWriter::init(uint32_t width, uint32_t height, const std::string& output
         return false;
     }
 
-    usingFd_ = false;
-    outputFd_ = -1;
-
-    outputFile_ = fopen(outputPath.c_str(), "wb");
-    if (!outputFile_) {
+    std::unique_ptr<FileSink> file(new FileSink());
+    if (!file->open(outputPath)) {
         LOGE("Failed to open file: %s", outputPath.c_str());
         return false;
     }
 
-    if (!initCommon(width, height, outputPath, encoding, usePacking, useCompression,
-                    bayerPattern, blackLevel, whiteLevel, sensorOrientation,
-                    nativeWidth, nativeHeight)) {
-        fclose(outputFile_);
-        outputFile_ = nullptr;
-        return false;
-    }
-
-    LOGI("Initialized writer: %s (%ux%u)", outputPath.c_str(), width, height);
-    return true;
+    return initWithSink(std::move(file), width, height, outputPath, encoding, usePacking,
+                        useCompression, bayerPattern, blackLevel, whiteLevel,
+                        sensorOrientation, nativeWidth, nativeHeight);
 }
 
 bool VrawWriter::initWithFd(int fd, uint32_t width, uint32_t height, const std::string& displayPath,
@@ -177,7 +186,7 @@ bool VrawWriter::initWithFd(int fd, uint32_t width, uint32_t height, const std::
                             const uint16_t* blackLevel, uint16_t whiteLevel,
                             int32_t sensorOrientation,
                             uint32_t nativeWidth, uint32_t nativeHeight) {
-    if (outputFile_) {
+    if (sink_) {
         LOGE("Writer already initialized");
         return false;
     }
@@ -190,24 +199,48 @@ bool VrawWriter::initWithFd(int fd, uint32_t width, uint32_t height, const std::
         return false;
     }
 
-    usingFd_ = true;
-    outputFd_ = fd;
-
-    outputFile_ = fdopen(fd, "wb");
-    if (!outputFile_) {
+    std::unique_ptr<FileSink> file(new FileSink());
+    if (!file->openFd(fd)) {
         LOGE("Failed to fdopen descriptor: %d", fd);
         return false;
     }
 
-    if (!initCommon(width, height, displayPath, encoding, usePacking, useCompression,
+    LOGI("Using fd=%d for %s", fd, displayPath.c_str());
+    return initWithSink(std::move(file), width, height, displayPath, encoding, usePacking,
+                        useCompression, bayerPattern, blackLevel, whiteLevel,
+                        sensorOrientation, nativeWidth, nativeHeight);
+}
+
+bool VrawWriter::initWithSink(std::unique_ptr<OutputSink> sink,
+                              uint32_t width, uint32_t height, const std::string& displayName,
+                              Encoding encoding, bool usePacking, bool useCompression,
+                              BayerPattern bayerPattern,
+                              const uint16_t* blackLevel, uint16_t whiteLevel,
+                              int32_t sensorOrientation,
+                              uint32_t nativeWidth, uint32_t nativeHeight) {
+    if (sink_) {
+        LOGE("Writer already initialized");
+        return false;
+    }
+    if (!sink || sink->size() != 0) {
+        LOGE("Invalid output sink");
+        return false;
+    }
+    if (width == 0 || height == 0) {
+        LOGE("Invalid parameters: width=%u height=%u", width, height);
+        return false;
+    }
+
+    sink_ = std::move(sink);
+
+    if (!initCommon(width, height, displayName, encoding, usePacking, useCompression,
                     bayerPattern, blackLevel, whiteLevel, sensorOrientation,
                     nativeWidth, nativeHeight)) {
-        fclose(outputFile_);
-        outputFile_ = nullptr;
+        sink_.reset();
         return false;
     }
 
-    LOGI("Initialized writer with fd=%d: %s (%ux%u)", fd, displayPath.c_str(), width, height);
+    LOGI("Initialized writer: %s (%ux%u)", displayName.c_str(), width, height);
     return true;
 }
 
@@ -245,8 +278,18 @@ bool VrawWriter::initCommon(uint32_t width, uint32_t height, const std::string&
 
     writePacked_ = usePacking;
     useCompression_ = useCompression;
+    bayerPattern_ = bayerPattern;
+    storageLayout_ = FrameLayout::MOSAIC;
+    subtractBlackLevel_ = false;
+    chunkSamples_ = 0;
+    frameStatsEnabled_ = false;
     compression_ = useCompression ? Compression::LZ4_FAST : Compression::NONE;
 
+    // Resolve the sample pipeline once; per-frame work is then branch-free
+    pipeline_ = &detail::selectEncodePipeline(encoding_, writePacked_, useCompression_);
+    const uint16_t avgBlackLevel = (blackLevel_[0] + blackLevel_[1] + blackLevel_[2] + blackLevel_[3]) / 4;
+    detail::buildLogTable(encoding_, avgBlackLevel, whiteLevel_, logTable_);
+
     frameNumber_ = 0;
     bytesWritten_ = 0;
 
@@ -298,7 +341,7 @@ bool VrawWriter::writeFileHeader(BayerPattern bayerPattern) {
 
     fh.sensor_orientation = sensorOrientation_;
 
-    if (fwrite(&fh, sizeof(SimpleFileHeader), 1, outputFile_) != 1) {
+    if (!sink_->append(&fh, sizeof(SimpleFileHeader))) {
         LOGE("Failed to write file header");
         return false;
     }
@@ -307,13 +350,107 @@ bool VrawWriter::writeFileHeader(BayerPattern bayerPattern) {
     return true;
 }
 
+bool VrawWriter::setStorageLayout(FrameLayout layout, bool subtractBlackLevel) {
+    if (!sink_ || isRecording_) {
+        return false;
+    }
+    if (layout == FrameLayout::CFA_PLANES && ((width_ | height_) & 1)) {
+        LOGE("Planar storage requires even dimensions: %ux%u", width_, height_);
+        return false;
+    }
+
+    // LOG encodings already remove the black level
+    const bool isLog = (encoding_ == Encoding::LOG2_10BIT || encoding_ == Encoding::LOG2_12BIT);
+    storageLayout_ = layout;
+    subtractBlackLevel_ = (layout == FrameLayout::CFA_PLANES) && subtractBlackLevel && !isLog;
+
+    // Patch the already written file header
+    uint8_t fields[2] = {
+        static_cast<uint8_t>(storageLayout_),
+        static_cast<uint8_t>(subtractBlackLevel_ ? STORAGE_FLAG_BLACK_SUBTRACTED : 0)
+    };
+    return sink_->writeAt(offsetof(SimpleFileHeader, storage_layout), fields, sizeof(fields));
+}
+
+bool VrawWriter::setChunkedEncoding(size_t maxScratchBytes) {
+    if (!sink_ || isRecording_) {
+        return false;
+    }
+    if (maxScratchBytes == 0) {
+        chunkSamples_ = 0;
+        return true;
+    }
+    if (maxScratchBytes < MIN_CHUNK_SCRATCH) {
+        LOGE("Chunked encoding needs at least %zu bytes of scratch", MIN_CHUNK_SCRATCH);
+        return false;
+    }
+    // Whole packing groups per band so bands concatenate to the full stream
+    const size_t samples = (maxScratchBytes - LZ4_DICT_BYTES) / CHUNK_BYTES_PER_SAMPLE;
+    chunkSamples_ = static_cast<uint32_t>(std::min<size_t>(samples, width_ * height_)) & ~3u;
+    return true;
+}
+
+bool VrawWriter::setEncodeThreads(unsigned threads) {
+    if (!sink_ || isRecording_) {
+        return false;
+    }
+    encodeThreads_ = threads;
+    return true;
+}
+
+bool VrawWriter::enableFrameStats(bool enable) {
+    if (!sink_ || isRecording_) {
+        return false;
+    }
+    frameStatsEnabled_ = enable;
+    return true;
+}
+
+size_t VrawWriter::getScratchBytes() const {
+    return packedBuffer_.capacity() + encodedBuffer_.capacity() * 2 +
+           compressedBuffer_.capacity() + planesBuffer_.capacity() * 2 +
+           chunkBuffer_.capacity() * 2 + chunkDict_.capacity() + mipiBuffer_.capacity() * 2;
+}
+
+bool VrawWriter::setDurabilityPolicy(const DurabilityPolicy& policy) {
+    if (!sink_ || isRecording_) {
+        return false;
+    }
+    if (policy.mode == DurabilityMode::PER_CHECKPOINT && policy.checkpointFrames == 0) {
+        LOGE("Checkpoint interval must be at least one frame");
+        return false;
+    }
+    durability_ = policy;
+    return true;
+}
+
 bool VrawWriter::start() {
-    if (!outputFile_ || isRecording_) {
+    if (!sink_ || isRecording_) {
         return false;
     }
     isRecording_ = true;
     frameNumber_ = 0;
     frameOffsets_.clear();
+    frameStats_.clear();
+
+    if (durability_.mode != DurabilityMode::NONE && !syncThread_.joinable()) {
+        syncedUpTo_ = 0;
+        lastSyncTime_ = std::chrono::steady_clock::now();
+        stopSync_ = false;
+        syncThread_ = std::thread(&VrawWriter::syncLoop, this);
+    }
+
+    // Write buffered pre-roll frames in the background so live capture
+    // never waits on them; live frames queue behind until the ring drains.
+    std::lock_guard<std::mutex> lock(preRollMutex_);
+    if (!preRollFrames_.empty()) {
+        LOGI("Flushing %zu pre-roll frames (%zu bytes)", preRollFrames_.size(), preRollBytes_);
+        flushingPreRoll_ = true;
+        preRollFailed_ = false;
+        preRollWriteFailed_ = false;
+        liveFramesLost_ = 0;
+        preRollThread_ = std::thread(&VrawWriter::flushPreRoll, this);
+    }
     return true;
 }
 
@@ -323,55 +460,278 @@ bool VrawWriter::submitFrame(const uint16_t* data,
                              float whiteBalanceG,
                              float whiteBalanceB,
                              const uint16_t* dynamicBlackLevel) {
-    if (!isRecording_ || !outputFile_ || !data) {
+    // Before start(), frames only go to the pre-roll ring
+    const bool buffering = !isRecording_ && preRollEnabled_;
+    if ((!isRecording_ && !buffering) || !sink_ || !data) {
         return false;
     }
 
+    // Chunked frames go straight to the sink, so only when nothing queues
+    if (chunkSamples_ > 0 && !buffering) {
+        bool flushing = false;
+        {
+            std::lock_guard<std::mutex> lock(preRollMutex_);
+            if (preRollWriteFailed_) {
+                return false;
+            }
+            flushing = flushingPreRoll_;
+        }
+        if (!flushing) {
+            return writeChunkedFrame(data, timestampUs, whiteBalanceR, whiteBalanceG,
+                                     whiteBalanceB, dynamicBlackLevel);
+        }
+    }
+
+    SimpleFrameHeader fh;
+    const uint8_t* payload = nullptr;
+    uint32_t payloadBytes = 0;
+    encodeFrame(data, timestampUs, whiteBalanceR, whiteBalanceG, whiteBalanceB,
+                dynamicBlackLevel, fh, payload, payloadBytes);
+
+    return submitEncodedFrame(fh, payload, payloadBytes,
+                              frameStatsEnabled_ ? &currentStats_ : nullptr, buffering);
+}
+
+bool VrawWriter::submitFrameMipi(const uint8_t* data,
+                                 uint32_t rowStride,
+                                 MipiFormat format,
+                                 uint64_t timestampUs,
+                                 float whiteBalanceR,
+                                 float whiteBalanceG,
+                                 float whiteBalanceB,
+                                 const uint16_t* dynamicBlackLevel) {
+    const bool buffering = !isRecording_ && preRollEnabled_;
+    if ((!isRecording_ && !buffering) || !sink_ || !data) {
+        return false;
+    }
+
+    const bool raw12 = (format == MipiFormat::RAW12);
+    const uint32_t groupPixels = raw12 ? 2 : 4;
+    const uint32_t groupBytes = raw12 ? 3 : 5;
+    if (width_ % groupPixels != 0) {
+        LOGE("MIPI %s needs a width that is a multiple of %u", raw12 ? "RAW12" : "RAW10", groupPixels);
+        return false;
+    }
+    const uint32_t groupsPerRow = width_ / groupPixels;
+    const uint32_t rowBytes = groupsPerRow * groupBytes;
+    if (rowStride == 0) {
+        rowStride = rowBytes;
+    }
+    if (rowStride < rowBytes) {
+        LOGE("MIPI row stride %u is shorter than a line (%u bytes)", rowStride, rowBytes);
+        return false;
+    }
+
+    // Same bit depth, linear, packed, mosaic: MIPI lines repack one to one
+    // into the stored stream, with no 16-bit frame in between
+    const Encoding direct = raw12 ? Encoding::LINEAR_12BIT : Encoding::LINEAR_10BIT;
+    if (encoding_ == direct && pipeline_->pack && storageLayout_ == FrameLayout::MOSAIC &&
+        chunkSamples_ == 0) {
+        const uint32_t storedBytes = rowBytes * height_;
+        ensurePackedCapacity(storedBytes);
+        StatsAccumulator stats;
+        if (frameStatsEnabled_ && mipiBuffer_.size() < width_) {
+            mipiBuffer_.resize(width_);
+        }
+        for (uint32_t y = 0; y < height_; ++y) {
+            const uint8_t* src = data + static_cast<size_t>(y) * rowStride;
+            uint8_t* dst = packedBuffer_.data() + static_cast<size_t>(y) * rowBytes;
+            if (raw12) {
+                detail::mipiRaw12ToPacked(src, dst, groupsPerRow);
+            } else {
+                detail::mipiRaw10ToPacked(src, dst, groupsPerRow);
+            }
+            if (frameStatsEnabled_) {
+                // The line is still in cache; unpack it once more for statistics
+                if (raw12) {
+                    detail::unpackMipiRaw12(src, mipiBuffer_.data(), groupsPerRow);
+                } else {
+                    detail::unpackMipiRaw10(src, mipiBuffer_.data(), groupsPerRow);
+                }
+                stats.addRows(mipiBuffer_.data(), width_, y, 1, whiteLevel_);
+            }
+        }
+        if (frameStatsEnabled_) {
+            stats.finish(currentStats_);
+        }
+
+        SimpleFrameHeader fh = SimpleFrameHeader();
+        fh.uncompressed_size = storedBytes;
+        const uint8_t* payload = packedBuffer_.data();
+        uint32_t payloadBytes = storedBytes;
+        compressPayload(fh, payload, payloadBytes);
+        fillFrameHeader(fh, timestampUs, whiteBalanceR, whiteBalanceG, whiteBalanceB,
+                        dynamicBlackLevel ? dynamicBlackLevel : blackLevel_);
+        return submitEncodedFrame(fh, payload, payloadBytes,
+                                  frameStatsEnabled_ ? &currentStats_ : nullptr, buffering);
+    }
+
+    if (mipiBuffer_.size() < static_cast<size_t>(width_) * height_) {
+        mipiBuffer_.resize(static_cast<size_t>(width_) * height_);
+    }
+    for (uint32_t y = 0; y < height_; ++y) {
+        const uint8_t* src = data + static_cast<size_t>(y) * rowStride;
+        uint16_t* dst = mipiBuffer_.data() + static_cast<size_t>(y) * width_;
+        if (raw12) {
+            detail::unpackMipiRaw12(src, dst, groupsPerRow);
+        } else {
+            detail::unpackMipiRaw10(src, dst, groupsPerRow);
+        }
+    }
+    return submitFrame(mipiBuffer_.data(), timestampUs, whiteBalanceR, whiteBalanceG,
+                       whiteBalanceB, dynamicBlackLevel);
+}
+
+bool VrawWriter::submitEncodedFrame(SimpleFrameHeader& fh, const uint8_t* payload,
+                                    uint32_t payloadBytes, const FrameStats* stats, bool buffering) {
+    if (buffering) {
+        return pushPreRollFrame(fh, payload, payloadBytes, stats, PreRollPush::BUFFER) ==
+               PreRollQueued::YES;
+    }
+
+    // Live frames queue behind the pre-roll while it is being flushed
+    switch (pushPreRollFrame(fh, payload, payloadBytes, stats, PreRollPush::IF_FLUSHING)) {
+        case PreRollQueued::YES:
+            return true;
+        case PreRollQueued::REJECTED:
+            return false;
+        case PreRollQueued::NO:
+            break;
+    }
+
+    return writeEncodedFrame(fh, payload, payloadBytes, stats);
+}
+
+void VrawWriter::encodeFrame(const uint16_t* data,
+                             uint64_t timestampUs,
+                             float whiteBalanceR,
+                             float whiteBalanceG,
+                             float whiteBalanceB,
+                             const uint16_t* dynamicBlackLevel,
+                             SimpleFrameHeader& fh,
+                             const uint8_t*& payload,
+                             uint32_t& payloadSize) {
     const uint32_t pixelCount = width_ * height_;
 
     // Apply log encoding if required
     const uint16_t* dataToWrite = data;
-    if (encoding_ == Encoding::LOG2_10BIT || encoding_ == Encoding::LOG2_12BIT) {
+    if (pipeline_->encode) {
         ensureEncodedCapacity(pixelCount);
-        uint16_t avgBlackLevel = (blackLevel_[0] + blackLevel_[1] + blackLevel_[2] + blackLevel_[3]) / 4;
+        StatsAccumulator stats;
+        std::mutex statsMutex;
+        forEachBand(pixelCount, [&](uint32_t first, uint32_t count) {
+            if (!frameStatsEnabled_) {
+                pipeline_->encode(data + first, encodedBuffer_.data() + first, count, logTable_.data());
+                return;
+            }
+            // Gather statistics row by row, just ahead of encoding the row
+            StatsAccumulator band;
+            for (uint32_t row = first; row < first + count; row += width_) {
+                band.addRows(data + row, width_, row / width_, 1, whiteLevel_);
+                pipeline_->encode(data + row, encodedBuffer_.data() + row, width_, logTable_.data());
+            }
+            std::lock_guard<std::mutex> lock(statsMutex);
+            stats.merge(band);
+        });
+        stats.finish(currentStats_);
+        dataToWrite = encodedBuffer_.data();
+    }
 
-        if (encoding_ == Encoding::LOG2_12BIT) {
-            encodeLog12Bit(data, encodedBuffer_.data(), pixelCount, avgBlackLevel, whiteLevel_);
+    // Linear frames gather statistics in the pass that splits or packs them;
+    // only a frame stored as it is needs a pass of its own
+    bool statsPending = frameStatsEnabled_ && !pipeline_->encode;
+    if (statsPending && !pipeline_->pack && storageLayout_ == FrameLayout::MOSAIC) {
+        collectFrameStats(data);
+        statsPending = false;
+    }
+
+    const uint16_t* frameBlackLevel = dynamicBlackLevel ? dynamicBlackLevel : blackLevel_;
+
+    // Reorder into R, G1, G2, B planes for planar storage
+    if (storageLayout_ == FrameLayout::CFA_PLANES) {
+        ensurePlanesCapacity(pixelCount);
+        if (statsPending) {
+            uint16_t* byPosition[4];
+            detail::cfaPlanesByPosition(bayerPattern_, planesBuffer_.data(), pixelCount / 4, byPosition);
+            const uint32_t planeW = width_ / 2;
+            collectFrameStats(dataToWrite, [&](uint32_t first, uint32_t count) {
+                const uint32_t end = std::min((first + count) / width_, height_ & ~1u);
+                for (uint32_t y = first / width_; y < end; ++y) {
+                    const size_t outRow = static_cast<size_t>(y / 2) * planeW;
+                    const int rowPos = (y & 1) * 2;
+                    detail::deinterleaveRow(dataToWrite + static_cast<size_t>(y) * width_,
+                                            byPosition[rowPos] + outRow, byPosition[rowPos + 1] + outRow,
+                                            planeW);
+                }
+            });
+            statsPending = false;
         } else {
-            encodeLog10Bit(data, encodedBuffer_.data(), pixelCount, avgBlackLevel, whiteLevel_);
+            detail::mosaicToPlanes(dataToWrite, width_, height_, bayerPattern_, planesBuffer_.data());
         }
-        dataToWrite = encodedBuffer_.data();
+        if (subtractBlackLevel_) {
+            const uint16_t mask = pipeline_->mask;
+            const size_t planeSize = pixelCount / 4;
+            for (int plane = 0; plane < 4; ++plane) {
+                const int pos = detail::cfaPlanePosition(bayerPattern_, plane);
+                const uint16_t black = frameBlackLevel[pos] & mask;
+                detail::offsetSamples(planesBuffer_.data() + plane * planeSize, planeSize,
+                                      static_cast<uint16_t>((mask + 1 - black) & mask), mask);
+            }
+        }
+        dataToWrite = planesBuffer_.data();
     }
 
-    uint64_t frame_offset = bytesWritten_;
-    frameOffsets_.push_back(frame_offset);
-
-    SimpleFrameHeader fh = {};
-    fh.timestamp_us = timestampUs;
-    fh.frame_number = frameNumber_++;
+    fh = SimpleFrameHeader();
     fh.uncompressed_size = pixelCount * 2;
     uint32_t payloadBytes = fh.uncompressed_size;
     const uint8_t* dataToWriteBytes = reinterpret_cast<const uint8_t*>(dataToWrite);
 
     // Bit-packing
-    if (writePacked_) {
-        if (encoding_ == Encoding::LOG2_12BIT || encoding_ == Encoding::LINEAR_12BIT) {
-            payloadBytes = packFrame12Bit(dataToWrite, pixelCount);
+    if (pipeline_->pack) {
+        if (statsPending) {
+            payloadBytes = pipeline_->storedBytes(pixelCount);
+            ensurePackedCapacity(payloadBytes);
+            collectFrameStats(dataToWrite, [&](uint32_t first, uint32_t count) {
+                pipeline_->pack(dataToWrite + first, count, packedBuffer_.data() + pipeline_->storedBytes(first));
+            });
         } else {
-            payloadBytes = packFrame10Bit(dataToWrite, pixelCount);
+            payloadBytes = packSamples(dataToWrite, pixelCount);
         }
         dataToWriteBytes = packedBuffer_.data();
         fh.uncompressed_size = payloadBytes;
     }
 
-    // LZ4 compression
+    compressPayload(fh, dataToWriteBytes, payloadBytes);
+    fillFrameHeader(fh, timestampUs, whiteBalanceR, whiteBalanceG, whiteBalanceB, frameBlackLevel);
+
+    payload = dataToWriteBytes;
+    payloadSize = payloadBytes;
+}
+
+void VrawWriter::fillFrameHeader(SimpleFrameHeader& fh, uint64_t timestampUs,
+                                 float whiteBalanceR, float whiteBalanceG, float whiteBalanceB,
+                                 const uint16_t* frameBlackLevel) {
+    fh.timestamp_us = timestampUs;
+    fh.iso = 100.0f;
+    fh.exposure_time_ms = 16.67f;
+    fh.white_balance_r = whiteBalanceR;
+    fh.white_balance_g = whiteBalanceG;
+    fh.white_balance_b = whiteBalanceB;
+
+    for (int i = 0; i < 4; ++i) {
+        fh.dynamic_black_level[i] = frameBlackLevel[i];
+    }
+}
+
+void VrawWriter::compressPayload(SimpleFrameHeader& fh, const uint8_t*& payload, uint32_t& payloadBytes) {
+    // LZ4 compression; frames that do not shrink are stored as they are
     if (useCompression_) {
         ensureCompressedCapacity(payloadBytes);
         fh.uncompressed_size = payloadBytes;
 
         int maxCompressedSize = LZ4_compressBound(payloadBytes);
         int compressedSize = LZ4_compress_default(
-            reinterpret_cast<const char*>(dataToWriteBytes),
+            reinterpret_cast<const char*>(payload),
             reinterpret_cast<char*>(compressedBuffer_.data()),
             payloadBytes,
             maxCompressedSize
@@ -379,7 +739,7 @@ bool VrawWriter::submitFrame(const uint16_t* data,
 
         if (compressedSize > 0 && static_cast<uint32_t>(compressedSize) < payloadBytes) {
             fh.compressed_size = compressedSize;
-            dataToWriteBytes = compressedBuffer_.data();
+            payload = compressedBuffer_.data();
             payloadBytes = compressedSize;
         } else {
             fh.compressed_size = 0;
@@ -387,41 +747,503 @@ bool VrawWriter::submitFrame(const uint16_t* data,
     } else {
         fh.compressed_size = writePacked_ ? payloadBytes : 0;
     }
+}
 
-    fh.iso = 100.0f;
-    fh.exposure_time_ms = 16.67f;
-    fh.white_balance_r = whiteBalanceR;
-    fh.white_balance_g = whiteBalanceG;
-    fh.white_balance_b = whiteBalanceB;
+void VrawWriter::produceStoredSamples(const uint16_t* data, uint32_t first, uint32_t count,
+                                      const uint16_t* frameBlackLevel, uint16_t* out) {
+    // Samples [first, first + count) of the stored stream, as encodeFrame() lays it out
+    const bool planar = (storageLayout_ == FrameLayout::CFA_PLANES);
+    const uint32_t planeW = width_ / 2;
+    const uint32_t planeSize = planeW * (height_ / 2);
+    if (planar) {
+        uint32_t i = 0;
+        while (i < count) {
+            const uint32_t s = first + i;
+            const int plane = static_cast<int>(s / planeSize);
+            const uint32_t r = (s % planeSize) / planeW;
+            const uint32_t c = (s % planeSize) % planeW;
+            const int pos = detail::cfaPlanePosition(bayerPattern_, plane);
+            const uint16_t* row = data + static_cast<size_t>(2 * r + pos / 2) * width_ + (pos & 1);
+            const uint32_t run = std::min(count - i, planeW - c);
+            for (uint32_t k = 0; k < run; ++k) {
+                out[i + k] = row[2 * (c + k)];
+            }
+            i += run;
+        }
+    } else {
+        memcpy(out, data + first, static_cast<size_t>(count) * 2);
+    }
 
-    if (dynamicBlackLevel) {
-        for (int i = 0; i < 4; ++i) {
-            fh.dynamic_black_level[i] = dynamicBlackLevel[i];
+    if (pipeline_->encode) {
+        pipeline_->encode(out, out, count, logTable_.data());
+    }
+
+    if (planar && subtractBlackLevel_) {
+        const uint16_t mask = pipeline_->mask;
+        uint32_t i = 0;
+        while (i < count) {
+            const int plane = static_cast<int>((first + i) / planeSize);
+            const uint32_t end = std::min(count, (plane + 1) * planeSize - first);
+            const uint16_t black = frameBlackLevel[detail::cfaPlanePosition(bayerPattern_, plane)] & mask;
+            detail::offsetSamples(out + i, end - i, static_cast<uint16_t>((mask + 1 - black) & mask), mask);
+            i = end;
+        }
+    }
+}
+
+void VrawWriter::collectFrameStats(const uint16_t* data,
+                                   const std::function<void(uint32_t, uint32_t)>& consume) {
+    StatsAccumulator stats;
+    std::mutex statsMutex;
+    forEachBand(width_ * height_, [&](uint32_t first, uint32_t count) {
+        StatsAccumulator band;
+        if (!consume) {
+            band.addRows(data + first, width_, first / width_, count / width_, whiteLevel_);
+        }
+        // Four rows at a time keeps each step on whole packing groups
+        const uint32_t step = 4 * width_;
+        for (uint32_t done = 0; consume && done < count; done += step) {
+            const uint32_t n = std::min(step, count - done);
+            band.addRows(data + first + done, width_, (first + done) / width_, n / width_, whiteLevel_);
+            consume(first + done, n);
         }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.merge(band);
+    });
+    stats.finish(currentStats_);
+}
+
+bool VrawWriter::writeChunkedFrame(const uint16_t* data, uint64_t timestampUs,
+                                   float whiteBalanceR, float whiteBalanceG, float whiteBalanceB,
+                                   const uint16_t* dynamicBlackLevel) {
+    const uint32_t pixelCount = width_ * height_;
+    const uint16_t* frameBlackLevel = dynamicBlackLevel ? dynamicBlackLevel : blackLevel_;
+    SimpleFrameHeader fh = SimpleFrameHeader();
+    fillFrameHeader(fh, timestampUs, whiteBalanceR, whiteBalanceG, whiteBalanceB, frameBlackLevel);
+    fh.uncompressed_size = pipeline_->storedBytes(pixelCount);
+    if (useCompression_) {
+        fh.reserved[0] |= FRAME_FLAG_CHUNKED;  // compressed_size patched below
     } else {
-        for (int i = 0; i < 4; ++i) {
-            fh.dynamic_black_level[i] = blackLevel_[i];
+        fh.compressed_size = writePacked_ ? fh.uncompressed_size : 0;
+    }
+
+    if (frameStatsEnabled_) {
+        collectFrameStats(data);
+        frameStats_.push_back(currentStats_);
+    }
+
+    const uint64_t frameOffset = bytesWritten_;
+    frameOffsets_.push_back(frameOffset);
+    fh.frame_number = frameNumber_++;
+    if (!sink_->append(&fh, sizeof(SimpleFrameHeader))) {
+        return false;
+    }
+    bytesWritten_ += sizeof(SimpleFrameHeader);
+
+    if (chunkBuffer_.size() < chunkSamples_) {
+        chunkBuffer_.resize(chunkSamples_);
+    }
+    LZ4_stream_t stream;
+    if (useCompression_) {
+        LZ4_initStream(&stream, sizeof(stream));
+        chunkDict_.resize(LZ4_DICT_BYTES);
+    }
+
+    uint32_t payloadBytes = 0;
+    for (uint32_t first = 0; first < pixelCount; first += chunkSamples_) {
+        const uint32_t count = std::min(chunkSamples_, pixelCount - first);
+        produceStoredSamples(data, first, count, frameBlackLevel, chunkBuffer_.data());
+
+        const uint8_t* band = reinterpret_cast<const uint8_t*>(chunkBuffer_.data());
+        uint32_t bandBytes = count * 2;
+        if (pipeline_->pack) {
+            bandBytes = packSamples(chunkBuffer_.data(), count);
+            band = packedBuffer_.data();
         }
+
+        if (useCompression_) {
+            // Next block of one LZ4 stream; history survives in chunkDict_
+            const int bound = LZ4_compressBound(static_cast<int>(bandBytes));
+            if (compressedBuffer_.size() < sizeof(FrameChunkHeader) + bound) {
+                compressedBuffer_.resize(sizeof(FrameChunkHeader) + bound);
+            }
+            const int compressedSize = LZ4_compress_fast_continue(
+                &stream,
+                reinterpret_cast<const char*>(band),
+                reinterpret_cast<char*>(compressedBuffer_.data() + sizeof(FrameChunkHeader)),
+                static_cast<int>(bandBytes), bound, 1);
+            if (compressedSize <= 0) {
+                LOGE("Chunk compression failed");
+                return false;
+            }
+            LZ4_saveDict(&stream, reinterpret_cast<char*>(chunkDict_.data()), LZ4_DICT_BYTES);
+
+            FrameChunkHeader chunk = {static_cast<uint32_t>(compressedSize), bandBytes};
+            memcpy(compressedBuffer_.data(), &chunk, sizeof(chunk));
+            band = compressedBuffer_.data();
+            bandBytes = sizeof(chunk) + compressedSize;
+        }
+
+        if (!sink_->append(band, bandBytes)) {
+            return false;
+        }
+        bytesWritten_ += bandBytes;
+        payloadBytes += bandBytes;
+    }
+
+    if (useCompression_ &&
+        !sink_->writeAt(frameOffset + offsetof(SimpleFrameHeader, compressed_size),
+                        &payloadBytes, sizeof(payloadBytes))) {
+        return false;
+    }
+
+    if (durability_.mode != DurabilityMode::NONE) {
+        scheduleSync();
     }
+    return true;
+}
+
+bool VrawWriter::writeEncodedFrame(SimpleFrameHeader& fh, const uint8_t* payload,
+                                   uint32_t payloadBytes, const FrameStats* stats) {
+    uint64_t frame_offset = bytesWritten_;
+    frameOffsets_.push_back(frame_offset);
+    if (frameStatsEnabled_) {
+        frameStats_.push_back(stats ? *stats : FrameStats());
+    }
+    fh.frame_number = frameNumber_++;
 
-    if (fwrite(&fh, sizeof(SimpleFrameHeader), 1, outputFile_) != 1) {
+    if (!sink_->append(&fh, sizeof(SimpleFrameHeader))) {
         return false;
     }
     bytesWritten_ += sizeof(SimpleFrameHeader);
 
-    if (fwrite(dataToWriteBytes, 1, payloadBytes, outputFile_) != payloadBytes) {
+    if (!sink_->append(payload, payloadBytes)) {
         return false;
     }
     bytesWritten_ += payloadBytes;
 
+    if (durability_.mode != DurabilityMode::NONE) {
+        scheduleSync();
+    }
     return true;
 }
 
+void VrawWriter::scheduleSync() {
+    // Runs on whichever thread writes frames; only queues work
+    const auto now = std::chrono::steady_clock::now();
+    bool durable = true;
+    if (durability_.mode == DurabilityMode::PERIODIC) {
+        const uint64_t pending = bytesWritten_ - syncedUpTo_;
+        bool due = durability_.syncBytes > 0 && pending >= durability_.syncBytes;
+        if (!due && durability_.syncIntervalMs > 0) {
+            due = now - lastSyncTime_ >= std::chrono::milliseconds(durability_.syncIntervalMs);
+        }
+        if (!due) {
+            return;
+        }
+        durable = durability_.dataSync;
+    } else if (frameNumber_ % durability_.checkpointFrames != 0) {
+        return;
+    }
+
+    // Recovery scans up to the header frame count when the index is missing,
+    // so every synced range carries the count of the frames it completes
+    uint32_t frameCount = frameNumber_;
+    sink_->writeAt(offsetof(SimpleFileHeader, frame_count), &frameCount, sizeof(frameCount));
+
+    // The background thread works on the descriptor, so push stdio buffers first
+    sink_->flush();
+
+    std::lock_guard<std::mutex> lock(syncMutex_);
+    syncQueue_.push_back({syncedUpTo_, bytesWritten_ - syncedUpTo_, durable});
+    syncedUpTo_ = bytesWritten_;
+    lastSyncTime_ = now;
+    syncCv_.notify_one();
+}
+
+void VrawWriter::syncLoop() {
+    SyncRequest previous = {0, 0, false};
+    // Never evict the header page: every sync patches frame_count into it,
+    // and a dropped page would turn that write into a read on the capture
+    // thread. The kernel rounds the start up, so the header's page stays.
+    uint64_t droppedUpTo = sizeof(SimpleFileHeader);
+    bool failed = false;
+
+    for (;;) {
+        SyncRequest request;
+        {
+            std::unique_lock<std::mutex> lock(syncMutex_);
+            syncCv_.wait(lock, [this] { return stopSync_ || !syncQueue_.empty(); });
+            if (syncQueue_.empty()) {
+                return;
+            }
+            request = syncQueue_.front();
+            syncQueue_.pop_front();
+        }
+
+        // Start writeback of the new range, then wait for the previous one so
+        // at most two ranges of dirty pages are ever outstanding
+        bool ok = sink_->syncRange(request.offset, request.size, false);
+        if (previous.size > 0) {
+            ok = sink_->syncRange(previous.offset, previous.size, true) && ok;
+        }
+        if (request.durable) {
+            ok = sink_->dataSync() && ok;
+        }
+
+        // Footage written behind us will not be read back here; keep it
+        // from evicting other processes' caches
+        const uint64_t cleanEnd = request.durable ? request.offset + request.size
+                                                  : previous.offset + previous.size;
+        if (ok && durability_.dropSyncedPages && cleanEnd > droppedUpTo) {
+            if (sink_->dropCache(droppedUpTo, cleanEnd - droppedUpTo)) {
+                droppedCacheBytes_ += cleanEnd - droppedUpTo;
+                droppedUpTo = cleanEnd;
+            }
+        }
+        previous = request;
+
+        if (ok) {
+            syncCount_++;
+        } else if (!failed) {
+            LOGE("Background sync failed: %s", outputPath_.c_str());
+            failed = true;
+        }
+    }
+}
+
+void VrawWriter::stopSyncThread() {
+    if (!syncThread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(syncMutex_);
+        stopSync_ = true;
+    }
+    syncCv_.notify_one();
+    syncThread_.join();
+}
+
+bool VrawWriter::enablePreRoll(uint64_t durationUs, size_t maxBytes) {
+    if (!sink_ || isRecording_ || maxBytes == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(preRollMutex_);
+    preRollEnabled_ = true;
+    preRollDurationUs_ = durationUs;
+    preRollMaxBytes_ = maxBytes;
+    return true;
+}
+
+void VrawWriter::disablePreRoll() {
+    if (isRecording_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(preRollMutex_);
+    preRollEnabled_ = false;
+    preRollFrames_.clear();
+    preRollPool_.clear();
+    preRollBytes_ = 0;
+    preRollLiveBytes_ = 0;
+}
+
+uint32_t VrawWriter::getPreRollFrameCount() const {
+    std::lock_guard<std::mutex> lock(preRollMutex_);
+    return static_cast<uint32_t>(preRollFrames_.size());
+}
+
+size_t VrawWriter::getPreRollBytes() const {
+    std::lock_guard<std::mutex> lock(preRollMutex_);
+    return preRollBytes_;
+}
+
+VrawWriter::PreRollQueued VrawWriter::pushPreRollFrame(const SimpleFrameHeader& fh, const uint8_t* payload,
+                                                       uint32_t payloadBytes, const FrameStats* stats,
+                                                       PreRollPush mode) {
+    if (mode == PreRollPush::IF_FLUSHING) {
+        std::lock_guard<std::mutex> lock(preRollMutex_);
+        if (preRollWriteFailed_) {
+            return PreRollQueued::REJECTED;
+        }
+        if (!flushingPreRoll_) {
+            return PreRollQueued::NO;
+        }
+    }
+
+    // Keep the ring compressed even when the file itself is not
+    const uint8_t* stored = payload;
+    uint32_t storedBytes = payloadBytes;
+    bool ringCompressed = false;
+    if (!useCompression_) {
+        ensureCompressedCapacity(payloadBytes);
+        int compressedSize = LZ4_compress_default(
+            reinterpret_cast<const char*>(payload),
+            reinterpret_cast<char*>(compressedBuffer_.data()),
+            payloadBytes,
+            LZ4_compressBound(payloadBytes)
+        );
+        if (compressedSize > 0 && static_cast<uint32_t>(compressedSize) < payloadBytes) {
+            stored = compressedBuffer_.data();
+            storedBytes = compressedSize;
+            ringCompressed = true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(preRollMutex_);
+
+    // The flush may have drained in the meantime; the caller then writes directly.
+    // It never restarts, so the queue cannot be left holding a stranded frame.
+    if (mode == PreRollPush::IF_FLUSHING && preRollWriteFailed_) {
+        return PreRollQueued::REJECTED;
+    }
+    if (mode == PreRollPush::IF_FLUSHING && !flushingPreRoll_) {
+        return PreRollQueued::NO;
+    }
+    // A disk slower than capture must not grow the queue without bound
+    const size_t frameBytes = sizeof(SimpleFrameHeader) + storedBytes;
+    if (mode == PreRollPush::IF_FLUSHING && preRollLiveBytes_ + frameBytes > preRollMaxBytes_) {
+        LOGE("Pre-roll flush behind by %zu bytes, dropping live frame", preRollLiveBytes_);
+        return PreRollQueued::REJECTED;
+    }
+
+    PreRollFrame frame;
+    if (!preRollPool_.empty()) {
+        frame.data = std::move(preRollPool_.back());
+        preRollPool_.pop_back();
+    }
+    frame.data.resize(frameBytes);
+    memcpy(frame.data.data(), &fh, sizeof(SimpleFrameHeader));
+    memcpy(frame.data.data() + sizeof(SimpleFrameHeader), stored, storedBytes);
+    frame.payloadBytes = payloadBytes;
+    frame.ringCompressed = ringCompressed;
+    frame.hasStats = (stats != nullptr);
+    frame.live = (mode == PreRollPush::IF_FLUSHING);
+    if (stats) {
+        frame.stats = *stats;
+    }
+    preRollBytes_ += frame.data.size();
+    if (frame.live) {
+        preRollLiveBytes_ += frame.data.size();
+    }
+    preRollFrames_.push_back(std::move(frame));
+
+    if (mode == PreRollPush::BUFFER) {
+        // Drop the oldest frames beyond the memory or duration budget
+        const uint64_t newest = fh.timestamp_us;
+        uint64_t oldest = 0;
+        while (preRollFrames_.size() > 1) {
+            memcpy(&oldest, preRollFrames_.front().data.data() +
+                   offsetof(SimpleFrameHeader, timestamp_us), sizeof(oldest));
+            if (preRollBytes_ <= preRollMaxBytes_ &&
+                (preRollDurationUs_ == 0 || newest < oldest || newest - oldest <= preRollDurationUs_)) {
+                break;
+            }
+            preRollBytes_ -= preRollFrames_.front().data.size();
+            if (preRollPool_.size() < PRE_ROLL_POOL_SIZE) {
+                preRollPool_.push_back(std::move(preRollFrames_.front().data));
+            }
+            preRollFrames_.pop_front();
+        }
+    }
+    return PreRollQueued::YES;
+}
+
+void VrawWriter::flushPreRoll() {
+    std::vector<uint8_t> scratch;
+
+    for (;;) {
+        PreRollFrame frame;
+        {
+            std::lock_guard<std::mutex> lock(preRollMutex_);
+            if (preRollFrames_.empty() || preRollWriteFailed_) {
+                // Hand file writes back to submitFrame(); after a write error
+                // the queued live frames are lost, which stop() reports
+                for (const PreRollFrame& dropped : preRollFrames_) {
+                    liveFramesLost_ += dropped.live ? 1 : 0;
+                }
+                preRollFrames_.clear();
+                preRollBytes_ = 0;
+                preRollLiveBytes_ = 0;
+                flushingPreRoll_ = false;
+                return;
+            }
+            frame = std::move(preRollFrames_.front());
+            preRollFrames_.pop_front();
+            preRollBytes_ -= frame.data.size();
+            if (frame.live) {
+                preRollLiveBytes_ -= frame.data.size();
+            }
+        }
+
+        SimpleFrameHeader fh;
+        memcpy(&fh, frame.data.data(), sizeof(SimpleFrameHeader));
+        const uint8_t* stored = frame.data.data() + sizeof(SimpleFrameHeader);
+        const uint8_t* payload = stored;
+        if (frame.ringCompressed) {
+            scratch.resize(frame.payloadBytes);
+            int decompressed = LZ4_decompress_safe(
+                reinterpret_cast<const char*>(stored),
+                reinterpret_cast<char*>(scratch.data()),
+                static_cast<int>(frame.data.size() - sizeof(SimpleFrameHeader)),
+                frame.payloadBytes
+            );
+            if (decompressed != static_cast<int>(frame.payloadBytes)) {
+                std::lock_guard<std::mutex> lock(preRollMutex_);
+                preRollFailed_ = true;
+                if (frame.live) {
+                    LOGE("Queued live frame corrupt, dropping it");
+                    liveFramesLost_++;
+                    continue;
+                }
+                // Drop the rest of the pre-roll; live frames queued behind it
+                // were acknowledged and are still written
+                LOGE("Pre-roll frame corrupt, dropping remaining buffered frames");
+                for (auto it = preRollFrames_.begin(); it != preRollFrames_.end();) {
+                    if (it->live) {
+                        ++it;
+                        continue;
+                    }
+                    preRollBytes_ -= it->data.size();
+                    it = preRollFrames_.erase(it);
+                }
+                continue;
+            }
+            payload = scratch.data();
+        }
+
+        if (!writeEncodedFrame(fh, payload, frame.payloadBytes, frame.hasStats ? &frame.stats : nullptr)) {
+            LOGE("Failed to write pre-roll frame");
+            std::lock_guard<std::mutex> lock(preRollMutex_);
+            preRollFailed_ = true;
+            preRollWriteFailed_ = true;
+            liveFramesLost_ += frame.live ? 1 : 0;
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(preRollMutex_);
+        if (preRollPool_.size() < PRE_ROLL_POOL_SIZE) {
+            preRollPool_.push_back(std::move(frame.data));
+        }
+    }
+}
+
 bool VrawWriter::stop() {
-    if (!outputFile_ || !isRecording_) {
+    if (!sink_ || !isRecording_) {
         return false;
     }
 
+    // Pre-roll and queued live frames must land before the trailer
+    if (preRollThread_.joinable()) {
+        preRollThread_.join();
+    }
+    if (preRollFailed_) {
+        LOGE("Pre-roll flush failed; file may be missing buffered frames");
+    }
+    if (liveFramesLost_ > 0) {
+        LOGE("%u live frames queued behind the pre-roll were not written", liveFramesLost_);
+    }
+    const bool flushOk = !preRollWriteFailed_ && liveFramesLost_ == 0;
+
     uint32_t frame_count = frameNumber_;
 
     // Write audio stream if enabled
@@ -438,66 +1260,157 @@ bool VrawWriter::stop() {
         ash.sample_count = audioBuffer_.size() / audioChannels_;
         ash.start_timestamp_us = audioStartTime_;
 
-        if (fwrite(&ash, sizeof(AudioStreamHeader), 1, outputFile_) != 1) {
+        if (!sink_->append(&ash, sizeof(AudioStreamHeader))) {
             return false;
         }
         bytesWritten_ += sizeof(AudioStreamHeader);
 
         const size_t audioBytes = audioBuffer_.size() * sizeof(int16_t);
-        if (fwrite(audioBuffer_.data(), 1, audioBytes, outputFile_) != audioBytes) {
+        if (!sink_->append(audioBuffer_.data(), audioBytes)) {
             return false;
         }
         bytesWritten_ += audioBytes;
 
         // Update file header with audio info
-        fseek(outputFile_, offsetof(SimpleFileHeader, has_audio), SEEK_SET);
         uint8_t has_audio = 1;
-        fwrite(&has_audio, 1, 1, outputFile_);
+        sink_->writeAt(offsetof(SimpleFileHeader, has_audio), &has_audio, 1);
+        sink_->writeAt(offsetof(SimpleFileHeader, audio_offset), &audio_offset, sizeof(uint64_t));
+        sink_->writeAt(offsetof(SimpleFileHeader, audio_start_time_us), &audioStartTime_, sizeof(uint64_t));
+    }
 
-        fseek(outputFile_, offsetof(SimpleFileHeader, audio_offset), SEEK_SET);
-        fwrite(&audio_offset, sizeof(uint64_t), 1, outputFile_);
+    // Write index table and trailer in one go
+    uint64_t index_offset = bytesWritten_;
+    std::vector<uint8_t> trailer(frameOffsets_.size() * sizeof(uint64_t) + 16, 0);
+    if (!frameOffsets_.empty()) {
+        memcpy(trailer.data(), frameOffsets_.data(), frameOffsets_.size() * sizeof(uint64_t));
+    }
+    uint8_t* indexHeader = trailer.data() + frameOffsets_.size() * sizeof(uint64_t);
+    memcpy(indexHeader, "MIDX", 4);
+    memcpy(indexHeader + 4, &frame_count, sizeof(uint32_t));
+    if (!sink_->append(trailer.data(), trailer.size())) {
+        return false;
+    }
+    bytesWritten_ += trailer.size();
 
-        fseek(outputFile_, offsetof(SimpleFileHeader, audio_start_time_us), SEEK_SET);
-        fwrite(&audioStartTime_, sizeof(uint64_t), 1, outputFile_);
+    if (frameStatsEnabled_ && !writeStatsTable()) {
+        return false;
+    }
+    if (audio_offset != 0 && !writeAudioPeakTable()) {
+        return false;
+    }
 
-        fseek(outputFile_, 0, SEEK_END);
+    // Update file header
+    uint8_t counts[12];
+    memcpy(counts, &frame_count, sizeof(uint32_t));
+    memcpy(counts + 4, &index_offset, sizeof(uint64_t));
+    sink_->writeAt(offsetof(SimpleFileHeader, frame_count), counts, sizeof(counts));
+
+    sink_->flush();
+
+    // Drain queued writeback, then make the finished file durable
+    if (durability_.mode != DurabilityMode::NONE) {
+        stopSyncThread();
+        if (!sink_->sync()) {
+            LOGE("Failed to sync file: %s", outputPath_.c_str());
+        } else if (durability_.dropSyncedPages && sink_->dropCache(0, 0)) {
+            droppedCacheBytes_ = bytesWritten_.load();
+        }
     }
+    isRecording_ = false;
 
-    // Write index table
-    uint64_t index_offset = bytesWritten_;
-    for (uint64_t offset : frameOffsets_) {
-        if (fwrite(&offset, sizeof(uint64_t), 1, outputFile_) != 1) {
-            return false;
+    return flushOk;
+}
+
+bool VrawWriter::writeStatsTable() {
+    // Frames that failed mid-write may have left a record without a frame
+    const uint32_t count = static_cast<uint32_t>(std::min(frameStats_.size(), frameOffsets_.size()));
+    FrameStatsTableHeader th = {};
+    memcpy(th.magic, "MSTA", 4);
+    th.version = 1;
+    th.frame_count = count;
+    th.channels = 4;
+    th.histogram_bins = FrameStats::HISTOGRAM_BINS;
+    th.record_size = sizeof(FrameStatsRecord);
+
+    std::vector<uint8_t> table(sizeof(th) + static_cast<size_t>(count) * sizeof(FrameStatsRecord));
+    memcpy(table.data(), &th, sizeof(th));
+    for (uint32_t i = 0; i < count; ++i) {
+        FrameStatsRecord record;
+        for (int c = 0; c < 4; ++c) {
+            const FrameStats::Channel& ch = frameStats_[i].channels[c];
+            record.channels[c].min = ch.min;
+            record.channels[c].max = ch.max;
+            record.channels[c].mean = ch.mean;
+            record.channels[c].clipped = ch.clipped;
+            memcpy(record.channels[c].histogram, ch.histogram, sizeof(ch.histogram));
         }
-        bytesWritten_ += sizeof(uint64_t);
+        memcpy(table.data() + sizeof(th) + static_cast<size_t>(i) * sizeof(record), &record, sizeof(record));
     }
 
-    // Write index header
-    char index_magic[4] = {'M', 'I', 'D', 'X'};
-    fwrite(index_magic, 4, 1, outputFile_);
-    bytesWritten_ += 4;
-    fwrite(&frame_count, sizeof(uint32_t), 1, outputFile_);
-    bytesWritten_ += 4;
-    uint8_t padding[8] = {0};
-    fwrite(padding, 8, 1, outputFile_);
-    bytesWritten_ += 8;
+    const uint64_t statsOffset = bytesWritten_;
+    if (!sink_->append(table.data(), table.size())) {
+        return false;
+    }
+    bytesWritten_ += table.size();
+    return sink_->writeAt(offsetof(SimpleFileHeader, stats_offset), &statsOffset, sizeof(statsOffset));
+}
 
-    // Update file header
-    fseek(outputFile_, 32, SEEK_SET);
-    fwrite(&frame_count, sizeof(uint32_t), 1, outputFile_);
-    fwrite(&index_offset, sizeof(uint64_t), 1, outputFile_);
+bool VrawWriter::writeAudioPeakTable() {
+    // The partial peaks at the end cover the remaining samples
+    if (audioPeakFill_ > 0) {
+        appendAudioPeak();
+    }
+    const uint32_t ratio = AUDIO_PEAK_COARSE_BLOCK / AUDIO_PEAK_BLOCK;
+    const size_t finePeaks = audioPeaks_[0].size() / audioChannels_;
+    const size_t merged = audioPeaks_[1].size() / audioChannels_ * ratio;
+    if (merged < finePeaks) {
+        std::vector<AudioPeak> tail(audioPeaks_[0].begin() + merged * audioChannels_, audioPeaks_[0].end());
+        for (size_t i = audioChannels_; i < tail.size(); ++i) {
+            tail[i % audioChannels_].min = std::min(tail[i % audioChannels_].min, tail[i].min);
+            tail[i % audioChannels_].max = std::max(tail[i % audioChannels_].max, tail[i].max);
+        }
+        audioPeaks_[1].insert(audioPeaks_[1].end(), tail.begin(), tail.begin() + audioChannels_);
+    }
 
-    fflush(outputFile_);
-    isRecording_ = false;
+    const uint32_t blocks[2] = {AUDIO_PEAK_BLOCK, AUDIO_PEAK_COARSE_BLOCK};
+    AudioPeakTableHeader th = {};
+    memcpy(th.magic, "MPKS", 4);
+    th.version = 1;
+    th.channels = audioChannels_;
+    th.level_count = 2;
+    th.sample_count = audioBuffer_.size() / audioChannels_;
+
+    size_t dataOffset = sizeof(th) + 2 * sizeof(AudioPeakLevelRecord);
+    std::vector<uint8_t> table(dataOffset + (audioPeaks_[0].size() + audioPeaks_[1].size()) * sizeof(AudioPeakRecord));
+    memcpy(table.data(), &th, sizeof(th));
+    for (int level = 0; level < 2; ++level) {
+        AudioPeakLevelRecord lr = {};
+        lr.samples_per_peak = blocks[level];
+        lr.peak_count = static_cast<uint32_t>(audioPeaks_[level].size() / audioChannels_);
+        lr.data_offset = dataOffset;
+        memcpy(table.data() + sizeof(th) + level * sizeof(lr), &lr, sizeof(lr));
+
+        AudioPeakRecord* records = reinterpret_cast<AudioPeakRecord*>(table.data() + dataOffset);
+        for (size_t i = 0; i < audioPeaks_[level].size(); ++i) {
+            records[i].min = audioPeaks_[level][i].min;
+            records[i].max = audioPeaks_[level][i].max;
+        }
+        dataOffset += audioPeaks_[level].size() * sizeof(AudioPeakRecord);
+    }
 
-    return true;
+    const uint64_t peaksOffset = bytesWritten_;
+    if (!sink_->append(table.data(), table.size())) {
+        return false;
+    }
+    bytesWritten_ += table.size();
+    return sink_->writeAt(offsetof(SimpleFileHeader, audio_peaks_offset), &peaksOffset, sizeof(peaksOffset));
 }
 
 bool VrawWriter::flush() {
-    if (!outputFile_) {
+    if (!sink_) {
         return false;
     }
-    return fflush(outputFile_) == 0;
+    return sink_->flush();
 }
 
 bool VrawWriter::enableAudio(uint32_t sampleRate, uint16_t channels) {
@@ -511,6 +1424,10 @@ bool VrawWriter::enableAudio(uint32_t sampleRate, uint16_t channels) {
     audioStartTime_ = 0;
     audioBuffer_.clear();
     audioBuffer_.reserve(sampleRate * channels * 10);
+    audioPeaks_[0].clear();
+    audioPeaks_[1].clear();
+    audioPeakCurrent_.assign(channels, AudioPeak{INT16_MAX, INT16_MIN});
+    audioPeakFill_ = 0;
 
     return true;
 }
@@ -527,9 +1444,43 @@ bool VrawWriter::submitAudio(const int16_t* samples, uint32_t sampleCount, uint6
     const uint32_t totalSamples = sampleCount * audioChannels_;
     audioBuffer_.insert(audioBuffer_.end(), samples, samples + totalSamples);
 
+    // Extend the waveform overview; costs a compare per sample
+    for (uint32_t i = 0; i < sampleCount; ++i) {
+        const int16_t* frame = samples + static_cast<size_t>(i) * audioChannels_;
+        for (uint16_t c = 0; c < audioChannels_; ++c) {
+            audioPeakCurrent_[c].min = std::min(audioPeakCurrent_[c].min, frame[c]);
+            audioPeakCurrent_[c].max = std::max(audioPeakCurrent_[c].max, frame[c]);
+        }
+        if (++audioPeakFill_ == AUDIO_PEAK_BLOCK) {
+            appendAudioPeak();
+        }
+    }
+
     return true;
 }
 
+void VrawWriter::appendAudioPeak() {
+    audioPeaks_[0].insert(audioPeaks_[0].end(), audioPeakCurrent_.begin(), audioPeakCurrent_.end());
+    audioPeakCurrent_.assign(audioChannels_, AudioPeak{INT16_MAX, INT16_MIN});
+    audioPeakFill_ = 0;
+
+    // Every AUDIO_PEAK_COARSE_BLOCK samples, merge the fine peaks into a coarse one
+    const size_t ratio = AUDIO_PEAK_COARSE_BLOCK / AUDIO_PEAK_BLOCK;
+    const size_t finePeaks = audioPeaks_[0].size() / audioChannels_;
+    if (finePeaks % ratio != 0) {
+        return;
+    }
+    const AudioPeak* fine = audioPeaks_[0].data() + (finePeaks - ratio) * audioChannels_;
+    for (uint16_t c = 0; c < audioChannels_; ++c) {
+        AudioPeak peak = fine[c];
+        for (size_t i = 1; i < ratio; ++i) {
+            peak.min = std::min(peak.min, fine[i * audioChannels_ + c].min);
+            peak.max = std::max(peak.max, fine[i * audioChannels_ + c].max);
+        }
+        audioPeaks_[1].push_back(peak);
+    }
+}
+
 uint64_t VrawWriter::getAudioSampleCount() const {
     return audioEnabled_ ? (audioBuffer_.size() / audioChannels_) : 0;
 }
@@ -548,6 +1499,13 @@ bool VrawWriter::ensureEncodedCapacity(uint32_t pixelCount) {
     return true;
 }
 
+bool VrawWriter::ensurePlanesCapacity(uint32_t pixelCount) {
+    if (planesBuffer_.size() < pixelCount) {
+        planesBuffer_.resize(pixelCount);
+    }
+    return true;
+}
+
 bool VrawWriter::ensureCompressedCapacity(uint32_t uncompressedSize) {
     int maxSize = LZ4_compressBound(uncompressedSize);
     if (compressedBuffer_.size() < static_cast<size_t>(maxSize)) {
@@ -556,59 +1514,36 @@ bool VrawWriter::ensureCompressedCapacity(uint32_t uncompressedSize) {
     return true;
 }
 
-uint32_t VrawWriter::packFrame10Bit(const uint16_t* src, uint32_t pixelCount) {
-    const uint32_t packedBytes = (pixelCount * 10 + 7) / 8;
-    ensurePackedCapacity(packedBytes);
-    uint32_t outIdx = 0;
-    uint32_t bitBuffer = 0;
-    int bitCount = 0;
-    uint8_t* dst = packedBuffer_.data();
-
-    for (uint32_t i = 0; i < pixelCount; ++i) {
-        uint32_t sample = src[i] & 0x3FF;
-        bitBuffer |= sample << bitCount;
-        bitCount += 10;
-        while (bitCount >= 8) {
-            dst[outIdx++] = bitBuffer & 0xFF;
-            bitBuffer >>= 8;
-            bitCount -= 8;
-        }
-    }
-    if (bitCount > 0) {
-        dst[outIdx++] = bitBuffer & 0xFF;
-    }
-    if (outIdx < packedBytes) {
-        memset(dst + outIdx, 0, packedBytes - outIdx);
-    }
-
-    return packedBytes;
+uint32_t VrawWriter::packSamples(const uint16_t* src, uint32_t count) {
+    const uint32_t bytes = pipeline_->storedBytes(count);
+    ensurePackedCapacity(bytes);
+    // Bands start on whole packing groups, so each lands at its own byte offset
+    forEachBand(count, [&](uint32_t first, uint32_t n) {
+        pipeline_->pack(src + first, n, packedBuffer_.data() + pipeline_->storedBytes(first));
+    });
+    return bytes;
 }
 
-uint32_t VrawWriter::packFrame12Bit(const uint16_t* src, uint32_t pixelCount) {
-    const uint32_t packedBytes = (pixelCount * 3 + 1) / 2;
-    ensurePackedCapacity(packedBytes);
-    uint32_t outIdx = 0;
-    uint8_t* dst = packedBuffer_.data();
-
-    for (uint32_t i = 0; i < pixelCount; i += 2) {
-        uint16_t pixel1 = src[i] & 0xFFF;
-
-        if (i + 1 < pixelCount) {
-            uint16_t pixel2 = src[i + 1] & 0xFFF;
-            dst[outIdx++] = (pixel1 >> 4) & 0xFF;
-            dst[outIdx++] = ((pixel1 & 0xF) << 4) | ((pixel2 >> 8) & 0xF);
-            dst[outIdx++] = pixel2 & 0xFF;
-        } else {
-            dst[outIdx++] = (pixel1 >> 4) & 0xFF;
-            dst[outIdx++] = (pixel1 & 0xF) << 4;
-        }
+void VrawWriter::forEachBand(uint32_t count, const std::function<void(uint32_t, uint32_t)>& fn) {
+    const unsigned threads = encodeThreads_ ? encodeThreads_ : detail::defaultThreadCount();
+    if (threads <= 1 || count < PARALLEL_ENCODE_MIN_PIXELS || width_ == 0) {
+        fn(0, count);
+        return;
     }
-
-    if (outIdx < packedBytes) {
-        memset(dst + outIdx, 0, packedBytes - outIdx);
+    // The submitting thread is one of the encoders
+    if (!encodePool_ || encodePool_->size() != threads - 1) {
+        encodePool_.reset(new detail::ThreadPool(threads - 1));
     }
 
-    return packedBytes;
+    // A multiple of 4 rows keeps every band on whole packing groups
+    const uint32_t rows = (count + width_ - 1) / width_;
+    const uint32_t bandRows = ((rows + threads - 1) / threads + 3) & ~3u;
+    const uint32_t bandSamples = bandRows * width_;
+    const uint32_t bands = (count + bandSamples - 1) / bandSamples;
+    encodePool_->parallelFor(bands, [&](uint32_t band) {
+        const uint32_t first = band * bandSamples;
+        fn(first, std::min(bandSamples, count - first));
+    });
 }
 
 } // namespace vraw
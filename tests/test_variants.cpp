@@ -6,10 +6,18 @@
 
 #include <vraw.h>
 #include <Encoding.h>
+#include <BitPacking.h>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <string>
 #include <vector>
 
@@ -46,6 +54,12 @@ static const TestConfig testConfigs[] = {
     {"LOG2_12BIT, no compression, packing",      vraw::Encoding::LOG2_12BIT, false, true,  4095, 8},
     {"LOG2_12BIT, LZ4 compression, no packing",  vraw::Encoding::LOG2_12BIT, true,  false, 4095, 8},
     {"LOG2_12BIT, LZ4 compression, packing",     vraw::Encoding::LOG2_12BIT, true,  true,  4095, 8},
+
+    // LINEAR_14BIT variants
+    {"LINEAR_14BIT, no compression, no packing", vraw::Encoding::LINEAR_14BIT, false, false, 16383, 0},
+    {"LINEAR_14BIT, no compression, packing",    vraw::Encoding::LINEAR_14BIT, false, true,  16383, 0},
+    {"LINEAR_14BIT, LZ4 compression, no packing", vraw::Encoding::LINEAR_14BIT, true,  false, 16383, 0},
+    {"LINEAR_14BIT, LZ4 compression, packing",   vraw::Encoding::LINEAR_14BIT, true,  true,  16383, 0},
 };
 
 static const int NUM_TESTS = sizeof(testConfigs) / sizeof(testConfigs[0]);
@@ -84,7 +98,7 @@ static bool compareData(const uint16_t* original, const uint16_t* decoded,
 }
 
 static bool runTest(const TestConfig& config, int testNum) {
-    printf("  [%2d/16] %-45s ", testNum, config.name);
+    printf("  [%2d/%d] %-45s ", testNum, NUM_TESTS, config.name);
     fflush(stdout);
 
     std::string testFile = "/tmp/vraw_test_" + std::to_string(testNum) + ".vraw";
@@ -199,6 +213,32 @@ static bool runTest(const TestConfig& config, int testNum) {
             }
         }
 
+        // Planar CFA output must match a plain deinterleave of the mosaic
+        auto mosaic = reader.readFrame(0);
+        reader.setOutputLayout(vraw::FrameLayout::CFA_PLANES);
+        auto planar = reader.readFrame(0);
+        const uint32_t planeW = TEST_WIDTH / 2;
+        const uint32_t planeSize = planeW * (TEST_HEIGHT / 2);
+        if (!planar.valid || planar.pixelData.size() != planeSize * 4 * sizeof(uint16_t)) {
+            printf("FAIL (planar read)\n");
+            reader.close();
+            std::remove(testFile.c_str());
+            return false;
+        }
+        const uint16_t* m = reinterpret_cast<const uint16_t*>(mosaic.pixelData.data());
+        const uint16_t* p = reinterpret_cast<const uint16_t*>(planar.pixelData.data());
+        for (uint32_t i = 0; i < planeSize * 4; i++) {
+            uint32_t plane = i / planeSize;           // RGGB: R G1 / G2 B
+            uint32_t y = (i % planeSize) / planeW * 2 + plane / 2;
+            uint32_t x = (i % planeSize) % planeW * 2 + plane % 2;
+            if (p[i] != m[y * TEST_WIDTH + x]) {
+                printf("FAIL (planar mismatch at plane %u)\n", plane);
+                reader.close();
+                std::remove(testFile.c_str());
+                return false;
+            }
+        }
+
         reader.close();
     }
 
@@ -299,9 +339,13 @@ static bool runAudioTest() {
             return false;
         }
 
+        vraw::AudioHeader headerOnly = {};
         if (audioHeader.sampleRate != sampleRate ||
             audioHeader.channels != channels ||
-            audioHeader.sampleCount != sampleCount) {
+            audioHeader.sampleCount != sampleCount ||
+            !reader.readAudioHeader(headerOnly) ||
+            headerOnly.sampleCount != sampleCount ||
+            headerOnly.startTimestampUs != audioHeader.startTimestampUs) {
             printf("FAIL (audio header mismatch)\n");
             reader.close();
             std::remove(testFile.c_str());
@@ -333,26 +377,2152 @@ static bool runAudioTest() {
     return true;
 }
 
-int main() {
-    printf("\nVRAW Library Test Suite\n");
-    printf("=======================\n\n");
-    printf("Testing %d encoding/compression/packing combinations:\n\n", NUM_TESTS);
+static bool runBatchLoaderTest() {
+    printf("  [BATCH] BatchLoader batches match readFrame          ");
+    fflush(stdout);
 
-    int passed = 0;
-    int failed = 0;
+    // Two clips with different depths, patterns and per-channel black levels
+    // in the same batches; planePos is the tile position of R, G1, G2, B
+    struct Clip {
+        std::string path;
+        vraw::Encoding encoding;
+        vraw::BayerPattern pattern;
+        uint16_t blackLevel[4];
+        uint16_t whiteLevel;
+        int planePos[4];
+    };
+    const Clip clips[] = {
+        {"/tmp/vraw_test_batch12.vraw", vraw::Encoding::LINEAR_12BIT, vraw::BayerPattern::GRBG,
+         {64, 64, 64, 64}, 4095, {1, 0, 3, 2}},
+        {"/tmp/vraw_test_batch14.vraw", vraw::Encoding::LINEAR_14BIT, vraw::BayerPattern::BGGR,
+         {512, 520, 528, 536}, 16383, {3, 2, 1, 0}},
+    };
+    const uint32_t frameCount = 5;
+    auto cleanup = [&]() {
+        for (const Clip& clip : clips) {
+            std::remove(clip.path.c_str());
+        }
+    };
 
-    for (int i = 0; i < NUM_TESTS; i++) {
-        if (runTest(testConfigs[i], i + 1)) {
-            passed++;
-        } else {
-            failed++;
+    // Reference mosaics, as readFrame() returns them
+    std::vector<uint16_t> expected[2][frameCount];
+    std::vector<vraw::BatchSample> samples;
+    for (int c = 0; c < 2; c++) {
+        const Clip& clip = clips[c];
+        std::vector<uint16_t> originalData;
+        generateTestData(originalData, clip.whiteLevel);
+        {
+            vraw::VrawWriter writer;
+            if (!writer.init(TEST_WIDTH, TEST_HEIGHT, clip.path, clip.encoding, true, true,
+                             clip.pattern, clip.blackLevel, clip.whiteLevel) ||
+                !writer.start()) {
+                printf("FAIL (init)\n");
+                cleanup();
+                return false;
+            }
+            for (uint32_t frame = 0; frame < frameCount; frame++) {
+                // Offset each frame so samples can be told apart; the top-left
+                // 4x2 block holds exact black (columns 0-1) and white (2-3)
+                std::vector<uint16_t> data(originalData);
+                for (auto& v : data) v = static_cast<uint16_t>((v + frame) % (clip.whiteLevel + 1));
+                for (uint32_t y = 0; y < 2; y++) {
+                    for (uint32_t x = 0; x < 4; x++) {
+                        data[y * TEST_WIDTH + x] = (x < 2) ? clip.blackLevel[y * 2 + (x & 1)] : clip.whiteLevel;
+                    }
+                }
+                writer.submitFrame(data.data(), frame * 33333);
+            }
+            writer.stop();
+        }
+
+        vraw::VrawReader reader;
+        if (!reader.open(clip.path)) {
+            printf("FAIL (open)\n");
+            cleanup();
+            return false;
+        }
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            auto decoded = reader.readFrame(frame);
+            if (!decoded.valid) {
+                printf("FAIL (readFrame %u)\n", frame);
+                cleanup();
+                return false;
+            }
+            expected[c][frame].resize(PIXEL_COUNT);
+            memcpy(expected[c][frame].data(), decoded.pixelData.data(), PIXEL_COUNT * 2);
+            samples.push_back({clip.path, frame});
         }
     }
 
-    printf("\n");
+    const vraw::TensorLayout layouts[] = {vraw::TensorLayout::MOSAIC, vraw::TensorLayout::CFA_PLANES};
+    const vraw::TensorType dtypes[] = {vraw::TensorType::UINT16, vraw::TensorType::FLOAT32};
+    const uint32_t planeW = TEST_WIDTH / 2;
+    const uint32_t planeH = TEST_HEIGHT / 2;
+    for (vraw::TensorLayout layout : layouts) {
+        for (vraw::TensorType dtype : dtypes) {
+            const bool planar = (layout == vraw::TensorLayout::CFA_PLANES);
+            const bool asFloat = (dtype == vraw::TensorType::FLOAT32);
 
-    // Run audio test
-    if (runAudioTest()) {
+            vraw::BatchLoader loader;
+            vraw::BatchLoader::Options opts;
+            opts.batchSize = 3;
+            opts.layout = layout;
+            opts.dtype = dtype;
+            opts.workerThreads = 2;
+            opts.seed = 7;
+            if (!loader.init(samples, opts) || loader.getBatchCount() != 4) {
+                printf("FAIL (init loader)\n");
+                cleanup();
+                return false;
+            }
+
+            std::vector<int> seen(samples.size(), 0);
+            vraw::BatchLoader::Batch batch;
+            for (int epoch = 0; epoch < 2; epoch++) {
+                while (loader.next(batch)) {
+                    for (uint32_t i = 0; i < batch.count; i++) {
+                        const uint32_t index = batch.sampleIndices[i];
+                        const int c = static_cast<int>(index / frameCount);
+                        const uint32_t frame = samples[index].frameNumber;
+                        const Clip& clip = clips[c];
+                        const std::vector<uint16_t>& mosaic = expected[c][frame];
+                        seen[index]++;
+                        bool ok = batch.failedCount == 0 && batch.headers[i].frameNumber == frame;
+
+                        // Element e of the sample: its mosaic value and tile position
+                        for (uint32_t e = 0; e < PIXEL_COUNT && ok; e++) {
+                            uint32_t y = e / TEST_WIDTH;
+                            uint32_t x = e % TEST_WIDTH;
+                            if (planar) {
+                                const int pos = clip.planePos[e / (planeW * planeH)];
+                                y = (e % (planeW * planeH)) / planeW * 2 + pos / 2;
+                                x = (e % planeW) * 2 + (pos & 1);
+                            }
+                            const int pos = static_cast<int>((y & 1) * 2 + (x & 1));
+                            const uint16_t v = mosaic[y * TEST_WIDTH + x];
+                            if (!asFloat) {
+                                ok = static_cast<const uint16_t*>(batch.data)[i * PIXEL_COUNT + e] == v;
+                                continue;
+                            }
+                            const float black = clip.blackLevel[pos];
+                            const float want = (v - black) / (clip.whiteLevel - black);
+                            const float got = static_cast<const float*>(batch.data)[i * PIXEL_COUNT + e];
+                            ok = std::fabs(got - want) <= 1e-6f;
+                            // Black and white markers land exactly on 0 and 1
+                            if (y < 2 && x < 4) {
+                                ok = ok && std::fabs(got - (x < 2 ? 0.0f : 1.0f)) <= 1e-6f;
+                            }
+                        }
+                        if (!ok) {
+                            printf("FAIL (%s %s, clip %d frame %u)\n", planar ? "planes" : "mosaic",
+                                   asFloat ? "float32" : "uint16", c, frame);
+                            loader.close();
+                            cleanup();
+                            return false;
+                        }
+                    }
+                }
+                loader.reset();
+            }
+            loader.close();
+
+            for (size_t index = 0; index < samples.size(); index++) {
+                if (seen[index] != 2) {
+                    printf("FAIL (sample %zu loaded %d times)\n", index, seen[index]);
+                    cleanup();
+                    return false;
+                }
+            }
+        }
+    }
+
+    cleanup();
+    printf("PASS\n");
+    return true;
+}
+
+static bool runPlanarStorageTest() {
+    printf("  [PLANE] Planar storage with black subtraction        ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_planar.vraw";
+
+    struct { vraw::Encoding encoding; bool packing; bool compression; uint16_t maxValue; } cases[] = {
+        {vraw::Encoding::LINEAR_12BIT, true,  true,  4095},
+        {vraw::Encoding::LINEAR_12BIT, false, false, 4095},
+        {vraw::Encoding::LINEAR_10BIT, true,  false, 1023},
+        {vraw::Encoding::LINEAR_10BIT, false, true,  1023},
+    };
+
+    std::vector<uint16_t> originalData;
+    for (const auto& c : cases) {
+        generateTestData(originalData, c.maxValue);
+        // Include samples below the black level; subtraction must stay lossless
+        originalData[0] = 3;
+        originalData[TEST_WIDTH + 1] = 0;
+
+        {
+            vraw::VrawWriter writer;
+            uint16_t blackLevel[4] = {60, 62, 64, 66};
+            if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile, c.encoding, c.packing,
+                             c.compression, vraw::BayerPattern::GBRG, blackLevel, c.maxValue) ||
+                !writer.setStorageLayout(vraw::FrameLayout::CFA_PLANES, true) ||
+                !writer.start() ||
+                !writer.submitFrame(originalData.data(), 0) ||
+                !writer.stop()) {
+                printf("FAIL (write)\n");
+                std::remove(testFile.c_str());
+                return false;
+            }
+        }
+
+        vraw::VrawReader reader;
+        if (!reader.open(testFile) ||
+            reader.getFileHeader().storageLayout != vraw::FrameLayout::CFA_PLANES) {
+            printf("FAIL (open)\n");
+            std::remove(testFile.c_str());
+            return false;
+        }
+
+        auto mosaic = reader.readFrame(0);
+        const uint16_t* m = reinterpret_cast<const uint16_t*>(mosaic.pixelData.data());
+        int maxDiff = 0;
+        if (!mosaic.valid || !compareData(originalData.data(), m, PIXEL_COUNT, 0, maxDiff)) {
+            printf("FAIL (mosaic mismatch, maxDiff=%d)\n", maxDiff);
+            reader.close();
+            std::remove(testFile.c_str());
+            return false;
+        }
+
+        // GBRG: R plane comes from odd rows, even columns
+        reader.setOutputLayout(vraw::FrameLayout::CFA_PLANES);
+        auto planar = reader.readFrame(0);
+        const uint16_t* p = reinterpret_cast<const uint16_t*>(planar.pixelData.data());
+        if (!planar.valid || p[0] != originalData[TEST_WIDTH] || p[1] != originalData[TEST_WIDTH + 2]) {
+            printf("FAIL (planar mismatch)\n");
+            reader.close();
+            std::remove(testFile.c_str());
+            return false;
+        }
+        reader.close();
+    }
+
+    std::remove(testFile.c_str());
+    printf("PASS\n");
+    return true;
+}
+
+static bool runPreRollTest() {
+    printf("  [PRE]   Pre-roll ring flushed ahead of live frames   ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_preroll.vraw";
+    const uint64_t frameUs = 33333;
+
+    std::vector<uint16_t> originalData;
+    generateTestData(originalData, 4095);
+
+    {
+        vraw::VrawWriter writer;
+        // Uncompressed file: the ring still compresses internally
+        if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile,
+                         vraw::Encoding::LINEAR_12BIT, false, false) ||
+            !writer.enablePreRoll(3 * frameUs, 64 * 1024 * 1024)) {
+            printf("FAIL (init)\n");
+            return false;
+        }
+
+        // 10 frames before the trigger; only the last 4 fit in 3 frame periods
+        for (uint64_t i = 0; i < 10; i++) {
+            originalData[0] = static_cast<uint16_t>(i);
+            writer.submitFrame(originalData.data(), i * frameUs);
+        }
+        if (writer.getPreRollFrameCount() != 4) {
+            printf("FAIL (ring holds %u frames)\n", writer.getPreRollFrameCount());
+            return false;
+        }
+
+        writer.start();
+        for (uint64_t i = 10; i < 13; i++) {
+            originalData[0] = static_cast<uint16_t>(i);
+            writer.submitFrame(originalData.data(), i * frameUs);
+        }
+        writer.stop();
+    }
+
+    vraw::VrawReader reader;
+    if (!reader.open(testFile) || reader.getFrameCount() != 7) {
+        printf("FAIL (frame count %u)\n", reader.getFrameCount());
+        std::remove(testFile.c_str());
+        return false;
+    }
+    for (uint32_t f = 0; f < 7; f++) {
+        auto frame = reader.readFrame(f);
+        const uint16_t* data = reinterpret_cast<const uint16_t*>(frame.pixelData.data());
+        if (!frame.valid || frame.header.timestampUs != (f + 6) * frameUs ||
+            frame.header.frameNumber != f || data[0] != f + 6 ||
+            data[PIXEL_COUNT - 1] != originalData[PIXEL_COUNT - 1]) {
+            printf("FAIL (frame %u)\n", f);
+            reader.close();
+            std::remove(testFile.c_str());
+            return false;
+        }
+    }
+    reader.close();
+    std::remove(testFile.c_str());
+
+    // A write error during the flush loses the live frames queued behind
+    // it; later frames and stop() must report that rather than succeed
+    {
+        std::mutex gateMutex;
+        std::condition_variable gateCv;
+        bool armed = false;
+        bool released = false;
+        std::unique_ptr<vraw::OutputSink> sink(new vraw::CallbackSink(
+            [&](uint64_t, const void*, size_t) {
+                std::unique_lock<std::mutex> lock(gateMutex);
+                if (!armed) {
+                    return true;
+                }
+                // Hold the first flushed frame until the live frames are
+                // queued, then fail that one write only
+                gateCv.wait(lock, [&] { return released; });
+                armed = false;
+                return false;
+            }));
+
+        vraw::VrawWriter writer;
+        if (!writer.initWithSink(std::move(sink), TEST_WIDTH, TEST_HEIGHT, "failing") ||
+            !writer.enablePreRoll(0, 64 * 1024 * 1024)) {
+            printf("FAIL (init failing sink)\n");
+            return false;
+        }
+        for (uint64_t i = 0; i < 3; i++) {
+            writer.submitFrame(originalData.data(), i * frameUs);
+        }
+        {
+            std::lock_guard<std::mutex> lock(gateMutex);
+            armed = true;
+        }
+        writer.start();
+        bool queued = true;
+        for (uint64_t i = 3; i < 5; i++) {
+            queued = writer.submitFrame(originalData.data(), i * frameUs) && queued;
+        }
+        {
+            std::lock_guard<std::mutex> lock(gateMutex);
+            released = true;
+        }
+        gateCv.notify_all();
+        while (writer.getPreRollFrameCount() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (!queued || writer.submitFrame(originalData.data(), 5 * frameUs) || writer.stop()) {
+            printf("FAIL (write error not reported)\n");
+            return false;
+        }
+    }
+
+    // Live frames queued behind a stalled flush get the same byte budget:
+    // two frames' worth is queued, the third is dropped
+    {
+        std::mutex gateMutex;
+        std::condition_variable gateCv;
+        bool armed = false;
+        bool released = false;
+        std::unique_ptr<vraw::MemorySink> memoryOwner(new vraw::MemorySink());
+        vraw::MemorySink* memory = memoryOwner.get();
+        std::unique_ptr<vraw::OutputSink> sink(new vraw::CallbackSink(
+            [&](uint64_t offset, const void* data, size_t size) {
+                std::unique_lock<std::mutex> lock(gateMutex);
+                if (armed) {
+                    gateCv.wait(lock, [&] { return released; });
+                }
+                return offset == memory->size() ? memory->append(data, size)
+                                                : memory->writeAt(offset, data, size);
+            }));
+
+        vraw::VrawWriter writer;
+        if (!writer.initWithSink(std::move(sink), TEST_WIDTH, TEST_HEIGHT, "stalled") ||
+            !writer.enablePreRoll(0, 64 * 1024 * 1024) ||
+            !writer.submitFrame(originalData.data(), 0)) {
+            printf("FAIL (init stalled sink)\n");
+            return false;
+        }
+        const size_t frameBytes = writer.getPreRollBytes();
+        writer.enablePreRoll(0, frameBytes * 5 / 2);
+        writer.submitFrame(originalData.data(), frameUs);
+        {
+            std::lock_guard<std::mutex> lock(gateMutex);
+            armed = true;
+        }
+        writer.start();
+        const bool first = writer.submitFrame(originalData.data(), 2 * frameUs);
+        const bool second = writer.submitFrame(originalData.data(), 3 * frameUs);
+        const bool third = writer.submitFrame(originalData.data(), 4 * frameUs);
+        {
+            std::lock_guard<std::mutex> lock(gateMutex);
+            released = true;
+        }
+        gateCv.notify_all();
+        if (!first || !second || third || !writer.stop() || writer.getFrameCount() != 4) {
+            printf("FAIL (live queue budget: %d %d %d, %u frames)\n", first, second, third,
+                   writer.getFrameCount());
+            return false;
+        }
+    }
+
+    printf("PASS\n");
+    return true;
+}
+
+static bool runOutputSinkTest() {
+    printf("  [SINK]  Memory and callback output sinks             ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_sink.vraw";
+
+    std::vector<uint16_t> originalData;
+    generateTestData(originalData, 4095);
+    std::vector<int16_t> audio(4800 * 2, 1234);
+
+    // Tee: everything the memory sink receives is mirrored through a callback
+    std::vector<uint8_t> mirror;
+    std::unique_ptr<vraw::MemorySink> memoryOwner(new vraw::MemorySink());
+    vraw::MemorySink* memory = memoryOwner.get();
+    std::unique_ptr<vraw::OutputSink> tee(new vraw::CallbackSink(
+        [&](uint64_t offset, const void* data, size_t size) {
+            const uint8_t* p = static_cast<const uint8_t*>(data);
+            if (offset + size > mirror.size()) {
+                mirror.resize(offset + size);
+            }
+            std::copy(p, p + size, mirror.begin() + offset);
+            return offset == memory->size() ? memory->append(data, size)
+                                            : memory->writeAt(offset, data, size);
+        }));
+
+    {
+        vraw::VrawWriter writer;
+        if (!writer.initWithSink(std::move(tee), TEST_WIDTH, TEST_HEIGHT, "tee",
+                                 vraw::Encoding::LINEAR_12BIT, true, true) ||
+            !writer.enableAudio(48000, 2) ||
+            !writer.start() ||
+            !writer.submitFrame(originalData.data(), 0) ||
+            !writer.submitAudio(audio.data(), 4800, 0) ||
+            !writer.submitFrame(originalData.data(), 33333) ||
+            !writer.stop() ||
+            writer.getBytesWritten() != memory->size() ||
+            writer.getSink()->size() != memory->size()) {
+            printf("FAIL (write)\n");
+            return false;
+        }
+    }
+
+    if (mirror != memory->data()) {
+        printf("FAIL (tee mismatch)\n");
+        return false;
+    }
+
+    FILE* f = fopen(testFile.c_str(), "wb");
+    if (!f || fwrite(memory->data().data(), 1, memory->size(), f) != memory->size()) {
+        if (f) fclose(f);
+        printf("FAIL (dump)\n");
+        return false;
+    }
+    fclose(f);
+
+    vraw::VrawReader reader;
+    if (!reader.open(testFile) || reader.getFrameCount() != 2 || !reader.hasAudio()) {
+        printf("FAIL (open)\n");
+        std::remove(testFile.c_str());
+        return false;
+    }
+    auto frame = reader.readFrame(1);
+    int maxDiff = 0;
+    if (!frame.valid || !compareData(originalData.data(),
+            reinterpret_cast<const uint16_t*>(frame.pixelData.data()), PIXEL_COUNT, 0, maxDiff)) {
+        printf("FAIL (frame mismatch)\n");
+        reader.close();
+        std::remove(testFile.c_str());
+        return false;
+    }
+    reader.close();
+    std::remove(testFile.c_str());
+
+    // Null sink only counts bytes
+    vraw::VrawWriter nullWriter;
+    std::unique_ptr<vraw::OutputSink> null(new vraw::NullSink());
+    if (!nullWriter.initWithSink(std::move(null), TEST_WIDTH, TEST_HEIGHT, "null") ||
+        !nullWriter.start() ||
+        !nullWriter.submitFrame(originalData.data(), 0) ||
+        !nullWriter.stop() ||
+        nullWriter.getSink()->size() != nullWriter.getBytesWritten()) {
+        printf("FAIL (null sink)\n");
+        return false;
+    }
+
+    printf("PASS\n");
+    return true;
+}
+
+static bool runInputSourceTest() {
+    printf("  [SRC]   Mmap, memory and callback input sources      ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_source.vraw";
+
+    std::vector<uint16_t> originalData;
+    generateTestData(originalData, 4095);
+
+    // Uncompressed 16-bit exercises the banded planar path straight from a mapping
+    struct { bool packing; bool compression; } cases[] = { {false, false}, {true, true} };
+    for (const auto& c : cases) {
+        {
+            vraw::VrawWriter writer;
+            if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile, vraw::Encoding::LINEAR_12BIT,
+                             c.packing, c.compression) ||
+                !writer.start() ||
+                !writer.submitFrame(originalData.data(), 0) ||
+                !writer.submitFrame(originalData.data(), 33333) ||
+                !writer.stop()) {
+                printf("FAIL (write)\n");
+                return false;
+            }
+        }
+
+        std::vector<uint8_t> fileBytes;
+        FILE* f = fopen(testFile.c_str(), "rb");
+        if (f) {
+            fseek(f, 0, SEEK_END);
+            fileBytes.resize(static_cast<size_t>(ftell(f)));
+            fseek(f, 0, SEEK_SET);
+            if (fread(fileBytes.data(), 1, fileBytes.size(), f) != fileBytes.size()) {
+                fileBytes.clear();
+            }
+            fclose(f);
+        }
+
+        vraw::FileSource reference;
+        reference.open(testFile);
+        std::unique_ptr<vraw::MmapSource> mmapped(new vraw::MmapSource());
+        if (fileBytes.empty() || !reference.isOpen() || !mmapped->open(testFile)) {
+            printf("FAIL (open sources)\n");
+            std::remove(testFile.c_str());
+            return false;
+        }
+
+        std::vector<std::unique_ptr<vraw::InputSource>> sources;
+        sources.emplace_back(std::move(mmapped));
+        sources.emplace_back(new vraw::MemorySource(fileBytes));
+        sources.emplace_back(new vraw::CallbackSource(
+            [&](uint64_t offset, void* dst, size_t size) {
+                return reference.readAt(offset, dst, size);
+            }, reference.size()));
+
+        for (auto& source : sources) {
+            vraw::VrawReader reader;
+            if (!reader.openWithSource(std::move(source), "source") || reader.getFrameCount() != 2) {
+                printf("FAIL (open)\n");
+                std::remove(testFile.c_str());
+                return false;
+            }
+            auto mosaic = reader.readFrame(1);
+            reader.setOutputLayout(vraw::FrameLayout::CFA_PLANES);
+            auto planar = reader.readFrame(1);
+            const uint16_t* m = reinterpret_cast<const uint16_t*>(mosaic.pixelData.data());
+            const uint16_t* p = reinterpret_cast<const uint16_t*>(planar.pixelData.data());
+            int maxDiff = 0;
+            // RGGB: B plane (last) starts at row 1, column 1
+            const size_t planeSize = (TEST_WIDTH / 2) * (TEST_HEIGHT / 2);
+            if (!mosaic.valid || !planar.valid ||
+                !compareData(originalData.data(), m, PIXEL_COUNT, 0, maxDiff) ||
+                p[0] != originalData[0] || p[3 * planeSize] != originalData[TEST_WIDTH + 1]) {
+                printf("FAIL (frame mismatch)\n");
+                std::remove(testFile.c_str());
+                return false;
+            }
+        }
+    }
+
+    std::remove(testFile.c_str());
+    printf("PASS\n");
+    return true;
+}
+
+static bool runDurabilityTest() {
+    printf("  [SYNC]  Checkpointed and periodic durability         ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_sync.vraw";
+
+    std::vector<uint16_t> originalData;
+    generateTestData(originalData, 4095);
+
+    // Checkpoints: a file that is never finalized still opens with the
+    // frames up to the last checkpoint
+    {
+        vraw::VrawWriter writer;
+        vraw::DurabilityPolicy policy;
+        policy.mode = vraw::DurabilityMode::PER_CHECKPOINT;
+        policy.checkpointFrames = 2;
+        if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile) ||
+            !writer.setDurabilityPolicy(policy) ||
+            !writer.start()) {
+            printf("FAIL (init)\n");
+            return false;
+        }
+        for (int i = 0; i < 5; i++) {
+            writer.submitFrame(originalData.data(), i * 33333);
+        }
+
+        vraw::VrawReader reader;
+        if (!reader.open(testFile) || reader.getFrameCount() != 4) {
+            printf("FAIL (recovered %u frames)\n", reader.getFrameCount());
+            std::remove(testFile.c_str());
+            return false;
+        }
+        auto frame = reader.readFrame(3);
+        int maxDiff = 0;
+        if (!frame.valid || !compareData(originalData.data(),
+                reinterpret_cast<const uint16_t*>(frame.pixelData.data()), PIXEL_COUNT, 0, maxDiff)) {
+            printf("FAIL (recovered frame mismatch)\n");
+            std::remove(testFile.c_str());
+            return false;
+        }
+        writer.stop();
+    }
+
+    // Periodic: one writeback range per frame
+    {
+        vraw::VrawWriter writer;
+        vraw::DurabilityPolicy policy;
+        policy.mode = vraw::DurabilityMode::PERIODIC;
+        policy.syncBytes = 1;
+        policy.syncIntervalMs = 0;
+        policy.dropSyncedPages = true;
+        if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile) ||
+            !writer.setDurabilityPolicy(policy) ||
+            !writer.start()) {
+            printf("FAIL (init periodic)\n");
+            std::remove(testFile.c_str());
+            return false;
+        }
+        for (int i = 0; i < 3; i++) {
+            writer.submitFrame(originalData.data(), i * 33333);
+        }
+
+        // Every synced range also updates the header frame count, so an
+        // unfinalized file recovers all synced frames
+        vraw::VrawReader recovered;
+        if (!recovered.open(testFile) || recovered.getFrameCount() != 3) {
+            printf("FAIL (periodic recovered %u frames)\n", recovered.getFrameCount());
+            std::remove(testFile.c_str());
+            return false;
+        }
+        auto frame = recovered.readFrame(2);
+        int maxDiff = 0;
+        if (!frame.valid || !compareData(originalData.data(),
+                reinterpret_cast<const uint16_t*>(frame.pixelData.data()), PIXEL_COUNT, 0, maxDiff)) {
+            printf("FAIL (periodic recovered frame mismatch)\n");
+            std::remove(testFile.c_str());
+            return false;
+        }
+        recovered.close();
+
+        if (!writer.stop() || writer.getSyncCount() != 3 ||
+            writer.getDroppedCacheBytes() != writer.getBytesWritten()) {
+            printf("FAIL (%u syncs)\n", writer.getSyncCount());
+            std::remove(testFile.c_str());
+            return false;
+        }
+    }
+
+    vraw::VrawReader reader;
+    if (!reader.open(testFile) || reader.getFrameCount() != 3) {
+        printf("FAIL (periodic frame count)\n");
+        std::remove(testFile.c_str());
+        return false;
+    }
+    reader.close();
+
+    std::remove(testFile.c_str());
+    printf("PASS\n");
+    return true;
+}
+
+static bool runAccessHintTest() {
+    printf("  [HINT]  Reader access pattern detection              ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_hint.vraw";
+
+    std::vector<uint16_t> originalData;
+    generateTestData(originalData, 4095);
+    {
+        vraw::VrawWriter writer;
+        if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile) || !writer.start()) {
+            printf("FAIL (init)\n");
+            return false;
+        }
+        for (int i = 0; i < 32; i++) {
+            writer.submitFrame(originalData.data(), i * 33333);
+        }
+        writer.stop();
+    }
+
+    vraw::VrawReader reader;
+    if (!reader.open(testFile)) {
+        printf("FAIL (open)\n");
+        std::remove(testFile.c_str());
+        return false;
+    }
+
+    // Forward playback switches to SEQUENTIAL and reads ahead
+    for (uint32_t f = 0; f < 16; f++) {
+        reader.readFrame(f);
+    }
+    const auto& stats = reader.getStats();
+    if (stats.appliedHint != vraw::AccessHint::SEQUENTIAL || stats.willNeedRequests == 0 ||
+        stats.sequentialReads != 15 || stats.framesRead != 16 || stats.bytesRead == 0) {
+        printf("FAIL (sequential)\n");
+        reader.close();
+        std::remove(testFile.c_str());
+        return false;
+    }
+
+    // Scrubbing switches to RANDOM
+    const uint32_t jumps[] = {3, 27, 9, 20, 1};
+    for (uint32_t f : jumps) {
+        reader.readFrame(f);
+    }
+    if (stats.appliedHint != vraw::AccessHint::RANDOM || stats.randomReads != 5) {
+        printf("FAIL (random)\n");
+        reader.close();
+        std::remove(testFile.c_str());
+        return false;
+    }
+
+    // An explicit hint overrides detection
+    reader.setAccessHint(vraw::AccessHint::NORMAL);
+    for (uint32_t f = 0; f < 8; f++) {
+        reader.readFrame(f);
+    }
+    if (stats.appliedHint != vraw::AccessHint::NORMAL) {
+        printf("FAIL (explicit hint)\n");
+        reader.close();
+        std::remove(testFile.c_str());
+        return false;
+    }
+    reader.close();
+
+    std::remove(testFile.c_str());
+    printf("PASS\n");
+    return true;
+}
+
+static bool runSingleFetchTest() {
+    printf("  [FETCH] One read per frame from index sizes          ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_fetch.vraw";
+
+    std::vector<uint16_t> originalData;
+    generateTestData(originalData, 4095);
+    std::vector<int16_t> audio(4800, 7);
+
+    // Compressed with audio (last frame ends at the audio stream) and plain
+    // 16-bit without (last frame ends at the index; payload read in place)
+    struct { bool compression; bool withAudio; } cases[] = { {true, true}, {false, false} };
+    for (const auto& c : cases) {
+        {
+            vraw::VrawWriter writer;
+            if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile, vraw::Encoding::LINEAR_12BIT,
+                             false, c.compression)) {
+                printf("FAIL (init)\n");
+                return false;
+            }
+            if (c.withAudio) {
+                writer.enableAudio(48000, 1);
+            }
+            bool ok = writer.start();
+            for (int i = 0; i < 3 && ok; ++i) {
+                ok = writer.submitFrame(originalData.data(), i * 33333);
+            }
+            if (ok && c.withAudio) {
+                ok = writer.submitAudio(audio.data(), static_cast<uint32_t>(audio.size()), 0);
+            }
+            if (!ok || !writer.stop()) {
+                printf("FAIL (write)\n");
+                return false;
+            }
+        }
+
+        vraw::FileSource file;
+        file.open(testFile);
+        uint32_t reads = 0;
+        vraw::VrawReader counted;
+        vraw::VrawReader direct;
+        if (!counted.openWithSource(std::unique_ptr<vraw::InputSource>(new vraw::CallbackSource(
+                [&](uint64_t offset, void* dst, size_t size) {
+                    ++reads;
+                    return file.readAt(offset, dst, size);
+                }, file.size())), "counted") ||
+            !direct.open(testFile)) {
+            printf("FAIL (open)\n");
+            std::remove(testFile.c_str());
+            return false;
+        }
+
+        for (uint32_t i = 0; i < 3; ++i) {
+            reads = 0;
+            auto a = counted.readFrame(i);
+            auto b = direct.readFrame(i);
+            int maxDiff = 0;
+            if (!a.valid || !b.valid ||
+                !compareData(originalData.data(), reinterpret_cast<const uint16_t*>(a.pixelData.data()),
+                             PIXEL_COUNT, 0, maxDiff) ||
+                a.pixelData != b.pixelData || a.header.timestampUs != i * 33333u) {
+                printf("FAIL (frame %u mismatch)\n", i);
+                std::remove(testFile.c_str());
+                return false;
+            }
+            // Plain frames scatter header and payload: one readAt per slice here
+            if (reads != (c.compression ? 1u : 2u)) {
+                printf("FAIL (%u reads for frame %u)\n", reads, i);
+                std::remove(testFile.c_str());
+                return false;
+            }
+        }
+    }
+
+    std::remove(testFile.c_str());
+    printf("PASS\n");
+    return true;
+}
+
+static bool runBatchReadTest() {
+    printf("  [BREAD] Offset-sorted merged batch reads             ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_batch_read.vraw";
+
+    std::vector<uint16_t> originalData;
+    generateTestData(originalData, 1023);
+    const uint32_t frameCount = 24;
+    {
+        vraw::VrawWriter writer;
+        if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile, vraw::Encoding::LINEAR_10BIT, true, true) ||
+            !writer.start()) {
+            printf("FAIL (init)\n");
+            return false;
+        }
+        std::vector<uint16_t> frame(PIXEL_COUNT);
+        for (uint32_t i = 0; i < frameCount; ++i) {
+            for (uint32_t p = 0; p < PIXEL_COUNT; ++p) {
+                frame[p] = static_cast<uint16_t>((originalData[p] + i) & 0x3FF);
+            }
+            if (!writer.submitFrame(frame.data(), i * 1000)) {
+                printf("FAIL (write)\n");
+                return false;
+            }
+        }
+        writer.stop();
+    }
+
+    // Out of order, a run of neighbours, a duplicate and an invalid index
+    const std::vector<uint32_t> frames = {20, 3, 4, 5, 6, 11, 3, 999, 0, 23};
+
+    for (int mode = 0; mode < 3; ++mode) {
+        vraw::VrawReader reader;
+        bool opened = false;
+        if (mode == 2) {
+            std::unique_ptr<vraw::MmapSource> mapped(new vraw::MmapSource());
+            opened = mapped->open(testFile) && reader.openWithSource(std::move(mapped), "mapped");
+        } else {
+            opened = reader.open(testFile);
+        }
+        if (!opened) {
+            printf("FAIL (open)\n");
+            std::remove(testFile.c_str());
+            return false;
+        }
+
+        std::mutex mutex;
+        std::vector<int> calls(frames.size(), 0);
+        bool mismatch = false;
+        vraw::VrawReader::BatchReadOptions options;
+        options.queueDepth = 2;
+        options.decodeThreads = 2;
+        options.useIoUring = (mode == 0);
+        const bool ok = reader.readFrames(frames,
+            [&](size_t index, uint32_t frameNumber, const uint16_t* pixels, const vraw::FrameHeader& header) {
+                std::lock_guard<std::mutex> lock(mutex);
+                calls[index]++;
+                if (frameNumber != frames[index] || (frameNumber < frameCount) != (pixels != nullptr)) {
+                    mismatch = true;
+                    return;
+                }
+                if (pixels && (header.timestampUs != frameNumber * 1000ull ||
+                               pixels[0] != ((originalData[0] + frameNumber) & 0x3FF) ||
+                               pixels[PIXEL_COUNT - 1] != ((originalData[PIXEL_COUNT - 1] + frameNumber) & 0x3FF))) {
+                    mismatch = true;
+                }
+            }, options);
+
+        const vraw::VrawReader::Stats& stats = reader.getStats();
+        // Only the invalid index fails; 3-6 (and the duplicate 3) share one read
+        const uint32_t expectedReads = (mode == 2) ? 0 : 5;
+        if (ok || mismatch || std::count(calls.begin(), calls.end(), 1) != static_cast<long>(frames.size()) ||
+            stats.framesRead != frames.size() - 1 || stats.batchReads != expectedReads) {
+            printf("FAIL (mode %d: reads %u)\n", mode, stats.batchReads);
+            std::remove(testFile.c_str());
+            return false;
+        }
+    }
+
+    std::remove(testFile.c_str());
+    printf("PASS\n");
+    return true;
+}
+
+static bool runLoadIntoMemoryTest() {
+    printf("  [RAM]   Whole-clip load into memory                  ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_ram.vraw";
+
+    std::vector<uint16_t> originalData;
+    generateTestData(originalData, 4095);
+    {
+        vraw::VrawWriter writer;
+        if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile, vraw::Encoding::LINEAR_12BIT, true, true) ||
+            !writer.start()) {
+            printf("FAIL (init)\n");
+            return false;
+        }
+        for (int i = 0; i < 4; ++i) {
+            writer.submitFrame(originalData.data(), i * 1000);
+        }
+        writer.stop();
+    }
+
+    vraw::VrawReader reader;
+    if (!reader.open(testFile)) {
+        printf("FAIL (open)\n");
+        std::remove(testFile.c_str());
+        return false;
+    }
+    const uint64_t fileSize = reader.getSource()->size();
+
+    // Over budget or cancelled: keeps reading from the file
+    bool cancelled = reader.loadIntoMemory(fileSize, [](uint64_t, uint64_t) { return false; });
+    if (reader.loadIntoMemory(fileSize - 1) || cancelled || reader.isLoadedIntoMemory() ||
+        reader.getSource()->nativeHandle() < 0) {
+        printf("FAIL (fallback)\n");
+        std::remove(testFile.c_str());
+        return false;
+    }
+
+    uint64_t lastProgress = 0;
+    if (!reader.loadIntoMemory(fileSize, [&](uint64_t loaded, uint64_t total) {
+            lastProgress = (total == fileSize) ? loaded : 0;
+            return true;
+        }) || !reader.isLoadedIntoMemory() || lastProgress != fileSize) {
+        printf("FAIL (load)\n");
+        std::remove(testFile.c_str());
+        return false;
+    }
+
+    // The file is no longer needed
+    std::remove(testFile.c_str());
+    for (uint32_t i = 0; i < 4; ++i) {
+        auto frame = reader.readFrame(3 - i);
+        int maxDiff = 0;
+        if (!frame.valid || frame.header.timestampUs != (3 - i) * 1000u ||
+            !compareData(originalData.data(), reinterpret_cast<const uint16_t*>(frame.pixelData.data()),
+                         PIXEL_COUNT, 0, maxDiff)) {
+            printf("FAIL (frame %u)\n", 3 - i);
+            return false;
+        }
+    }
+
+    printf("PASS\n");
+    return true;
+}
+
+static bool runFrameCacheTest() {
+    printf("  [CACHE] Decoded and stored frame cache tiers         ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_cache.vraw";
+
+    std::vector<uint16_t> originalData;
+    generateTestData(originalData, 4095);
+    {
+        vraw::VrawWriter writer;
+        if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile, vraw::Encoding::LINEAR_12BIT, true, true) ||
+            !writer.start()) {
+            printf("FAIL (init)\n");
+            return false;
+        }
+        for (int i = 0; i < 6; ++i) {
+            writer.submitFrame(originalData.data(), i * 1000);
+        }
+        writer.stop();
+    }
+
+    vraw::FileSource file;
+    file.open(testFile);
+    uint32_t sourceReads = 0;
+    vraw::VrawReader reader;
+    if (!reader.openWithSource(std::unique_ptr<vraw::InputSource>(new vraw::CallbackSource(
+            [&](uint64_t offset, void* dst, size_t size) {
+                ++sourceReads;
+                return file.readAt(offset, dst, size);
+            }, file.size())), "cached")) {
+        printf("FAIL (open)\n");
+        std::remove(testFile.c_str());
+        return false;
+    }
+
+    // One decoded frame; stored room for every frame
+    vraw::VrawReader::CacheConfig config;
+    config.decodedBytes = reader.getFrameSizeBytes();
+    config.storedBytes = 16 * reader.getFrameSizeBytes();
+    reader.setCacheConfig(config);
+
+    const uint32_t sequence[] = {0, 1, 2, 2, 0, 1, 5};
+    for (uint32_t frameNumber : sequence) {
+        auto frame = reader.readFrame(frameNumber);
+        int maxDiff = 0;
+        if (!frame.valid || frame.header.timestampUs != frameNumber * 1000u ||
+            !compareData(originalData.data(), reinterpret_cast<const uint16_t*>(frame.pixelData.data()),
+                         PIXEL_COUNT, 0, maxDiff)) {
+            printf("FAIL (frame %u)\n", frameNumber);
+            std::remove(testFile.c_str());
+            return false;
+        }
+    }
+
+    // 0, 1, 2, 5 from the source; second 2 decoded hit; 0 and 1 stored hits
+    const vraw::VrawReader::Stats& stats = reader.getStats();
+    const uint32_t readsBefore = sourceReads;
+    reader.readFrame(1);
+    if (stats.cacheMisses != 4 || stats.decodedCacheHits != 1 || stats.storedCacheHits != 3 ||
+        sourceReads != readsBefore || stats.decodedCacheBytes != reader.getFrameSizeBytes() ||
+        stats.storedCacheBytes == 0 || stats.storedCacheBytes >= 4 * reader.getFrameSizeBytes()) {
+        printf("FAIL (stats %u/%u/%u)\n", stats.cacheMisses, stats.decodedCacheHits, stats.storedCacheHits);
+        std::remove(testFile.c_str());
+        return false;
+    }
+
+    // The decoded tier is per output layout
+    reader.setOutputLayout(vraw::FrameLayout::CFA_PLANES);
+    auto planes = reader.readFrame(1);
+    if (!planes.valid || stats.storedCacheHits != 4 ||
+        reinterpret_cast<const uint16_t*>(planes.pixelData.data())[0] != originalData[0]) {
+        printf("FAIL (planar)\n");
+        std::remove(testFile.c_str());
+        return false;
+    }
+
+    reader.clearCache();
+    reader.readFrame(1);
+    std::remove(testFile.c_str());
+    if (stats.cacheMisses != 5 || stats.storedCacheBytes == 0) {
+        printf("FAIL (clear)\n");
+        return false;
+    }
+
+    printf("PASS\n");
+    return true;
+}
+
+static bool runRowStreamTest() {
+    printf("  [ROWS]  Row-band streaming decode                    ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_rows.vraw";
+
+    // 62x46 puts packed bands and planes off 10-bit group boundaries
+    const uint32_t width = 62;
+    const uint32_t height = 46;
+    std::vector<uint16_t> frame(width * height);
+    for (uint32_t i = 0; i < frame.size(); ++i) {
+        frame[i] = static_cast<uint16_t>(100 + (i * 37) % 900);
+    }
+
+    struct {
+        vraw::Encoding encoding;
+        bool packing;
+        bool compression;
+        bool planar;
+    } cases[] = {
+        {vraw::Encoding::LINEAR_10BIT, true, false, false},
+        {vraw::Encoding::LINEAR_10BIT, true, false, true},
+        {vraw::Encoding::LINEAR_12BIT, true, true, true},
+        {vraw::Encoding::LINEAR_12BIT, false, false, false},
+        {vraw::Encoding::LINEAR_12BIT, false, true, false},
+    };
+    for (size_t n = 0; n < sizeof(cases) / sizeof(cases[0]); ++n) {
+        const auto& c = cases[n];
+        {
+            vraw::VrawWriter writer;
+            uint16_t blackLevel[4] = {60, 62, 64, 66};
+            if (!writer.init(width, height, testFile, c.encoding, c.packing, c.compression,
+                             vraw::BayerPattern::GRBG, blackLevel, 1023) ||
+                (c.planar && !writer.setStorageLayout(vraw::FrameLayout::CFA_PLANES, true)) ||
+                !writer.start() || !writer.submitFrame(frame.data(), 0) || !writer.stop()) {
+                printf("FAIL (write)\n");
+                std::remove(testFile.c_str());
+                return false;
+            }
+        }
+
+        vraw::VrawReader reader;
+        if (!reader.open(testFile)) {
+            printf("FAIL (open)\n");
+            std::remove(testFile.c_str());
+            return false;
+        }
+        for (int layout = 0; layout < 2; ++layout) {
+            const bool planarOut = (layout == 1);
+            reader.setOutputLayout(planarOut ? vraw::FrameLayout::CFA_PLANES : vraw::FrameLayout::MOSAIC);
+            auto expected = reader.readFrame(0);
+            const uint16_t* ref = reinterpret_cast<const uint16_t*>(expected.pixelData.data());
+            const size_t planeSize = (width / 2) * (height / 2);
+
+            // Reassemble the bands; rowsPerBand 5 rounds up to 6
+            std::vector<uint16_t> assembled(expected.pixelData.size() / 2, 0);
+            uint32_t nextRow = 0;
+            bool ordered = true;
+            const bool ok = expected.valid && reader.readFrameRows(0, 5,
+                [&](uint32_t firstRow, uint32_t rowCount, const uint16_t* samples) {
+                    ordered = ordered && firstRow == nextRow && (rowCount == 6 || firstRow + rowCount == height);
+                    nextRow = firstRow + rowCount;
+                    if (!planarOut) {
+                        memcpy(assembled.data() + firstRow * width, samples, rowCount * width * 2);
+                        return true;
+                    }
+                    const size_t bandPlane = (rowCount / 2) * (width / 2);
+                    for (int plane = 0; plane < 4; ++plane) {
+                        memcpy(assembled.data() + plane * planeSize + (firstRow / 2) * (width / 2),
+                               samples + plane * bandPlane, bandPlane * 2);
+                    }
+                    return true;
+                });
+            if (!ok || !ordered || nextRow != height ||
+                memcmp(assembled.data(), ref, expected.pixelData.size()) != 0) {
+                printf("FAIL (case %zu, layout %d)\n", n, layout);
+                std::remove(testFile.c_str());
+                return false;
+            }
+        }
+
+        // Stopping early is reported
+        uint32_t bands = 0;
+        if (reader.readFrameRows(0, 16, [&](uint32_t, uint32_t, const uint16_t*) { return ++bands < 2; }) ||
+            bands != 2) {
+            printf("FAIL (stop)\n");
+            std::remove(testFile.c_str());
+            return false;
+        }
+    }
+
+    std::remove(testFile.c_str());
+    printf("PASS\n");
+    return true;
+}
+
+static bool runChunkedEncodingTest() {
+    printf("  [CHUNK] Bounded-memory chunked encoding              ");
+    fflush(stdout);
+
+    std::string chunkedFile = "/tmp/vraw_test_chunked.vraw";
+    std::string wholeFile = "/tmp/vraw_test_whole.vraw";
+    auto cleanup = [&]() {
+        std::remove(chunkedFile.c_str());
+        std::remove(wholeFile.c_str());
+    };
+
+    // Large enough for dozens of bands under a 256 KB scratch cap
+    const uint32_t width = 1024;
+    const uint32_t height = 768;
+    const size_t scratchCap = 256 * 1024;
+    std::vector<uint16_t> frames[2];
+    for (int f = 0; f < 2; ++f) {
+        frames[f].resize(width * height);
+        for (uint32_t i = 0; i < frames[f].size(); ++i) {
+            const uint32_t x = i % width;
+            const uint32_t y = i / width;
+            frames[f][i] = static_cast<uint16_t>(64 + ((x * 3 + y * 5 + f * 11) % 700) + (i % 7));
+        }
+    }
+
+    struct {
+        vraw::Encoding encoding;
+        bool packing;
+        bool compression;
+        bool planar;
+    } cases[] = {
+        {vraw::Encoding::LINEAR_12BIT, false, true, false},
+        {vraw::Encoding::LINEAR_10BIT, true, true, false},
+        {vraw::Encoding::LOG2_12BIT, true, true, true},
+        {vraw::Encoding::LINEAR_10BIT, true, true, true},
+        {vraw::Encoding::LINEAR_12BIT, true, false, true},
+    };
+    for (size_t n = 0; n < sizeof(cases) / sizeof(cases[0]); ++n) {
+        const auto& c = cases[n];
+        for (int chunked = 0; chunked < 2; ++chunked) {
+            vraw::VrawWriter writer;
+            uint16_t blackLevel[4] = {60, 62, 64, 66};
+            if (!writer.init(width, height, chunked ? chunkedFile : wholeFile, c.encoding, c.packing,
+                             c.compression, vraw::BayerPattern::GBRG, blackLevel, 1023) ||
+                (c.planar && !writer.setStorageLayout(vraw::FrameLayout::CFA_PLANES, true)) ||
+                (chunked && !writer.setChunkedEncoding(scratchCap)) ||
+                !writer.start() || !writer.submitFrame(frames[0].data(), 0) ||
+                !writer.submitFrame(frames[1].data(), 33333)) {
+                printf("FAIL (write, case %zu)\n", n);
+                cleanup();
+                return false;
+            }
+            if (chunked && writer.getScratchBytes() > scratchCap) {
+                printf("FAIL (scratch %zu bytes, case %zu)\n", writer.getScratchBytes(), n);
+                cleanup();
+                return false;
+            }
+            writer.stop();
+        }
+
+        // Chunked frames must decode to exactly what whole-frame encoding stores
+        vraw::VrawReader chunkedReader;
+        vraw::VrawReader wholeReader;
+        if (!chunkedReader.open(chunkedFile) || !wholeReader.open(wholeFile) ||
+            chunkedReader.getFrameCount() != 2) {
+            printf("FAIL (open, case %zu)\n", n);
+            cleanup();
+            return false;
+        }
+        for (uint32_t f = 0; f < 2; ++f) {
+            auto got = chunkedReader.readFrame(f);
+            auto expected = wholeReader.readFrame(f);
+            if (!got.valid || !expected.valid || got.pixelData != expected.pixelData ||
+                got.header.timestampUs != expected.header.timestampUs) {
+                printf("FAIL (frame %u, case %zu)\n", f, n);
+                cleanup();
+                return false;
+            }
+
+            std::vector<uint16_t> assembled(width * height);
+            const bool ok = chunkedReader.readFrameRows(f, 24,
+                [&](uint32_t firstRow, uint32_t rowCount, const uint16_t* samples) {
+                    memcpy(assembled.data() + firstRow * width, samples, rowCount * width * 2);
+                    return true;
+                });
+            if (!ok || memcmp(assembled.data(), expected.pixelData.data(), expected.pixelData.size()) != 0) {
+                printf("FAIL (rows, frame %u, case %zu)\n", f, n);
+                cleanup();
+                return false;
+            }
+        }
+    }
+
+    cleanup();
+    printf("PASS\n");
+    return true;
+}
+
+// Pack/unpack round trip of one BitPacker width and order against a
+// bit-at-a-time reference stream
+template <int Bits, vraw::detail::BitOrder Order>
+static bool bitPackerRoundTrip() {
+    using Packer = vraw::detail::BitPacker<Bits, Order>;
+    const uint32_t group = Packer::GROUP_SAMPLES;
+    // Whole groups, partial tails and counts too short for a single group
+    const uint32_t counts[] = {0, 1, group - 1, group, group + 1, 5 * group + 3, 37, 250};
+    uint32_t seed = 0x9E3779B9u * Bits;
+
+    for (uint32_t count : counts) {
+        // Samples carry junk above Bits, which packing must drop
+        std::vector<uint16_t> samples(count);
+        for (uint16_t& v : samples) {
+            seed = seed * 1664525u + 1013904223u;
+            v = static_cast<uint16_t>(seed >> 16);
+        }
+
+        const uint32_t bytes = Packer::packedBytes(count);
+        std::vector<uint8_t> expected(bytes, 0);
+        for (uint32_t i = 0; i < count; ++i) {
+            for (int b = 0; b < Bits; ++b) {
+                const uint64_t pos = static_cast<uint64_t>(i) * Bits + b;
+                const bool lsb = (Order == vraw::detail::BitOrder::LSB_FIRST);
+                if ((samples[i] >> (lsb ? b : Bits - 1 - b)) & 1) {
+                    expected[pos / 8] |= static_cast<uint8_t>(lsb ? 1u << (pos % 8) : 0x80u >> (pos % 8));
+                }
+            }
+        }
+
+        // One guard byte past the end must survive
+        std::vector<uint8_t> packed(bytes + 1, 0xA5);
+        Packer::pack(samples.data(), count, packed.data());
+        if (!std::equal(expected.begin(), expected.end(), packed.begin()) || packed[bytes] != 0xA5) {
+            return false;
+        }
+
+        std::vector<uint16_t> unpacked(count + 1, 0xFFFF);
+        Packer::unpack(packed.data(), bytes, unpacked.data(), count);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (unpacked[i] != (samples[i] & Packer::MASK)) {
+                return false;
+            }
+        }
+        if (unpacked[count] != 0xFFFF) {
+            return false;
+        }
+
+        // Even/odd split, in batches that need not end on a group
+        const uint32_t pairs = count / 2;
+        std::vector<uint16_t> even(pairs + 1, 0xFFFF);
+        std::vector<uint16_t> odd(pairs + 1, 0xFFFF);
+        Packer::unpackToPairs(packed.data(), even.data(), odd.data(), pairs);
+        for (uint32_t i = 0; i < pairs; ++i) {
+            if (even[i] != (samples[2 * i] & Packer::MASK) || odd[i] != (samples[2 * i + 1] & Packer::MASK)) {
+                return false;
+            }
+        }
+        if (even[pairs] != 0xFFFF || odd[pairs] != 0xFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Round trip every width from Bits to 16 in both bit orders; failedBits
+// receives the first width that fails
+template <int Bits>
+static bool bitPackerWidthsRoundTrip(int& failedBits) {
+    if (!bitPackerRoundTrip<Bits, vraw::detail::BitOrder::LSB_FIRST>() ||
+        !bitPackerRoundTrip<Bits, vraw::detail::BitOrder::MSB_FIRST>()) {
+        failedBits = Bits;
+        return false;
+    }
+    if constexpr (Bits < 16) {
+        return bitPackerWidthsRoundTrip<Bits + 1>(failedBits);
+    }
+    return true;
+}
+
+static bool runBitPackerTest() {
+    printf("  [PACK]  Bit packer widths 8-16, both bit orders     ");
+    fflush(stdout);
+
+    int failedBits = 0;
+    if (!bitPackerWidthsRoundTrip<8>(failedBits)) {
+        printf("FAIL (%d-bit)\n", failedBits);
+        return false;
+    }
+
+    printf("PASS\n");
+    return true;
+}
+
+static bool runMipiIngestTest() {
+    printf("  [MIPI]  MIPI RAW10/RAW12 ingest                      ");
+    fflush(stdout);
+
+    std::string mipiFile = "/tmp/vraw_test_mipi.vraw";
+    std::string plainFile = "/tmp/vraw_test_mipi_ref.vraw";
+    auto cleanup = [&]() {
+        std::remove(mipiFile.c_str());
+        std::remove(plainFile.c_str());
+    };
+
+    const uint32_t width = 64;
+    const uint32_t height = 48;
+    const uint32_t padding = 16;  // Row stride padding, as Camera2 buffers have
+
+    struct {
+        vraw::MipiFormat format;
+        vraw::Encoding encoding;
+        bool packing;
+        bool compression;
+        bool planar;
+    } cases[] = {
+        {vraw::MipiFormat::RAW10, vraw::Encoding::LINEAR_10BIT, true, true, false},   // Direct repack
+        {vraw::MipiFormat::RAW12, vraw::Encoding::LINEAR_12BIT, true, false, false},  // Direct repack
+        {vraw::MipiFormat::RAW12, vraw::Encoding::LINEAR_12BIT, false, true, true},   // Unpacked
+        {vraw::MipiFormat::RAW10, vraw::Encoding::LOG2_10BIT, true, true, false},     // Unpacked
+    };
+    for (size_t n = 0; n < sizeof(cases) / sizeof(cases[0]); ++n) {
+        const auto& c = cases[n];
+        const bool raw12 = (c.format == vraw::MipiFormat::RAW12);
+        const uint16_t maxValue = raw12 ? 4095 : 1023;
+        std::vector<uint16_t> frame(width * height);
+        for (uint32_t i = 0; i < frame.size(); ++i) {
+            frame[i] = static_cast<uint16_t>(64 + (i * 7919u) % (maxValue - 63));
+        }
+
+        // Build the MIPI buffer the camera would deliver
+        const uint32_t rowBytes = raw12 ? width * 3 / 2 : width * 5 / 4;
+        const uint32_t stride = rowBytes + padding;
+        std::vector<uint8_t> mipi(stride * height, 0xEE);
+        for (uint32_t y = 0; y < height; ++y) {
+            const uint16_t* px = frame.data() + y * width;
+            uint8_t* row = mipi.data() + y * stride;
+            if (raw12) {
+                for (uint32_t x = 0; x < width; x += 2, row += 3) {
+                    row[0] = static_cast<uint8_t>(px[x] >> 4);
+                    row[1] = static_cast<uint8_t>(px[x + 1] >> 4);
+                    row[2] = static_cast<uint8_t>((px[x] & 0xF) | ((px[x + 1] & 0xF) << 4));
+                }
+            } else {
+                for (uint32_t x = 0; x < width; x += 4, row += 5) {
+                    row[4] = 0;
+                    for (int k = 0; k < 4; ++k) {
+                        row[k] = static_cast<uint8_t>(px[x + k] >> 2);
+                        row[4] |= static_cast<uint8_t>((px[x + k] & 0x3) << (2 * k));
+                    }
+                }
+            }
+        }
+
+        for (int mipiInput = 0; mipiInput < 2; ++mipiInput) {
+            vraw::VrawWriter writer;
+            uint16_t blackLevel[4] = {64, 64, 64, 64};
+            if (!writer.init(width, height, mipiInput ? mipiFile : plainFile, c.encoding, c.packing,
+                             c.compression, vraw::BayerPattern::RGGB, blackLevel, maxValue) ||
+                (c.planar && !writer.setStorageLayout(vraw::FrameLayout::CFA_PLANES, true)) ||
+                !writer.start()) {
+                printf("FAIL (init, case %zu)\n", n);
+                cleanup();
+                return false;
+            }
+            const bool ok = mipiInput
+                ? writer.submitFrameMipi(mipi.data(), stride, c.format, 1000)
+                : writer.submitFrame(frame.data(), 1000);
+            if (!ok || !writer.stop()) {
+                printf("FAIL (write, case %zu)\n", n);
+                cleanup();
+                return false;
+            }
+        }
+
+        vraw::VrawReader mipiReader;
+        vraw::VrawReader plainReader;
+        if (!mipiReader.open(mipiFile) || !plainReader.open(plainFile)) {
+            printf("FAIL (open, case %zu)\n", n);
+            cleanup();
+            return false;
+        }
+        auto got = mipiReader.readFrame(0);
+        auto expected = plainReader.readFrame(0);
+        if (!got.valid || !expected.valid || got.pixelData != expected.pixelData) {
+            printf("FAIL (mismatch, case %zu)\n", n);
+            cleanup();
+            return false;
+        }
+    }
+
+    // Direct RAW12 repack, at group counts covering the SIMD body and scalar tail
+    for (uint32_t groups = 0; groups <= 70; ++groups) {
+        std::vector<uint8_t> mipi(groups * 3);
+        for (size_t i = 0; i < mipi.size(); ++i) {
+            mipi[i] = static_cast<uint8_t>(i * 151u + groups);
+        }
+        std::vector<uint16_t> pixels(groups * 2);
+        std::vector<uint8_t> expected(groups * 3 + 1, 0xEE);
+        std::vector<uint8_t> got(groups * 3 + 1, 0xEE);
+        vraw::detail::unpackMipiRaw12(mipi.data(), pixels.data(), groups);
+        vraw::detail::BitPacker<12, vraw::detail::BitOrder::MSB_FIRST>::pack(
+            pixels.data(), groups * 2, expected.data());
+        vraw::detail::mipiRaw12ToPacked(mipi.data(), got.data(), groups);
+        if (got != expected) {
+            printf("FAIL (RAW12 repack, %u groups)\n", groups);
+            cleanup();
+            return false;
+        }
+    }
+
+    // Widths that do not fill whole MIPI groups are rejected
+    {
+        vraw::VrawWriter writer;
+        std::vector<uint8_t> mipi(64 * 8);
+        if (!writer.init(62, 4, mipiFile, vraw::Encoding::LINEAR_10BIT, true, false) || !writer.start() ||
+            writer.submitFrameMipi(mipi.data(), 0, vraw::MipiFormat::RAW10, 0)) {
+            printf("FAIL (odd width accepted)\n");
+            cleanup();
+            return false;
+        }
+        writer.stop();
+    }
+
+    cleanup();
+    printf("PASS\n");
+    return true;
+}
+
+static bool runParallelEncodeTest() {
+    printf("  [MT]    Multi-threaded band encoding                 ");
+    fflush(stdout);
+
+    // Just over the parallel threshold, with a height that leaves a short last band
+    const uint32_t width = 1032;
+    const uint32_t height = 1030;
+    std::vector<uint16_t> frame(width * height);
+    for (uint32_t i = 0; i < frame.size(); ++i) {
+        frame[i] = static_cast<uint16_t>(60 + (i * 2654435761u >> 18) % 4000);
+    }
+
+    struct {
+        vraw::Encoding encoding;
+        bool packing;
+        bool compression;
+        bool planar;
+        uint16_t whiteLevel;
+    } cases[] = {
+        {vraw::Encoding::LOG2_12BIT, true, true, false, 4095},
+        {vraw::Encoding::LOG2_10BIT, true, false, false, 4095},
+        {vraw::Encoding::LINEAR_14BIT, true, true, true, 16383},
+        {vraw::Encoding::LINEAR_10BIT, true, false, false, 1023},
+    };
+    const unsigned threadCounts[] = {1, 3, 8};
+    for (size_t n = 0; n < sizeof(cases) / sizeof(cases[0]); ++n) {
+        const auto& c = cases[n];
+        std::vector<uint8_t> reference;
+        for (unsigned threads : threadCounts) {
+            std::unique_ptr<vraw::MemorySink> owner(new vraw::MemorySink());
+            vraw::MemorySink* memory = owner.get();
+            vraw::VrawWriter writer;
+            uint16_t blackLevel[4] = {64, 64, 64, 64};
+            if (!writer.initWithSink(std::move(owner), width, height, "parallel", c.encoding,
+                                     c.packing, c.compression, vraw::BayerPattern::RGGB,
+                                     blackLevel, c.whiteLevel) ||
+                (c.planar && !writer.setStorageLayout(vraw::FrameLayout::CFA_PLANES, true)) ||
+                !writer.setEncodeThreads(threads) || !writer.enableFrameStats() || !writer.start() ||
+                !writer.submitFrame(frame.data(), 0) || !writer.submitFrame(frame.data(), 33333) ||
+                !writer.stop()) {
+                printf("FAIL (write, case %zu, %u threads)\n", n, threads);
+                return false;
+            }
+
+            // Everything after the file header (which carries the wall-clock timecode),
+            // including the statistics gathered per band
+            std::vector<uint8_t> body(memory->data().begin() + 512, memory->data().end());
+            if (threads == 1) {
+                reference = std::move(body);
+            } else if (body != reference) {
+                printf("FAIL (output differs, case %zu, %u threads)\n", n, threads);
+                return false;
+            }
+        }
+    }
+
+    printf("PASS\n");
+    return true;
+}
+
+static bool runFrameStatsTest() {
+    printf("  [STATS] Per-frame statistics table                   ");
+    fflush(stdout);
+
+    std::string testFile = "/tmp/vraw_test_stats.vraw";
+
+    // Frame f: a gradient with some samples clipped at the white level
+    auto makeFrame = [](std::vector<uint16_t>& frame, uint32_t f, uint16_t white) {
+        frame.resize(PIXEL_COUNT);
+        for (uint32_t i = 0; i < PIXEL_COUNT; ++i) {
+            frame[i] = (i % 37 == f) ? white : static_cast<uint16_t>((i * 13 + f * 101) % white);
+        }
+    };
+    auto expectedStats = [](const std::vector<uint16_t>& frame, uint16_t white) {
+        vraw::FrameStats stats;
+        uint64_t sum[4] = {};
+        uint32_t count[4] = {};
+        for (int c = 0; c < 4; ++c) {
+            stats.channels[c].min = 0xFFFF;
+        }
+        for (uint32_t i = 0; i < PIXEL_COUNT; ++i) {
+            const int c = static_cast<int>((i / TEST_WIDTH) & 1) * 2 + static_cast<int>(i & 1);
+            const uint16_t v = frame[i];
+            vraw::FrameStats::Channel& ch = stats.channels[c];
+            ch.min = std::min(ch.min, v);
+            ch.max = std::max(ch.max, v);
+            ch.clipped += (v >= white);
+            ch.histogram[std::min(v, white) * vraw::FrameStats::HISTOGRAM_BINS / (white + 1)]++;
+            sum[c] += v;
+            count[c]++;
+        }
+        for (int c = 0; c < 4; ++c) {
+            stats.channels[c].mean = static_cast<float>(static_cast<double>(sum[c]) / count[c]);
+        }
+        return stats;
+    };
+    auto sameStats = [](const vraw::FrameStats& a, const vraw::FrameStats& b) {
+        for (int c = 0; c < 4; ++c) {
+            const vraw::FrameStats::Channel& x = a.channels[c];
+            const vraw::FrameStats::Channel& y = b.channels[c];
+            if (x.min != y.min || x.max != y.max || x.clipped != y.clipped ||
+                std::fabs(x.mean - y.mean) > 0.01f ||
+                memcmp(x.histogram, y.histogram, sizeof(x.histogram)) != 0) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    enum Path { PLAIN, UNPACKED, PLANAR, LOG, CHUNKED, MIPI, PRE_ROLL, DISABLED };
+    const Path paths[] = {PLAIN, UNPACKED, PLANAR, LOG, CHUNKED, MIPI, PRE_ROLL, DISABLED};
+    for (Path path : paths) {
+        const bool mipi = (path == MIPI);
+        const uint16_t white = mipi ? 1023 : 4095;
+        const vraw::Encoding encoding = mipi ? vraw::Encoding::LINEAR_10BIT
+                                      : path == LOG ? vraw::Encoding::LOG2_12BIT
+                                      : vraw::Encoding::LINEAR_12BIT;
+        std::vector<uint16_t> frames[2];
+        for (uint32_t f = 0; f < 2; ++f) {
+            makeFrame(frames[f], f, white);
+        }
+
+        {
+            vraw::VrawWriter writer;
+            if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile, encoding, path != UNPACKED, true,
+                             vraw::BayerPattern::RGGB, nullptr, white) ||
+                (path != DISABLED && !writer.enableFrameStats()) ||
+                (path == PLANAR && !writer.setStorageLayout(vraw::FrameLayout::CFA_PLANES, true)) ||
+                (path == CHUNKED && !writer.setChunkedEncoding(256 * 1024)) ||
+                (path == PRE_ROLL && !writer.enablePreRoll(0, 1 << 20))) {
+                printf("FAIL (init, path %d)\n", path);
+                std::remove(testFile.c_str());
+                return false;
+            }
+            bool ok = (path == PRE_ROLL) || writer.start();
+            for (int f = 0; f < 2 && ok; ++f) {
+                if (mipi) {
+                    // RAW10 lines: four high bytes, then the low bits
+                    std::vector<uint8_t> line(PIXEL_COUNT * 5 / 4);
+                    for (uint32_t g = 0; g < PIXEL_COUNT / 4; ++g) {
+                        uint8_t* out = line.data() + g * 5;
+                        out[4] = 0;
+                        for (int k = 0; k < 4; ++k) {
+                            const uint16_t v = frames[f][g * 4 + k];
+                            out[k] = static_cast<uint8_t>(v >> 2);
+                            out[4] |= static_cast<uint8_t>((v & 3) << (2 * k));
+                        }
+                    }
+                    ok = writer.submitFrameMipi(line.data(), 0, vraw::MipiFormat::RAW10, f * 33333);
+                } else {
+                    ok = writer.submitFrame(frames[f].data(), f * 33333);
+                }
+            }
+            if (!ok || (path == PRE_ROLL && !writer.start()) || !writer.stop()) {
+                printf("FAIL (write, path %d)\n", path);
+                std::remove(testFile.c_str());
+                return false;
+            }
+        }
+
+        vraw::VrawReader reader;
+        if (!reader.open(testFile) || reader.getFrameCount() != 2) {
+            printf("FAIL (open, path %d)\n", path);
+            std::remove(testFile.c_str());
+            return false;
+        }
+        vraw::FrameStats stats;
+        if (path == DISABLED) {
+            if (reader.hasFrameStats() || reader.readFrameStats(0, stats)) {
+                printf("FAIL (unexpected stats)\n");
+                std::remove(testFile.c_str());
+                return false;
+            }
+            continue;
+        }
+        std::vector<vraw::FrameStats> all;
+        if (!reader.hasFrameStats() || !reader.readAllFrameStats(all) || all.size() != 2 ||
+            reader.readFrameStats(2, stats)) {
+            printf("FAIL (table, path %d)\n", path);
+            std::remove(testFile.c_str());
+            return false;
+        }
+        for (uint32_t f = 0; f < 2; ++f) {
+            const vraw::FrameStats expected = expectedStats(frames[f], white);
+            if (!reader.readFrameStats(f, stats) || !sameStats(stats, expected) ||
+                !sameStats(all[f], expected)) {
+                printf("FAIL (frame %u, path %d)\n", f, path);
+                std::remove(testFile.c_str());
+                return false;
+            }
+        }
+
+        // The table follows the index; frames must still read back, and
+        // linear frames exactly
+        auto frame = reader.readFrame(1);
+        int maxDiff = 0;
+        if (!frame.valid || (path != LOG && !compareData(frames[1].data(),
+                reinterpret_cast<const uint16_t*>(frame.pixelData.data()), PIXEL_COUNT, 0, maxDiff))) {
+            printf("FAIL (frame read, path %d)\n", path);
+            std::remove(testFile.c_str());
+            return false;
+        }
+    }
+
+    std::remove(testFile.c_str());
+    printf("PASS\n");
+    return true;
+}
+
+static bool runClipScannerTest() {
+    printf("  [SCAN]  Directory scan and clip catalogue            ");
+    fflush(stdout);
+
+    const std::string dir = "/tmp/vraw_test_scan";
+    const std::string cacheFile = dir + ".cache";
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir + "/day1/cam_a", ec);
+    auto cleanup = [&]() {
+        std::error_code ignored;
+        std::filesystem::remove_all(dir, ignored);
+        std::remove(cacheFile.c_str());
+    };
+
+    std::vector<uint16_t> frame;
+    generateTestData(frame, 4095);
+    std::vector<int16_t> audio(4800 * 2, 100);
+    const std::string paths[] = {dir + "/c.vraw", dir + "/day1/a.vraw", dir + "/day1/cam_a/b.VRAW"};
+    for (int c = 0; c < 3; ++c) {
+        vraw::VrawWriter writer;
+        if (!writer.init(TEST_WIDTH, TEST_HEIGHT, paths[c], vraw::Encoding::LINEAR_12BIT, true, c != 1) ||
+            (c == 1 && !writer.enableAudio(48000, 2)) || (c == 2 && !writer.enableFrameStats()) ||
+            !writer.start()) {
+            printf("FAIL (init %d)\n", c);
+            cleanup();
+            return false;
+        }
+        for (int f = 0; f < 10 + c; ++f) {
+            writer.submitFrame(frame.data(), 1000000 + f * 40000);
+        }
+        if (c == 1) {
+            writer.submitAudio(audio.data(), 4800, 1000000);
+        }
+        writer.stop();
+    }
+    // Not clips: bad content, and an extension that is not looked at
+    for (const char* name : {"/junk.vraw", "/notes.txt"}) {
+        FILE* f = fopen((dir + name).c_str(), "wb");
+        if (f) {
+            fputs("not a clip", f);
+            fclose(f);
+        }
+    }
+
+    vraw::ClipScanner scanner;
+    vraw::ClipScanner::Options options;
+    options.threads = 3;
+    std::vector<vraw::ClipInfo> found;
+    if (!scanner.scan({dir}, options, found) || found.size() != 3 || scanner.getReadCount() != 3) {
+        printf("FAIL (scan found %zu)\n", found.size());
+        cleanup();
+        return false;
+    }
+    for (int c = 0; c < 3; ++c) {
+        const vraw::ClipInfo& info = found[c];
+        const uint32_t frames = 10 + c;
+        vraw::VrawReader reader;
+        if (info.path != paths[c] || !reader.open(info.path) || info.frameCount != frames ||
+            info.width != TEST_WIDTH || info.height != TEST_HEIGHT || !info.finalized ||
+            info.firstTimestampUs != 1000000 || info.durationUs != frames * 40000ull ||
+            info.hasAudio != (c == 1) || info.hasFrameStats != (c == 2) ||
+            info.compression != reader.getFileHeader().compression ||
+            info.bitrate != static_cast<uint64_t>(info.videoBytes * 8.0 * 1e6 / info.durationUs)) {
+            printf("FAIL (clip %d)\n", c);
+            cleanup();
+            return false;
+        }
+        if (c == 1 && (info.audioChannels != 2 || info.audioSampleRate != 48000 ||
+                       info.audioSampleCount != 4800 ||
+                       info.videoBytes != reader.getFileHeader().audioOffset - 512)) {
+            printf("FAIL (audio)\n");
+            cleanup();
+            return false;
+        }
+    }
+
+    // Rescans through the cache only read what changed
+    if (!scanner.saveCache(cacheFile)) {
+        printf("FAIL (save cache)\n");
+        cleanup();
+        return false;
+    }
+    {
+        vraw::VrawWriter writer;
+        writer.init(TEST_WIDTH, TEST_HEIGHT, paths[0], vraw::Encoding::LINEAR_12BIT, true, true);
+        writer.start();
+        writer.submitFrame(frame.data(), 0);
+        writer.stop();
+    }
+    vraw::ClipScanner rescanner;
+    std::vector<vraw::ClipInfo> rescanned;
+    if (!rescanner.loadCache(cacheFile) || !rescanner.scan({dir}, options, rescanned) ||
+        rescanned.size() != 3 || rescanner.getReadCount() != 1 || rescanner.getCachedCount() != 2 ||
+        rescanned[0].frameCount != 1 || rescanned[2].frameCount != 12) {
+        printf("FAIL (incremental rescan)\n");
+        cleanup();
+        return false;
+    }
+
+    const std::string json = vraw::ClipScanner::toJson(rescanned);
+    if (json.find("\"path\": \"" + paths[1] + "\"") == std::string::npos ||
+        json.find("\"sample_rate\": 48000") == std::string::npos) {
+        printf("FAIL (json)\n");
+        cleanup();
+        return false;
+    }
+
+    cleanup();
+    printf("PASS\n");
+    return true;
+}
+
+static bool runAudioPeaksTest() {
+    printf("  [PEAKS] Audio waveform overview                      ");
+    fflush(stdout);
+
+    const std::string testFile = "/tmp/vraw_test_peaks.vraw";
+    const uint16_t channels = 3;
+    const uint32_t sampleCount = 10000;  // Not a multiple of either block
+    std::vector<int16_t> audio(sampleCount * channels);
+    uint32_t seed = 12345;
+    for (int16_t& sample : audio) {
+        seed = seed * 1103515245u + 12345u;
+        sample = static_cast<int16_t>(seed >> 16);
+    }
+    std::vector<uint16_t> frame;
+    generateTestData(frame, 4095);
+
+    {
+        vraw::VrawWriter writer;
+        if (!writer.init(TEST_WIDTH, TEST_HEIGHT, testFile) || !writer.enableAudio(48000, channels) ||
+            !writer.start()) {
+            printf("FAIL (init)\n");
+            return false;
+        }
+        writer.submitFrame(frame.data(), 0);
+        // Uneven chunks so peaks straddle submitAudio() calls
+        for (uint32_t done = 0; done < sampleCount;) {
+            const uint32_t n = std::min<uint32_t>(777, sampleCount - done);
+            writer.submitAudio(audio.data() + done * channels, n, 1000 + done);
+            done += n;
+        }
+        writer.stop();
+    }
+
+    vraw::VrawReader reader;
+    std::vector<vraw::AudioPeak> peaks;
+    if (!reader.open(testFile) || !reader.hasAudioPeaks() ||
+        reader.getAudioPeakResolutions() != std::vector<uint32_t>{256, 4096} ||
+        reader.readAudioPeaks(1000, peaks)) {
+        printf("FAIL (peak table)\n");
+        std::remove(testFile.c_str());
+        return false;
+    }
+
+    // Stored levels and merged zoom levels match a scan of the PCM data
+    for (uint32_t block : {256u, 512u, 4096u, 12288u}) {
+        if (!reader.readAudioPeaks(block, peaks) ||
+            peaks.size() != (sampleCount + block - 1) / block * channels) {
+            printf("FAIL (peaks per %u)\n", block);
+            std::remove(testFile.c_str());
+            return false;
+        }
+        for (size_t p = 0; p < peaks.size(); ++p) {
+            const uint32_t c = p % channels;
+            const uint32_t first = static_cast<uint32_t>(p / channels) * block;
+            int16_t lo = INT16_MAX;
+            int16_t hi = INT16_MIN;
+            for (uint32_t i = first; i < std::min(first + block, sampleCount); ++i) {
+                lo = std::min(lo, audio[i * channels + c]);
+                hi = std::max(hi, audio[i * channels + c]);
+            }
+            if (peaks[p].min != lo || peaks[p].max != hi) {
+                printf("FAIL (peak %zu per %u)\n", p, block);
+                std::remove(testFile.c_str());
+                return false;
+            }
+        }
+    }
+
+    std::remove(testFile.c_str());
+    printf("PASS\n");
+    return true;
+}
+
+// Value of a numeric tag in a little-endian DNG (index-th element; the
+// numerator for rationals), or -1
+static int64_t dngTag(const std::vector<uint8_t>& dng, uint16_t id, uint32_t index = 0) {
+    auto u16 = [&](size_t at) { return static_cast<uint32_t>(dng[at] | (dng[at + 1] << 8)); };
+    auto u32 = [&](size_t at) { return u16(at) | (u16(at + 2) << 16); };
+    if (dng.size() < 8 || dng[0] != 'I' || u16(2) != 42) {
+        return -1;
+    }
+    const uint32_t ifd = u32(4);
+    for (uint32_t i = 0; i < u16(ifd); ++i) {
+        const size_t entry = ifd + 2 + i * 12;
+        if (u16(entry) != id) {
+            continue;
+        }
+        const uint32_t type = u16(entry + 2);
+        const uint32_t count = u32(entry + 4);
+        const uint32_t size = (type == 3) ? 2 : (type == 4) ? 4 : (type == 5 || type == 10) ? 8 : 1;
+        if (index >= count) {
+            return -1;
+        }
+        const size_t at = (size * count <= 4 ? entry + 8 : u32(entry + 8)) + index * size;
+        return size == 1 ? dng[at] : size == 2 ? u16(at) : u32(at);
+    }
+    return -1;
+}
+
+static bool runDngTest() {
+    printf("  [DNG]   DNG frame export                             ");
+    fflush(stdout);
+
+    const std::string linearFile = "/tmp/vraw_test_dng.vraw";
+    const std::string logFile = "/tmp/vraw_test_dng_log.vraw";
+    const uint16_t black[4] = {60, 62, 64, 66};
+    std::vector<uint16_t> frame;
+    generateTestData(frame, 4095);
+    {
+        vraw::VrawWriter writer;
+        if (!writer.init(TEST_WIDTH, TEST_HEIGHT, linearFile, vraw::Encoding::LINEAR_12BIT, true, true,
+                         vraw::BayerPattern::GRBG, black, 4095, 90) || !writer.start()) {
+            printf("FAIL (init)\n");
+            return false;
+        }
+        writer.submitFrame(frame.data(), 0, 2.0f, 1.0f, 1.6f);
+        writer.stop();
+    }
+    {
+        vraw::VrawWriter writer;
+        writer.init(TEST_WIDTH, TEST_HEIGHT, logFile, vraw::Encoding::LOG2_10BIT, true, false);
+        writer.start();
+        writer.submitFrame(frame.data(), 0);
+        writer.stop();
+    }
+    auto cleanup = [&]() {
+        std::remove(linearFile.c_str());
+        std::remove(logFile.c_str());
+    };
+
+    vraw::VrawReader reader;
+    vraw::FrameHeader header;
+    std::vector<uint16_t> mosaic(PIXEL_COUNT);
+    if (!reader.open(linearFile) ||
+        !reader.readFrameInto(0, mosaic.data(), mosaic.size() * 2, &header)) {
+        printf("FAIL (read)\n");
+        cleanup();
+        return false;
+    }
+    const vraw::FileHeader& file = reader.getFileHeader();
+
+    // 16-bit samples: tags and a byte-exact copy of the mosaic
+    vraw::DngOptions options;
+    options.frameRate = 25.0f;
+    std::vector<uint8_t> dng;
+    if (!vraw::DngWriter::encode(file, header, mosaic.data(), options, dng) ||
+        dng.size() != vraw::DngWriter::encodedSize(file, options)) {
+        printf("FAIL (encode)\n");
+        cleanup();
+        return false;
+    }
+    const int64_t stripOffset = dngTag(dng, 273);
+    if (dngTag(dng, 256) != TEST_WIDTH || dngTag(dng, 257) != TEST_HEIGHT || dngTag(dng, 258) != 16 ||
+        dngTag(dng, 262) != 32803 || dngTag(dng, 274) != 6 || dngTag(dng, 279) != PIXEL_COUNT * 2 ||
+        dngTag(dng, 33422, 0) != 1 || dngTag(dng, 33422, 1) != 0 || dngTag(dng, 33422, 2) != 2 ||
+        dngTag(dng, 50714, 0) != 60 || dngTag(dng, 50714, 3) != 66 || dngTag(dng, 50717) != 4095 ||
+        dngTag(dng, 50728, 0) != 500000 || dngTag(dng, 50728, 2) != 625000 ||
+        dngTag(dng, 51044, 0) != 25000 || dngTag(dng, 50712) != -1 ||
+        stripOffset <= 0 || memcmp(dng.data() + stripOffset, mosaic.data(), PIXEL_COUNT * 2) != 0) {
+        printf("FAIL (16-bit tags)\n");
+        cleanup();
+        return false;
+    }
+
+    // Packed at the clip's 12 bits, MSB-first
+    options.packed = true;
+    if (!vraw::DngWriter::encode(file, header, mosaic.data(), options, dng) ||
+        dng.size() != vraw::DngWriter::encodedSize(file, options) || dngTag(dng, 258) != 12 ||
+        dngTag(dng, 279) != PIXEL_COUNT * 3 / 2) {
+        printf("FAIL (packed)\n");
+        cleanup();
+        return false;
+    }
+    const uint8_t* packed = dng.data() + dngTag(dng, 273);
+    for (uint32_t i = 0; i < PIXEL_COUNT; i += 2) {
+        const uint8_t* p = packed + i / 2 * 3;
+        if (((p[0] << 4) | (p[1] >> 4)) != mosaic[i] || (((p[1] & 0xF) << 8) | p[2]) != mosaic[i + 1]) {
+            printf("FAIL (packed sample %u)\n", i);
+            cleanup();
+            return false;
+        }
+    }
+
+    // Log codes are stored as-is behind a linearization table
+    vraw::VrawReader logReader;
+    if (!logReader.open(logFile) ||
+        !logReader.readFrameInto(0, mosaic.data(), mosaic.size() * 2, &header) ||
+        !vraw::DngWriter::encode(logReader.getFileHeader(), header, mosaic.data(), options, dng) ||
+        dngTag(dng, 258) != 10 || dngTag(dng, 50712, 1023) != 4095 ||
+        dngTag(dng, 50712, 512) != vraw::decodePixelLog10Bit(512, static_cast<uint16_t>(dngTag(dng, 50714)), 4095)) {
+        printf("FAIL (log)\n");
+        cleanup();
+        return false;
+    }
+
+    cleanup();
+    printf("PASS\n");
+    return true;
+}
+
+int main() {
+    printf("\nVRAW Library Test Suite\n");
+    printf("=======================\n\n");
+    printf("Testing %d encoding/compression/packing combinations:\n\n", NUM_TESTS);
+
+    int passed = 0;
+    int failed = 0;
+
+    for (int i = 0; i < NUM_TESTS; i++) {
+        if (runTest(testConfigs[i], i + 1)) {
+            passed++;
+        } else {
+            failed++;
+        }
+    }
+
+    printf("\n");
+
+    // Run audio test
+    if (runAudioTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runPlanarStorageTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runPreRollTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runBatchLoaderTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runOutputSinkTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runInputSourceTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runDurabilityTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runAccessHintTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runSingleFetchTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runBatchReadTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runLoadIntoMemoryTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runFrameCacheTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runRowStreamTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runChunkedEncodingTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runBitPackerTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runMipiIngestTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runParallelEncodeTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runFrameStatsTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runClipScannerTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runDngTest()) {
+        passed++;
+    } else {
+        failed++;
+    }
+
+    if (runAudioPeaksTest()) {
         passed++;
     } else {
         failed++;